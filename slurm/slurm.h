@@ -3171,6 +3171,9 @@ typedef struct stats_info_response_msg {
 	uint32_t agent_count;
 	uint32_t agent_thread_count;
 	uint32_t dbd_agent_queue_size;
+	uint32_t dbd_agent_batch_cnt;
+	uint32_t dbd_agent_latency_max;
+	uint64_t dbd_agent_latency_sum;
 	uint32_t gettimeofday_latency;
 
 	uint32_t schedule_cycle_max;
@@ -54,6 +54,10 @@
 # include <lz4.h>
 #endif
 
+#if HAVE_ZSTD
+# include <zstd.h>
+#endif
+
 #include "slurm/slurm_errno.h"
 #include "src/common/forward.h"
 #include "src/common/hostlist.h"
@@ -71,6 +75,8 @@
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
+#include "src/interfaces/hash.h"
+
 #include "file_bcast.h"
 
 /*
@@ -81,17 +87,37 @@
 #define DEFAULT_THREADS 8
 #define MAX_THREADS     64	/* These can be huge messages, so
 				 * only run MAX_THREADS at one time */
+#define MAX_BLOCKS_IN_FLIGHT 4	/* blocks sent down the tree at once */
+
+typedef struct {
+	char *buffer;			/* compressed block, NULL if mmap'd */
+	file_bcast_msg_t msg;		/* request for this block */
+} bcast_block_t;
+
+typedef struct {
+	List blocks;			/* blocks read but not yet sent */
+	pthread_cond_t cond;
+	bool done;			/* no more blocks will be queued */
+	pthread_mutex_t mutex;
+	struct bcast_parameters *params;
+	int rc;				/* first failure of any block */
+	uint64_t size_compressed;	/* bytes of block data sent */
+	pthread_t threads[MAX_BLOCKS_IN_FLIGHT];
+	uint32_t time_compression;	/* usec spent compressing blocks */
+} bcast_pipe_t;
 
 int block_len;				/* block size */
 int fd;					/* source file descriptor */
 void *src;				/* source mmap'd address */
 struct stat f_stat;			/* source file stats */
 job_sbcast_cred_msg_t *sbcast_cred;	/* job alloc info and sbcast cred */
+static bool use_cache = false;		/* send digests ahead of blocks */
+static int compress_level = 0;		/* zstd level, 0 for library default */
 
 static int   _bcast_file(struct bcast_parameters *params);
 static int   _file_bcast(struct bcast_parameters *params,
-			 file_bcast_msg_t *bcast_msg,
-			 job_sbcast_cred_msg_t *sbcast_cred);
+			 file_bcast_msg_t *bcast_msg, char *node_list,
+			 hostlist_t **missing);
 static int   _file_state(struct bcast_parameters *params);
 static List _fill_in_excluded_paths(struct bcast_parameters *params);
 static int _find_subpath(void *x, void *key);
@@ -163,10 +189,15 @@ static int _get_job_info(struct bcast_parameters *params)
 	return rc;
 }
 
-/* Issue the RPC to transfer the file's data */
+/*
+ * Send one REQUEST_FILE_BCAST through the fanout tree.
+ * IN node_list - nodes to send to
+ * OUT missing - if not NULL, nodes that did not have a FILE_BCAST_DIGEST block
+ *	cached are added here instead of being reported as failed
+ */
 static int _file_bcast(struct bcast_parameters *params,
-		       file_bcast_msg_t *bcast_msg,
-		       job_sbcast_cred_msg_t *sbcast_cred)
+		       file_bcast_msg_t *bcast_msg, char *node_list,
+		       hostlist_t **missing)
 {
 	List ret_list = NULL;
 	list_itr_t *itr;
@@ -181,8 +212,7 @@ static int _file_bcast(struct bcast_parameters *params,
 	msg.forward.tree_width = params->tree_width;
 	msg.msg_type = REQUEST_FILE_BCAST;
 
-	ret_list = slurm_send_recv_msgs(sbcast_cred->node_list, &msg,
-					params->timeout);
+	ret_list = slurm_send_recv_msgs(node_list, &msg, params->timeout);
 	if (ret_list == NULL) {
 		error("slurm_send_recv_msgs: %m");
 		exit(1);
@@ -195,6 +225,13 @@ static int _file_bcast(struct bcast_parameters *params,
 		if (msg_rc == SLURM_SUCCESS)
 			continue;
 
+		if (missing && (msg_rc == ESLURMD_BCAST_BLOCK_NOT_CACHED)) {
+			if (!*missing)
+				*missing = hostlist_create(NULL);
+			hostlist_push_host(*missing, ret_data_info->node_name);
+			continue;
+		}
+
 		error("REQUEST_FILE_BCAST(%s): %s",
 		      ret_data_info->node_name,
 		      slurm_strerror(msg_rc));
@@ -206,8 +243,194 @@ static int _file_bcast(struct bcast_parameters *params,
 	return rc;
 }
 
-/* load a buffer with data from the file to broadcast,
- * return number of bytes read, zero on end of file */
+static void _add_stats(bcast_pipe_t *bpipe, uint32_t block_len,
+		       uint32_t usec)
+{
+	slurm_mutex_lock(&bpipe->mutex);
+	bpipe->size_compressed += block_len;
+	bpipe->time_compression += usec;
+	slurm_mutex_unlock(&bpipe->mutex);
+}
+
+/*
+ * zstd blocks are read uncompressed and compressed by whichever thread sends
+ * them, so up to MAX_BLOCKS_IN_FLIGHT blocks are compressed at once.
+ * Blocks that do not shrink are sent uncompressed.
+ */
+static void _compress_block(bcast_pipe_t *bpipe, bcast_block_t *block)
+{
+#if HAVE_ZSTD
+	size_t bound, size;
+	DEF_TIMERS;
+
+	if ((block->msg.compress != COMPRESS_ZSTD) || block->buffer)
+		return;
+
+	START_TIMER;
+	bound = ZSTD_compressBound(block->msg.block_len);
+	block->buffer = xmalloc_nz(bound);
+	size = ZSTD_compress(block->buffer, bound, block->msg.block,
+			     block->msg.block_len, compress_level);
+	END_TIMER;
+
+	if (ZSTD_isError(size) || (size >= block->msg.block_len)) {
+		if (ZSTD_isError(size))
+			error("zstd compression error: %s",
+			      ZSTD_getErrorName(size));
+		xfree(block->buffer);
+		block->msg.compress = COMPRESS_OFF;
+	} else {
+		block->msg.block = block->buffer;
+		block->msg.block_len = size;
+	}
+	_add_stats(bpipe, block->msg.block_len, DELTA_TIMER);
+#endif
+}
+
+/*
+ * Send a block to every node. When its digest is set, only the digest is sent
+ * at first, and the data follows only to nodes that do not have it cached.
+ */
+static int _send_block(bcast_pipe_t *bpipe, bcast_block_t *block)
+{
+	struct bcast_parameters *params = bpipe->params;
+	file_bcast_msg_t probe;
+	hostlist_t *missing = NULL;
+	char *node_list;
+	int rc;
+
+	if (block->msg.digest.type != HASH_PLUGIN_K12) {
+		_compress_block(bpipe, block);
+		return _file_bcast(params, &block->msg, sbcast_cred->node_list,
+				   NULL);
+	}
+
+	probe = block->msg;
+	probe.flags |= FILE_BCAST_DIGEST;
+	probe.block = NULL;
+	probe.block_len = 0;
+
+	rc = _file_bcast(params, &probe, sbcast_cred->node_list, &missing);
+	if ((rc != SLURM_SUCCESS) || !missing) {
+		if (rc == SLURM_SUCCESS)
+			debug("block %u cached on all nodes",
+			      block->msg.block_no);
+		FREE_NULL_HOSTLIST(missing);
+		return rc;
+	}
+
+	node_list = hostlist_ranged_string_xmalloc(missing);
+	debug("block %u not cached on %s", block->msg.block_no, node_list);
+	_compress_block(bpipe, block);
+	rc = _file_bcast(params, &block->msg, node_list, NULL);
+	xfree(node_list);
+	FREE_NULL_HOSTLIST(missing);
+
+	return rc;
+}
+
+static void _free_block(void *x)
+{
+	bcast_block_t *block = x;
+
+	if (!block)
+		return;
+
+	xfree(block->buffer);
+	xfree(block);
+}
+
+/* send queued blocks until the pipe is drained or any block fails */
+static void *_send_blocks(void *arg)
+{
+	bcast_pipe_t *bpipe = arg;
+	bcast_block_t *block;
+	int rc;
+
+	while (true) {
+		slurm_mutex_lock(&bpipe->mutex);
+		while (!bpipe->rc && !bpipe->done &&
+		       !list_count(bpipe->blocks))
+			slurm_cond_wait(&bpipe->cond, &bpipe->mutex);
+		if (bpipe->rc || !(block = list_dequeue(bpipe->blocks))) {
+			slurm_mutex_unlock(&bpipe->mutex);
+			break;
+		}
+		/* let the reader refill the queue while this block is sent */
+		slurm_cond_broadcast(&bpipe->cond);
+		slurm_mutex_unlock(&bpipe->mutex);
+
+		rc = _send_block(bpipe, block);
+		_free_block(block);
+
+		if (rc != SLURM_SUCCESS) {
+			slurm_mutex_lock(&bpipe->mutex);
+			if (!bpipe->rc)
+				bpipe->rc = rc;
+			slurm_cond_broadcast(&bpipe->cond);
+			slurm_mutex_unlock(&bpipe->mutex);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Queue a block to be sent by the pipe's threads, starting them if needed.
+ * Blocks while MAX_BLOCKS_IN_FLIGHT blocks are already waiting to be sent.
+ * RET SLURM_SUCCESS or the error of a block that already failed
+ */
+static int _queue_block(bcast_pipe_t *bpipe, bcast_block_t *block)
+{
+	int rc;
+
+	if (!bpipe->threads[0]) {
+		for (int i = 0; i < MAX_BLOCKS_IN_FLIGHT; i++)
+			slurm_thread_create(&bpipe->threads[i], _send_blocks,
+					    bpipe);
+	}
+
+	slurm_mutex_lock(&bpipe->mutex);
+	while (!bpipe->rc &&
+	       (list_count(bpipe->blocks) >= MAX_BLOCKS_IN_FLIGHT))
+		slurm_cond_wait(&bpipe->cond, &bpipe->mutex);
+	if (!(rc = bpipe->rc)) {
+		list_enqueue(bpipe->blocks, block);
+		block = NULL;
+		slurm_cond_broadcast(&bpipe->cond);
+	}
+	slurm_mutex_unlock(&bpipe->mutex);
+
+	_free_block(block);
+	return rc;
+}
+
+/*
+ * Wait for every queued block to be acknowledged and stop the pipe's threads
+ * RET SLURM_SUCCESS or the error of the first block that failed
+ */
+static int _drain_blocks(bcast_pipe_t *bpipe)
+{
+	if (!bpipe->threads[0])
+		return bpipe->rc;
+
+	slurm_mutex_lock(&bpipe->mutex);
+	bpipe->done = true;
+	slurm_cond_broadcast(&bpipe->cond);
+	slurm_mutex_unlock(&bpipe->mutex);
+
+	for (int i = 0; i < MAX_BLOCKS_IN_FLIGHT; i++) {
+		slurm_thread_join(bpipe->threads[i]);
+	}
+
+	bpipe->done = false;
+	list_flush(bpipe->blocks);
+
+	return bpipe->rc;
+}
+
+/* point buffer at the next block of the mmap'd file to broadcast,
+ * return number of bytes in the block, zero on end of file */
 static int _get_block_none(char **buffer, int *orig_len, bool *more,
 			   bool file_start)
 {
@@ -221,13 +444,12 @@ static int _get_block_none(char **buffer, int *orig_len, bool *more,
 	}
 
 	if (remaining < 0) {
-		*buffer = xmalloc(block_len);
 		remaining = f_stat.st_size;
 		position = src;
 	}
 
 	size = MIN(block_len, remaining);
-	memcpy(*buffer, position, size);
+	*buffer = position;
 	remaining -= size;
 	position += size;
 
@@ -260,9 +482,11 @@ static int _get_block_lz4(struct bcast_parameters *params,
 	if (remaining < 0) {
 		position = src;
 		remaining = f_stat.st_size;
-		*buffer = xmalloc(block_len);
 	}
 
+	/* each block is sent while the next is compressed */
+	*buffer = xmalloc(block_len);
+
 	/* intentionally limit decompressed size to 10x compressed
 	 * to avoid problems on receive size when decompressed */
 	size = MIN(block_len * 10, remaining);
@@ -296,6 +520,13 @@ static int _next_block(struct bcast_parameters *params,
 	case COMPRESS_LZ4:
 		return _get_block_lz4(params, buffer, orig_len, more,
 				      file_start);
+	case COMPRESS_ZSTD:
+#if !HAVE_ZSTD
+		info("zstd compression not supported, sending uncompressed file.");
+		params->compress = COMPRESS_OFF;
+#endif
+		/* see _compress_block() */
+		return _get_block_none(buffer, orig_len, more, file_start);
 	}
 
 	/* compression type not recognized */
@@ -310,10 +541,10 @@ static int _bcast_file(struct bcast_parameters *params)
 {
 	int rc = SLURM_SUCCESS;
 	file_bcast_msg_t bcast_msg;
+	bcast_pipe_t bpipe = { 0 };
 	char *buffer = NULL;
 	int32_t orig_len = 0;
-	uint64_t size_uncompressed = 0, size_compressed = 0;
-	uint32_t time_compression = 0;
+	uint64_t size_uncompressed = 0;
 	bool more = true, file_start = true;
 	DEF_TIMERS;
 
@@ -349,15 +580,32 @@ static int _bcast_file(struct bcast_parameters *params)
 	else if (params->tree_width != 0xfffd)
 		params->tree_width = MIN(MAX_THREADS, params->tree_width);
 
+	bpipe.blocks = list_create(_free_block);
+	bpipe.params = params;
+	slurm_cond_init(&bpipe.cond, NULL);
+	slurm_mutex_init(&bpipe.mutex);
+
 	while (more) {
+		bcast_block_t *block = xmalloc(sizeof(*block));
+
 		START_TIMER;
 		bcast_msg.block_len = _next_block(params, &buffer, &orig_len,
 						  &more, file_start);
 		END_TIMER;
 		file_start = false;
-		time_compression += DELTA_TIMER;
+		memset(&bcast_msg.digest, 0, sizeof(bcast_msg.digest));
+		if (use_cache && orig_len) {
+			/* nodes cache blocks by digest of uncompressed data */
+			bcast_msg.digest.type = HASH_PLUGIN_K12;
+			if (hash_g_compute(src + bcast_msg.block_offset,
+					   orig_len, NULL, 0,
+					   &bcast_msg.digest) <= 0)
+				memset(&bcast_msg.digest, 0,
+				       sizeof(bcast_msg.digest));
+		}
 		size_uncompressed += orig_len;
-		size_compressed += bcast_msg.block_len;
+		if (params->compress != COMPRESS_ZSTD)
+			_add_stats(&bpipe, bcast_msg.block_len, DELTA_TIMER);
 		debug("block %u, size %u", bcast_msg.block_no,
 		      bcast_msg.block_len);
 		bcast_msg.compress = params->compress;
@@ -366,7 +614,25 @@ static int _bcast_file(struct bcast_parameters *params)
 		if (!more)
 			bcast_msg.flags |= FILE_BCAST_LAST_BLOCK;
 
-		rc = _file_bcast(params, &bcast_msg, sbcast_cred);
+		block->msg = bcast_msg;
+		if (params->compress == COMPRESS_LZ4)
+			block->buffer = buffer;
+
+		if ((bcast_msg.block_no == 1) ||
+		    (bcast_msg.flags & FILE_BCAST_LAST_BLOCK)) {
+			/*
+			 * The first block opens the file on every node and the
+			 * last one closes it, so these are sent alone. Blocks
+			 * in between are written at their own offset in
+			 * whatever order they arrive.
+			 */
+			if ((rc = _drain_blocks(&bpipe)) == SLURM_SUCCESS)
+				rc = _send_block(&bpipe, block);
+			_free_block(block);
+		} else {
+			rc = _queue_block(&bpipe, block);
+		}
+
 		if (rc != SLURM_SUCCESS)
 			break;
 		if (bcast_msg.flags & FILE_BCAST_LAST_BLOCK)
@@ -374,10 +640,14 @@ static int _bcast_file(struct bcast_parameters *params)
 		bcast_msg.block_no++;
 		bcast_msg.block_offset += orig_len;
 	}
+	(void) _drain_blocks(&bpipe);
+	FREE_NULL_LIST(bpipe.blocks);
+	slurm_cond_destroy(&bpipe.cond);
+	slurm_mutex_destroy(&bpipe.mutex);
 	xfree(bcast_msg.user_name);
-	xfree(buffer);
 
 	if (size_uncompressed && (params->compress != 0)) {
+		uint64_t size_compressed = bpipe.size_compressed;
 		int64_t pct = (int64_t) size_uncompressed - size_compressed;
 		/* Dividing a negative by a positive in C99 results in
 		 * "truncation towards zero" which gives unexpected values for
@@ -387,7 +657,7 @@ static int _bcast_file(struct bcast_parameters *params)
 			       : - (-pct * 100 / size_uncompressed);
 		verbose("File compressed from %"PRIu64" to %"PRIu64" (%d percent) in %u usec",
 			size_uncompressed, size_compressed, (int) pct,
-			time_compression);
+			bpipe.time_compression);
 	}
 
 	return rc;
@@ -419,6 +689,35 @@ static int _decompress_data_lz4(file_bcast_msg_t *req)
 #endif
 }
 
+static int _decompress_data_zstd(file_bcast_msg_t *req)
+{
+#if HAVE_ZSTD
+	char *out_buf;
+	size_t out_len;
+
+	if (!req->block_len)
+		return 0;
+
+	out_buf = xmalloc_nz(req->uncomp_len);
+	out_len = ZSTD_decompress(out_buf, req->uncomp_len, req->block,
+				  req->block_len);
+	xfree(req->block);
+	req->block = out_buf;
+	if (ZSTD_isError(out_len)) {
+		error("zstd decompression error: %s",
+		      ZSTD_getErrorName(out_len));
+		return -1;
+	} else if (req->uncomp_len != out_len) {
+		error("zstd decompression error, original block length != decompressed length");
+		return -1;
+	}
+	req->block_len = out_len;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
 /*
  * IN: char pointer with the filename.
  * OUT: List of shared object direct and indirect dependencies.
@@ -624,6 +923,7 @@ fini:
 extern int bcast_file(struct bcast_parameters *params)
 {
 	List lib_paths = NULL;
+	char *tmp;
 	int rc;
 
 	if ((rc = _file_state(params)) != SLURM_SUCCESS)
@@ -631,6 +931,25 @@ extern int bcast_file(struct bcast_parameters *params)
 	if ((rc = _get_job_info(params)) != SLURM_SUCCESS)
 		return rc;
 
+	/* Nodes keep a cache of blocks if BcastParameters=CacheSize is set */
+	if ((tmp = conf_get_opt_str(slurm_conf.bcast_parameters,
+				    "CacheSize="))) {
+		uint64_t mbytes = str_to_mbytes(tmp);
+
+		use_cache = (mbytes && (mbytes != NO_VAL64));
+		xfree(tmp);
+	}
+
+	if ((tmp = conf_get_opt_str(slurm_conf.bcast_parameters,
+				    "CompressionLevel="))) {
+		compress_level = atoi(tmp);
+#if HAVE_ZSTD
+		compress_level = MAX(compress_level, ZSTD_minCLevel());
+		compress_level = MIN(compress_level, ZSTD_maxCLevel());
+#endif
+		xfree(tmp);
+	}
+
 	/*
 	 * If getting the shared libraries fail, still send the file but
 	 * ignore send_libs.
@@ -666,6 +985,8 @@ extern int bcast_decompress_data(file_bcast_msg_t *req)
 		return 0;
 	case COMPRESS_LZ4:
 		return _decompress_data_lz4(req);
+	case COMPRESS_ZSTD:
+		return _decompress_data_zstd(req);
 	}
 
 	/* compression type not recognized */
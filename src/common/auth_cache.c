@@ -0,0 +1,235 @@
+/*****************************************************************************\
+ *  auth_cache.c - verified authentication credential cache
+ *****************************************************************************
+ *  Copyright (C) SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "slurm/slurm.h"
+
+#include "src/common/auth_cache.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/read_config.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "src/interfaces/hash.h"
+
+#define AUTH_CACHE_MAGIC 0x1ac3c4e0
+#define DEFAULT_CACHE_SIZE 1024
+#define MAX_CACHE_SIZE (1024 * 1024)
+/* log statistics every so many lookups */
+#define STATS_INTERVAL 10000
+
+typedef struct {
+	slurm_hash_t key;
+	time_t expiration;
+	void *data;
+} entry_t;
+
+struct auth_cache_s {
+	int magic; /* AUTH_CACHE_MAGIC */
+	char *name;
+	pthread_mutex_t mutex;
+	auth_cache_free_t free_func;
+	uint32_t size;
+	entry_t *entries;
+
+	/* statistics */
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t expired;
+	uint64_t evicted;
+};
+
+static void _log_stats(auth_cache_t *cache)
+{
+	log_flag(NET, "%s: %s cache: lookups=%"PRIu64" hits=%"PRIu64" misses=%"PRIu64" expired=%"PRIu64" evicted=%"PRIu64,
+		 __func__, cache->name, cache->lookups, cache->hits,
+		 (cache->lookups - cache->hits), cache->expired,
+		 cache->evicted);
+}
+
+static void _free_entry(auth_cache_t *cache, entry_t *entry)
+{
+	if (entry->data)
+		cache->free_func(entry->data);
+	memset(entry, 0, sizeof(*entry));
+}
+
+/* Hash token and return slot for it. RET NULL on error */
+static entry_t *_get_slot(auth_cache_t *cache, const char *token, int len,
+			  slurm_hash_t *key)
+{
+	uint32_t index;
+
+	key->type = HASH_PLUGIN_K12;
+	if (hash_g_compute((char *) token, len, NULL, 0, key) <= 0)
+		return NULL;
+
+	memcpy(&index, key->hash, sizeof(index));
+
+	return &cache->entries[index % cache->size];
+}
+
+extern auth_cache_t *auth_cache_create(const char *name, uint32_t size,
+				       auth_cache_free_t free_func)
+{
+	auth_cache_t *cache;
+
+	xassert(free_func);
+
+	if (!size)
+		return NULL;
+
+	if (hash_g_init()) {
+		error("%s: unable to load hash plugin, %s cache disabled",
+		      __func__, name);
+		return NULL;
+	}
+
+	cache = xmalloc(sizeof(*cache));
+	cache->magic = AUTH_CACHE_MAGIC;
+	cache->name = xstrdup(name);
+	slurm_mutex_init(&cache->mutex);
+	cache->free_func = free_func;
+	cache->size = MIN(size, MAX_CACHE_SIZE);
+	cache->entries = xcalloc(cache->size, sizeof(*cache->entries));
+
+	return cache;
+}
+
+extern void auth_cache_destroy(auth_cache_t *cache)
+{
+	if (!cache)
+		return;
+
+	xassert(cache->magic == AUTH_CACHE_MAGIC);
+
+	slurm_mutex_lock(&cache->mutex);
+	_log_stats(cache);
+	for (uint32_t i = 0; i < cache->size; i++)
+		_free_entry(cache, &cache->entries[i]);
+	slurm_mutex_unlock(&cache->mutex);
+
+	slurm_mutex_destroy(&cache->mutex);
+	cache->magic = ~AUTH_CACHE_MAGIC;
+	xfree(cache->entries);
+	xfree(cache->name);
+	xfree(cache);
+}
+
+extern bool auth_cache_find(auth_cache_t *cache, const char *token, int len,
+			    auth_cache_copy_t copy_func, void *arg)
+{
+	slurm_hash_t key = { 0 };
+	entry_t *entry;
+	bool found = false;
+
+	if (!cache || !token || (len <= 0))
+		return false;
+
+	xassert(cache->magic == AUTH_CACHE_MAGIC);
+
+	if (!(entry = _get_slot(cache, token, len, &key)))
+		return false;
+
+	slurm_mutex_lock(&cache->mutex);
+	cache->lookups++;
+
+	if (entry->data && !memcmp(&entry->key, &key, sizeof(key))) {
+		if (entry->expiration <= time(NULL)) {
+			cache->expired++;
+			_free_entry(cache, entry);
+		} else if ((found = copy_func(entry->data, arg))) {
+			cache->hits++;
+		}
+	}
+
+	if (!(cache->lookups % STATS_INTERVAL))
+		_log_stats(cache);
+	slurm_mutex_unlock(&cache->mutex);
+
+	return found;
+}
+
+extern void auth_cache_add(auth_cache_t *cache, const char *token, int len,
+			   time_t expiration, void *data)
+{
+	slurm_hash_t key = { 0 };
+	entry_t *entry;
+
+	if (!cache)
+		return;
+
+	xassert(cache->magic == AUTH_CACHE_MAGIC);
+	xassert(data);
+
+	if (!token || (len <= 0) || (expiration <= time(NULL)) ||
+	    !(entry = _get_slot(cache, token, len, &key))) {
+		cache->free_func(data);
+		return;
+	}
+
+	slurm_mutex_lock(&cache->mutex);
+	if (entry->data) {
+		if (entry->expiration > time(NULL))
+			cache->evicted++;
+		_free_entry(cache, entry);
+	}
+	entry->key = key;
+	entry->expiration = expiration;
+	entry->data = data;
+	slurm_mutex_unlock(&cache->mutex);
+}
+
+extern uint32_t auth_cache_get_size(void)
+{
+	char *tmp;
+	uint32_t size = DEFAULT_CACHE_SIZE;
+
+	if ((tmp = conf_get_opt_str(slurm_conf.authinfo, "cred_cache_size="))) {
+		size = strtoul(tmp, NULL, 10);
+		xfree(tmp);
+	}
+
+	return size;
+}
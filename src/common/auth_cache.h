@@ -0,0 +1,106 @@
+/*****************************************************************************\
+ *  auth_cache.h - verified authentication credential cache
+ *****************************************************************************
+ *  Copyright (C) SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _AUTH_CACHE_H
+#define _AUTH_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Cache of verified authentication credentials keyed by a K12 hash of the
+ * credential's wire form. Entries are dropped once the credential itself would
+ * have expired. The cache is direct-mapped: a colliding insert replaces the
+ * older entry, which keeps it bounded without any LRU bookkeeping.
+ */
+
+/* Opaque struct */
+typedef struct auth_cache_s auth_cache_t;
+
+/* Release data stored in the cache */
+typedef void (*auth_cache_free_t)(void *data);
+
+/*
+ * Check and copy cached data out of the cache. Called with the cache locked.
+ * IN data - data given to auth_cache_add()
+ * IN arg - arg given to auth_cache_find()
+ * RET true if the entry was accepted and copied, false to treat as a miss
+ */
+typedef bool (*auth_cache_copy_t)(void *data, void *arg);
+
+/*
+ * Create new credential cache
+ * IN name - name used when logging statistics
+ * IN size - number of slots in cache
+ * IN free_func - function to release data stored in cache
+ * RET ptr to cache or NULL if size is 0
+ */
+extern auth_cache_t *auth_cache_create(const char *name, uint32_t size,
+				       auth_cache_free_t free_func);
+
+extern void auth_cache_destroy(auth_cache_t *cache);
+
+/*
+ * Lookup credential in cache
+ * IN cache - cache to search (may be NULL)
+ * IN token - credential in the form it was received
+ * IN len - length of token
+ * IN copy_func - called on hit to check and copy out cached data
+ * IN arg - arg to pass to copy_func
+ * RET true if token was found, has not expired and copy_func accepted it
+ */
+extern bool auth_cache_find(auth_cache_t *cache, const char *token, int len,
+			    auth_cache_copy_t copy_func, void *arg);
+
+/*
+ * Add verified credential to cache
+ * IN cache - cache to add to (may be NULL)
+ * IN token - credential in the form it was received
+ * IN len - length of token
+ * IN expiration - time when credential expires
+ * IN data - data to store. Ownership is always taken by the cache.
+ */
+extern void auth_cache_add(auth_cache_t *cache, const char *token, int len,
+			   time_t expiration, void *data);
+
+/*
+ * Parse "cred_cache_size=" from AuthInfo
+ * RET size or default size if not specified
+ */
+extern uint32_t auth_cache_get_size(void);
+
+#endif
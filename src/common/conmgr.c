@@ -54,6 +54,10 @@
 #include <sys/ucred.h>
 #endif
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+
 #include "slurm/slurm.h"
 
 #include "src/common/conmgr.h"
@@ -89,6 +93,15 @@
 #define THREAD_COUNT_DEFAULT 10
 #define DEFAULT_READ_BYTES 512
 
+#if defined(__linux__)
+/* file descriptor registered with epoll */
+typedef struct {
+	conmgr_fd_t *con;
+	int fd; /* -1 if not registered */
+	uint32_t events; /* events requested from epoll */
+} epoll_watch_t;
+#endif
+
 /*
  * Connection tracking structure
  */
@@ -158,6 +171,14 @@ struct conmgr_fd_s {
 	 * type: work_t*
 	 */
 	list_t *write_complete_work;
+#if defined(__linux__)
+	/*
+	 * registrations with epoll:
+	 *	[0] input_fd (or both when input_fd == output_fd)
+	 *	[1] output_fd
+	 */
+	epoll_watch_t watch[2];
+#endif
 };
 
 typedef struct {
@@ -230,6 +251,8 @@ struct conmgr_s {
 	int event_fd[2];
 	/* Signal PIPE to catch POSIX signals */
 	int signal_fd[2];
+	/* epoll instance with persistent registration of connections */
+	int epoll_fd;
 
 	/* track when there is a pending signal to read */
 	bool signaled;
@@ -274,6 +297,7 @@ struct conmgr_s {
 		.max_connections = -1,\
 		.event_fd = { -1, -1 },\
 		.signal_fd = { -1, -1 },\
+		.epoll_fd = -1,\
 		.error = SLURM_SUCCESS,\
 		.quiesced = true,\
 		.shutdown = true,\
@@ -333,6 +357,10 @@ typedef struct {
 	int magic; /* MAGIC_POLL_ARGS */
 	struct pollfd *fds;
 	int nfds;
+#if defined(__linux__)
+	struct epoll_event *events;
+	int nevents;
+#endif
 } poll_args_t;
 
 typedef struct {
@@ -383,6 +411,78 @@ static int _find_by_fd(void *x, void *key)
 	return (con->input_fd == fd) || (con->output_fd == fd);
 }
 
+#if defined(__linux__)
+/*
+ * Register read end of pipe with epoll.
+ * Pipes have no connection and are identified by the address of the fd pair.
+ */
+static void _epoll_add_pipe(int *pipe_fd)
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.ptr = pipe_fd,
+	};
+
+	if (epoll_ctl(mgr.epoll_fd, EPOLL_CTL_ADD, pipe_fd[0], &ev))
+		fatal("%s: unable to add fd %d to epoll: %m",
+		      __func__, pipe_fd[0]);
+}
+
+/*
+ * Remove registration from epoll
+ * NOTE: must hold mgr.mutex
+ */
+static void _epoll_unwatch(epoll_watch_t *watch)
+{
+	if (watch->fd == -1)
+		return;
+
+	if (epoll_ctl(mgr.epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL))
+		log_flag(NET, "%s: [%s] epoll_ctl(EPOLL_CTL_DEL, %d) failed: %m",
+			 __func__, watch->con->name, watch->fd);
+
+	watch->fd = -1;
+	watch->events = 0;
+}
+
+/*
+ * Change registration with epoll only if the fd or events changed
+ * IN watch - registration to change
+ * IN fd - file descriptor to watch or -1 to stop watching
+ * IN events - epoll events to watch or 0 to stop watching
+ * NOTE: must hold mgr.mutex
+ * RET SLURM_SUCCESS or errno from epoll_ctl()
+ */
+static int _epoll_watch(epoll_watch_t *watch, int fd, uint32_t events)
+{
+	struct epoll_event ev = {
+		.events = events,
+		.data.ptr = watch,
+	};
+	int op = EPOLL_CTL_MOD;
+
+	if ((fd < 0) || !events) {
+		_epoll_unwatch(watch);
+		return SLURM_SUCCESS;
+	}
+
+	if ((watch->fd == fd) && (watch->events == events))
+		return SLURM_SUCCESS;
+
+	if (watch->fd != fd) {
+		_epoll_unwatch(watch);
+		op = EPOLL_CTL_ADD;
+	}
+
+	if (epoll_ctl(mgr.epoll_fd, op, fd, &ev))
+		return errno;
+
+	watch->fd = fd;
+	watch->events = events;
+	return SLURM_SUCCESS;
+}
+#endif /* __linux__ */
+
 extern const char *conmgr_work_status_string(conmgr_work_status_t status)
 {
 	for (int i = 0; i < ARRAY_SIZE(statuses); i++)
@@ -625,6 +725,14 @@ extern void init_conmgr(int thread_count, int max_connections,
 	fd_set_nonblocking(mgr.signal_fd[0]);
 	fd_set_blocking(mgr.signal_fd[1]);
 
+#if defined(__linux__)
+	if ((mgr.epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		fatal("%s: unable to create epoll instance: %m", __func__);
+
+	_epoll_add_pipe(mgr.signal_fd);
+	_epoll_add_pipe(mgr.event_fd);
+#endif
+
 	_add_signal_work(SIGALRM, _on_signal_alarm, NULL, "_on_signal_alarm()");
 
 	slurm_mutex_unlock(&mgr.mutex);
@@ -751,10 +859,30 @@ extern void free_conmgr(void)
 	if (close(mgr.signal_fd[0]) || close(mgr.signal_fd[1]))
 		error("%s: unable to close signal_fd: %m", __func__);
 
+	if ((mgr.epoll_fd != -1) && close(mgr.epoll_fd))
+		error("%s: unable to close epoll_fd: %m", __func__);
+	mgr.epoll_fd = -1;
+
 	slurm_mutex_destroy(&mgr.mutex);
 	slurm_cond_destroy(&mgr.cond);
 }
 
+/*
+ * Stop watching file descriptor which is about to be closed.
+ * NOTE: must hold mgr.mutex
+ */
+static void _unwatch_fd(conmgr_fd_t *con, int fd)
+{
+#if defined(__linux__)
+	if (fd < 0)
+		return;
+
+	for (int i = 0; i < ARRAY_SIZE(con->watch); i++)
+		if (con->watch[i].fd == fd)
+			_epoll_unwatch(&con->watch[i]);
+#endif
+}
+
 /*
  * Stop reading from connection but write out the remaining buffer and finish
  * any queued work
@@ -781,6 +909,8 @@ static void _close_con(bool locked, conmgr_fd_t *con)
 	/* mark it as EOF even if it hasn't */
 	con->read_eof = true;
 
+	_unwatch_fd(con, con->input_fd);
+
 	if (con->is_listen) {
 		if (close(con->input_fd) == -1)
 			log_flag(NET, "%s: [%s] unable to close listen fd %d: %m",
@@ -857,6 +987,14 @@ static conmgr_fd_t *_add_connection(conmgr_con_type_t type,
 		.type = type,
 	};
 
+#if defined(__linux__)
+	for (int i = 0; i < ARRAY_SIZE(con->watch); i++)
+		con->watch[i] = (epoll_watch_t) {
+			.con = con,
+			.fd = -1,
+		};
+#endif
+
 	if (!is_listen) {
 		con->in = create_buf(xmalloc(BUFFER_START_SIZE),
 				     BUFFER_START_SIZE);
@@ -1432,6 +1570,7 @@ static void _handle_poll_event_error(int fd, conmgr_fd_t *con, short revents)
 	 * infinite calls to poll() which will immidiatly fail. Close
 	 * the relavent file descriptor and remove from connection.
 	 */
+	_unwatch_fd(con, fd);
 	if (close(fd)) {
 		log_flag(NET, "%s: [%s] input_fd=%d output_fd=%d calling close(%d) failed after poll() returned %s%s%s: %m",
 			 __func__, con->name, con->input_fd, con->output_fd, fd,
@@ -1601,6 +1740,7 @@ static int _handle_connection(void *x, void *arg)
 		log_flag(NET, "%s: [%s] closing incoming on connection input_fd=%d",
 			 __func__, con->name, con->input_fd);
 
+		_unwatch_fd(con, con->input_fd);
 		if (close(con->input_fd) == -1)
 			log_flag(NET, "%s: [%s] unable to close input fd %d: %m",
 				 __func__, con->name, con->input_fd);
@@ -1654,6 +1794,7 @@ static int _handle_connection(void *x, void *arg)
 		 __func__, con->name, con->input_fd, con->output_fd);
 
 	if (con->output_fd != -1) {
+		_unwatch_fd(con, con->output_fd);
 		if (close(con->output_fd) == -1)
 			log_flag(NET, "%s: [%s] unable to close output fd %d: %m",
 				 __func__, con->name, con->output_fd);
@@ -1729,11 +1870,11 @@ static void _handle_listen_event(int fd, conmgr_fd_t *con, short revents)
 	_close_con(true, con);
 }
 
-static void _handle_event_pipe(const struct pollfd *fds_ptr, const char *tag,
+static void _handle_event_pipe(short revents, const char *tag,
 			       const char *name)
 {
 	if (slurm_conf.debug_flags & DEBUG_FLAG_NET) {
-		char *flags = poll_revents_to_str(fds_ptr->revents);
+		char *flags = poll_revents_to_str(revents);
 
 		log_flag(NET, "%s: [%s] signal pipe %s flags:%s",
 			 __func__, tag, name, flags);
@@ -1870,9 +2011,11 @@ again:
 
 		if (fds_ptr->fd == signal_fd) {
 			mgr.signaled = true;
-			_handle_event_pipe(fds_ptr, tag, "CAUGHT_SIGNAL");
+			_handle_event_pipe(fds_ptr->revents, tag,
+					   "CAUGHT_SIGNAL");
 		} else if (fds_ptr->fd == event_fd)
-			_handle_event_pipe(fds_ptr, tag, "CHANGE_EVENT");
+			_handle_event_pipe(fds_ptr->revents, tag,
+					   "CHANGE_EVENT");
 		else if ((con = list_find_first(fds, _find_by_fd,
 						&fds_ptr->fd))) {
 			if (slurm_conf.debug_flags & DEBUG_FLAG_NET) {
@@ -1897,6 +2040,230 @@ again:
 	}
 }
 
+#if defined(__linux__)
+/* Convert epoll events into poll() revents */
+static short _epoll_to_revents(uint32_t events)
+{
+	short revents = 0;
+
+	if (events & EPOLLIN)
+		revents |= POLLIN;
+	if (events & EPOLLPRI)
+		revents |= POLLPRI;
+	if (events & EPOLLOUT)
+		revents |= POLLOUT;
+	if (events & EPOLLERR)
+		revents |= POLLERR;
+	if (events & EPOLLHUP)
+		revents |= POLLHUP;
+
+	return revents;
+}
+
+/*
+ * Handle epoll_wait() and events
+ *
+ * NOTE: mgr mutex must not be locked but will be locked upon return
+ */
+static void _epoll(poll_args_t *args, int timeout, const char *tag)
+{
+	int nfds;
+
+again:
+	xassert(args->magic == MAGIC_POLL_ARGS);
+	nfds = epoll_wait(mgr.epoll_fd, args->events, args->nevents, timeout);
+	if (nfds == -1) {
+		bool exit_on_error;
+
+		slurm_mutex_lock(&mgr.mutex);
+		exit_on_error = mgr.exit_on_error;
+		slurm_mutex_unlock(&mgr.mutex);
+
+		if ((errno == EINTR) && !exit_on_error) {
+			log_flag(NET, "%s: [%s] epoll_wait interrupted. Trying again.",
+				 __func__, tag);
+			goto again;
+		}
+
+		fatal("%s: [%s] unable to epoll_wait connections: %m",
+		      __func__, tag);
+	}
+
+	if (nfds == 0) {
+		log_flag(NET, "%s: [%s] epoll_wait timed out", __func__, tag);
+		return;
+	}
+
+	for (int i = 0; i < nfds; i++) {
+		const struct epoll_event *ev = &args->events[i];
+		const short revents = _epoll_to_revents(ev->events);
+		epoll_watch_t *watch = ev->data.ptr;
+		conmgr_fd_t *con;
+
+		if (ev->data.ptr == mgr.signal_fd) {
+			mgr.signaled = true;
+			_handle_event_pipe(revents, tag, "CAUGHT_SIGNAL");
+			continue;
+		} else if (ev->data.ptr == mgr.event_fd) {
+			_handle_event_pipe(revents, tag, "CHANGE_EVENT");
+			continue;
+		}
+
+		slurm_mutex_lock(&mgr.mutex);
+
+		if (watch->fd == -1) {
+			/* FD got closed between epoll_wait start and now */
+			log_flag(NET, "%s: [%s->%s] ignoring event for closed connection",
+				 __func__, tag, watch->con->name);
+			slurm_mutex_unlock(&mgr.mutex);
+			continue;
+		}
+
+		con = watch->con;
+		xassert(con->magic == MAGIC_CON_MGR_FD);
+
+		if (slurm_conf.debug_flags & DEBUG_FLAG_NET) {
+			char *flags = poll_revents_to_str(revents);
+			log_flag(NET, "%s: [%s->%s] epoll event detect flags:%s",
+				 __func__, tag, con->name, flags);
+			xfree(flags);
+		}
+
+		_handle_poll_event(watch->fd, con, revents);
+		/*
+		 * signal that something might have happened and to
+		 * restart listening
+		 */
+		_signal_change(true);
+		slurm_mutex_unlock(&mgr.mutex);
+	}
+}
+
+/*
+ * Apply registration change and handle when epoll refuses the fd
+ * NOTE: must hold mgr.mutex
+ * RET true if event was already handled and epoll_wait() must not block
+ */
+static bool _epoll_update_watch(conmgr_fd_t *con, epoll_watch_t *watch,
+				int fd, uint32_t events)
+{
+	int rc;
+
+	if (!(rc = _epoll_watch(watch, fd, events)))
+		return false;
+
+	if (rc == EPERM) {
+		/*
+		 * epoll does not support regular files (or /dev/null) which
+		 * poll() always reports as ready.
+		 */
+		_handle_poll_event(fd, con, _epoll_to_revents(events));
+	} else {
+		log_flag(NET, "%s: [%s] unable to watch fd=%d: %s",
+			 __func__, con->name, fd, slurm_strerror(rc));
+		_handle_poll_event(fd, con, POLLNVAL);
+	}
+
+	return true;
+}
+
+/*
+ * Update epoll registrations of connection to match connection state.
+ * Registrations persist across calls and epoll_ctl() is only called when the
+ * file descriptors or events requested change.
+ *
+ * NOTE: must hold mgr.mutex
+ * IN/OUT ready_ptr - incremented for every fd that was already handled
+ * RET number of file descriptors registered
+ */
+static int _epoll_update_con(conmgr_fd_t *con, int *ready_ptr)
+{
+	int fds[ARRAY_SIZE(con->watch)] = { -1, -1 };
+	uint32_t events[ARRAY_SIZE(con->watch)] = { 0 };
+	int count = 0;
+
+	if (!con->work_active) {
+		log_flag(NET, "%s: [%s] watch read_eof=%s input=%u outputs=%u",
+			 __func__, con->name, (con->read_eof ? "T" : "F"),
+			 get_buf_offset(con->in), list_count(con->out));
+
+		if (con->input_fd == con->output_fd) {
+			/* if fd is same, only watch it */
+			fds[0] = con->input_fd;
+
+			if (con->input_fd != -1)
+				events[0] |= EPOLLIN;
+			if (!list_is_empty(con->out))
+				events[0] |= EPOLLOUT;
+		} else {
+			if (con->input_fd != -1) {
+				fds[0] = con->input_fd;
+				events[0] = EPOLLIN;
+			}
+
+			if (!list_is_empty(con->out)) {
+				fds[1] = con->output_fd;
+				events[1] = EPOLLOUT;
+			}
+		}
+	}
+
+	/* drop stale registrations first as an fd may move between them */
+	for (int i = 0; i < ARRAY_SIZE(con->watch); i++)
+		if ((con->watch[i].fd != fds[i]) || !events[i])
+			_epoll_unwatch(&con->watch[i]);
+
+	for (int i = 0; i < ARRAY_SIZE(con->watch); i++) {
+		if (_epoll_update_watch(con, &con->watch[i], fds[i],
+					events[i]))
+			(*ready_ptr)++;
+		else if (con->watch[i].fd != -1)
+			count++;
+	}
+
+	return count;
+}
+
+/*
+ * Sync all connections with epoll then wait for events
+ *
+ * NOTE: mgr mutex must be locked and will be locked upon return
+ */
+static void _epoll_connections(poll_args_t *args, int count)
+{
+	conmgr_fd_t *con;
+	list_itr_t *itr;
+	int watched = 0, ready = 0;
+
+	itr = list_iterator_create(mgr.connections);
+	while ((con = list_next(itr)))
+		watched += _epoll_update_con(con, &ready);
+	list_iterator_destroy(itr);
+
+	if (ready) {
+		/* events were handled directly so _watch() must run again */
+		_signal_change(true);
+	} else if (!watched) {
+		log_flag(NET, "%s: skipping epoll_wait() due to no open file descriptors for %d connections",
+			 __func__, count);
+		return;
+	}
+
+	/* signal and event pipes are always registered */
+	args->nevents = watched + 2;
+	xrecalloc(args->events, args->nevents, sizeof(*args->events));
+
+	slurm_mutex_unlock(&mgr.mutex);
+
+	log_flag(NET, "%s: waiting on %d file descriptors for %u connections",
+		 __func__, watched, count);
+
+	_epoll(args, (ready ? 0 : -1), __func__);
+
+	slurm_mutex_lock(&mgr.mutex);
+}
+#endif /* __linux__ */
+
 /*
  * Poll all processing connections sockets and
  * signal_fd and event_fd.
@@ -1904,10 +2271,12 @@ again:
 static void _poll_connections(void *x)
 {
 	poll_args_t *args = x;
+	int count;
+#if !defined(__linux__)
 	struct pollfd *fds_ptr = NULL;
 	conmgr_fd_t *con;
-	int count;
 	list_itr_t *itr;
+#endif
 
 	xassert(args->magic == MAGIC_POLL_ARGS);
 
@@ -1930,6 +2299,9 @@ static void _poll_connections(void *x)
 		goto done;
 	}
 
+#if defined(__linux__)
+	_epoll_connections(args, count);
+#else /* !__linux__ */
 	xrecalloc(args->fds, ((count * 2) + 2), sizeof(*args->fds));
 
 	args->nfds = 0;
@@ -2008,6 +2380,7 @@ static void _poll_connections(void *x)
 	_poll(args, mgr.connections, _handle_poll_event, __func__);
 
 	slurm_mutex_lock(&mgr.mutex);
+#endif /* !__linux__ */
 done:
 	mgr.poll_active = false;
 	/* notify _watch it can run but don't send signal to event PIPE*/
@@ -2330,6 +2703,9 @@ quiesced:
 		xassert(poll_args->magic == MAGIC_POLL_ARGS);
 		poll_args->magic = ~MAGIC_POLL_ARGS;
 		xfree(poll_args->fds);
+#if defined(__linux__)
+		xfree(poll_args->events);
+#endif
 		xfree(poll_args);
 	}
 
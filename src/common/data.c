@@ -43,6 +43,7 @@
 #include "src/common/log.h"
 #include "src/common/read_config.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -50,6 +51,8 @@
 #define DATA_MAGIC 0x1992189F
 #define DATA_LIST_MAGIC 0x1992F89F
 #define DATA_LIST_NODE_MAGIC 0x1921F89F
+/* dictionaries with at least this many entries get a key index */
+#define DATA_DICT_INDEX_THRESHOLD 16
 
 typedef struct data_list_s data_list_t;
 typedef struct data_list_node_s data_list_node_t;
@@ -102,6 +105,13 @@ typedef struct data_list_s {
 
 	data_list_node_t *begin;
 	data_list_node_t *end;
+
+	/*
+	 * Index of dictionary nodes by key. Only created once a dictionary
+	 * reaches DATA_DICT_INDEX_THRESHOLD entries. Nodes are still linked
+	 * above to preserve insertion order.
+	 */
+	xhash_t *index;
 } data_list_t;
 
 /*
@@ -257,6 +267,9 @@ static void _release_data_list_node(data_list_t *dl, data_list_node_t *dn)
 		prev->next = dn->next;
 	}
 
+	if (dl->index && dn->key)
+		(void) xhash_pop_str(dl->index, dn->key);
+
 	dl->count--;
 	FREE_NULL_DATA(dn->data);
 	xfree(dn->key);
@@ -275,6 +288,9 @@ static void _release_data_list(data_list_t *dl)
 
 	_check_data_list_magic(dl);
 
+	/* every node is about to be released so skip popping each one */
+	xhash_free(dl->index);
+
 	if (!n) {
 		xassert(!dl->count);
 		xassert(!dl->end);
@@ -328,6 +344,58 @@ static data_list_node_t *_new_data_list_node(data_t *d, const char *key)
 	return dn;
 }
 
+static void _data_list_node_key(void *item, const char **key,
+				uint32_t *key_len)
+{
+	data_list_node_t *dn = item;
+
+	*key = dn->key;
+	*key_len = strlen(dn->key);
+}
+
+/* Add dictionary node to index, creating index once dictionary is large */
+static void _index_data_list_node(data_list_t *dl, data_list_node_t *n)
+{
+	if (!n->key)
+		return;
+
+	if (dl->index) {
+		xhash_add(dl->index, n);
+		return;
+	}
+
+	if (dl->count < DATA_DICT_INDEX_THRESHOLD)
+		return;
+
+	dl->index = xhash_init(_data_list_node_key, NULL);
+	for (data_list_node_t *i = dl->begin; i; i = i->next)
+		xhash_add(dl->index, i);
+
+	log_flag(DATA, "%s: indexed data-list(0x%"PRIxPTR")[%zu]",
+		 __func__, (uintptr_t) dl, dl->count);
+}
+
+/* Find dictionary node by key or NULL if not found */
+static data_list_node_t *_find_dict_node(const data_list_t *dl,
+					 const char *key)
+{
+	data_list_node_t *i;
+
+	_check_data_list_magic(dl);
+
+	if (dl->index)
+		return xhash_get_str(dl->index, key);
+
+	for (i = dl->begin; i; i = i->next) {
+		_check_data_list_node_magic(i);
+
+		if (!xstrcmp(key, i->key))
+			break;
+	}
+
+	return i;
+}
+
 static void _data_list_append(data_list_t *dl, data_t *d, const char *key)
 {
 	data_list_node_t *n = _new_data_list_node(d, key);
@@ -348,6 +416,7 @@ static void _data_list_append(data_list_t *dl, data_t *d, const char *key)
 	}
 
 	dl->count++;
+	_index_data_list_node(dl, n);
 
 	if (n->key)
 		log_flag(DATA, "%s: append dictionary entry data-list-node(0x%"PRIxPTR")[%s]=%pD",
@@ -374,6 +443,7 @@ static void _data_list_prepend(data_list_t *dl, data_t *d, const char *key)
 	}
 
 	dl->count++;
+	_index_data_list_node(dl, n);
 
 	log_flag(DATA, "%s: prepend %pD[%s]->data-list-node(0x%"PRIxPTR")[%s]=%pD",
 		 __func__, d, key, (uintptr_t) n, n->key, n->data);
@@ -763,32 +833,15 @@ extern const data_t *data_key_get_const(const data_t *data, const char *key)
 	if (!data->data.dict_u->count)
 		return NULL;
 
-	_check_data_list_magic(data->data.dict_u);
-	i = data->data.dict_u->begin;
-	while (i) {
-		_check_data_list_node_magic(i);
-
-		if (!xstrcmp(key, i->key))
-			break;
-
-		i = i->next;
-	}
-
-	if (i)
+	if ((i = _find_dict_node(data->data.dict_u, key)))
 		return i->data;
 	else
 		return NULL;
 }
 
-static bool _match_string(const char *key, data_t *data, void *needle_ptr)
-{
-	const char *needle = needle_ptr;
-	return !xstrcmp(key, needle);
-}
-
 extern data_t *data_key_get(data_t *data, const char *key)
 {
-	return data_dict_find_first(data, _match_string, (void *) key);
+	return (data_t *) data_key_get_const(data, key);
 }
 
 extern data_t *data_key_get_int(data_t *data, int64_t key)
@@ -924,18 +977,7 @@ extern bool data_key_unset(data_t *data, const char *key)
 	if (!key || data->type != TYPE_DICT)
 		return NULL;
 
-	_check_data_list_magic(data->data.dict_u);
-	i = data->data.dict_u->begin;
-	while (i) {
-		_check_data_list_node_magic(i);
-
-		if (!xstrcmp(key, i->key))
-			break;
-
-		i = i->next;
-	}
-
-	if (!i) {
+	if (!(i = _find_dict_node(data->data.dict_u, key))) {
 		log_flag(DATA, "%s: remove non-existent key in %pD[%s]",
 			 __func__, data, key);
 		return false;
@@ -53,12 +53,36 @@
 #include "src/common/read_config.h"
 #include "src/common/slurm_protocol_interface.h"
 #include "src/common/slurm_protocol_pack.h"
+#include "src/common/timers.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
+#define FWD_FAIL_AGE	300	/* secs a failed node is kept out of the tree */
+#define FWD_SLOW_FACTOR	4	/* slow if this many times the average */
+#define FWD_SLOW_MIN	100000	/* usecs, never call faster nodes slow */
+
+typedef enum {
+	FWD_NODE_OK,
+	FWD_NODE_SLOW,
+	FWD_NODE_FAILED,
+	FWD_NODE_STATE_CNT
+} fwd_node_state_t;
+
+/* What we learned contacting a node, only kept for failed or timed nodes */
+typedef struct {
+	char *name;
+	int usec;		/* moving average of response time */
+	time_t fail_time;	/* last failure, 0 if it responded since */
+} fwd_node_t;
+
 static slurm_node_alias_addrs_t *last_alias_addrs = NULL;
 static pthread_mutex_t alias_addrs_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+static xhash_t *fwd_node_hash = NULL;
+static int fwd_node_usec = 0;		/* moving average of all nodes */
+static pthread_mutex_t fwd_node_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 typedef struct {
 	pthread_cond_t *notify;
 	int            *p_thr_count;
@@ -76,6 +100,7 @@ static void _forward_msg_internal(hostlist_t *hl, hostlist_t **sp_hl,
 				  forward_struct_t *fwd_struct,
 				  header_t *header, int timeout,
 				  int hl_count);
+static void _record_ret_list(List ret_list, const char *name, int usec);
 
 void _destroy_tree_fwd(fwd_tree_t *fwd_tree)
 {
@@ -122,6 +147,7 @@ static void *_forward_thread(void *arg)
 	char *buf = NULL;
 	int steps = 0;
 	int start_timeout = fwd_msg->timeout;
+	struct timeval tv;
 
 	/* repeat until we are sure the message was sent */
 	while ((name = hostlist_shift(hl))) {
@@ -140,9 +166,12 @@ static void *_forward_thread(void *arg)
 			}
 			goto cleanup;
 		}
+		gettimeofday(&tv, NULL);
 		if ((fd = slurm_open_msg_conn(&addr)) < 0) {
 			error("%s: failed to %s (%pA): %m",
 			      __func__, name, &addr);
+			fwd_node_record(name, SLURM_COMMUNICATIONS_CONNECTION_ERROR,
+					-1);
 
 			slurm_mutex_lock(&fwd_struct->forward_mutex);
 			mark_as_failed_forward(
@@ -206,11 +235,14 @@ static void *_forward_thread(void *arg)
 		if (slurm_msg_sendto(fd,
 				     get_buf_data(buffer),
 				     get_buf_offset(buffer)) < 0) {
+			int err = errno;
+
 			error("%s: slurm_msg_sendto: %m", __func__);
+			fwd_node_record(name, err, -1);
 
 			slurm_mutex_lock(&fwd_struct->forward_mutex);
 			mark_as_failed_forward(&fwd_struct->ret_list, name,
-					       errno);
+					       err);
 			free(name);
 			if (hostlist_count(hl) > 0) {
 				FREE_NULL_BUFFER(buffer);
@@ -273,9 +305,12 @@ static void *_forward_thread(void *arg)
 
 		if (!ret_list || (fwd_msg->header.forward.cnt != 0
 				  && list_count(ret_list) <= 1)) {
+			int err = errno;
+
+			fwd_node_record(name, err ? err : SLURM_ERROR, -1);
 			slurm_mutex_lock(&fwd_struct->forward_mutex);
 			mark_as_failed_forward(&fwd_struct->ret_list, name,
-					       errno);
+					       err);
 			free(name);
 			FREE_NULL_LIST(ret_list);
 			if (hostlist_count(hl) > 0) {
@@ -341,12 +376,19 @@ static void *_forward_thread(void *arg)
 		}
 		break;
 	}
+	if (ret_list) {
+		list_itr_t *itr = list_iterator_create(ret_list);
+		while ((ret_data_info = list_next(itr)))
+			if (!ret_data_info->node_name)
+				ret_data_info->node_name = xstrdup(name);
+		list_iterator_destroy(itr);
+		_record_ret_list(ret_list, name,
+				 fwd_msg->header.forward.cnt ?
+				 -1 : slurm_delta_tv(&tv));
+	}
 	slurm_mutex_lock(&fwd_struct->forward_mutex);
 	if (ret_list) {
 		while ((ret_data_info = list_pop(ret_list)) != NULL) {
-			if (!ret_data_info->node_name) {
-				ret_data_info->node_name = xstrdup(name);
-			}
 			list_push(fwd_struct->ret_list, ret_data_info);
 			debug3("got response from %s",
 			       ret_data_info->node_name);
@@ -407,6 +449,7 @@ static void *_fwd_tree_thread(void *arg)
 	char *name = NULL;
 	char *buf = NULL;
 	slurm_msg_t send_msg;
+	struct timeval tv;
 
 	slurm_msg_t_init(&send_msg);
 	send_msg.msg_type = fwd_tree->orig_msg->msg_type;
@@ -450,6 +493,7 @@ static void *_fwd_tree_thread(void *arg)
 		} else
 			debug3("Tree sending to %s", name);
 
+		gettimeofday(&tv, NULL);
 		ret_list = slurm_send_addr_recv_msgs(&send_msg, name,
 						     fwd_tree->timeout);
 
@@ -457,6 +501,10 @@ static void *_fwd_tree_thread(void *arg)
 
 		if (ret_list) {
 			int ret_cnt = list_count(ret_list);
+
+			_record_ret_list(ret_list, name,
+					 send_msg.forward.cnt ?
+					 -1 : slurm_delta_tv(&tv));
 			/* This is most common if a slurmd is running
 			   an older version of Slurm than the
 			   originator of the message.
@@ -679,8 +727,8 @@ extern int forward_msg(forward_struct_t *forward_struct, header_t *header)
 
 	hostlist_uniq(hl);
 
-	if (topology_g_split_hostlist(
-		    hl, &sp_hl, &hl_count, header->forward.tree_width)) {
+	if (fwd_split_hostlist(hl, &sp_hl, &hl_count,
+			       header->forward.tree_width)) {
 		error("unable to split forward hostlist");
 		hostlist_destroy(hl);
 		return SLURM_ERROR;
@@ -792,6 +840,209 @@ static void _get_dynamic_addrs(hostlist_t *hl, slurm_msg_t *msg)
 	slurm_mutex_unlock(&alias_addrs_mutex);
 }
 
+extern int fwd_prepare_msg_tree(hostlist_t *hl, slurm_msg_t *msg)
+{
+	int host_count;
+
+	xassert(hl);
+	xassert(msg);
+
+	hostlist_uniq(hl);
+	host_count = hostlist_count(hl);
+
+	_get_alias_addrs(hl, msg, &host_count);
+	_get_dynamic_addrs(hl, msg);
+
+	return host_count;
+}
+
+static void _fwd_node_id(void *item, const char **key, uint32_t *key_len)
+{
+	fwd_node_t *node = item;
+
+	*key = node->name;
+	*key_len = strlen(node->name);
+}
+
+static void _fwd_node_free(void *item)
+{
+	fwd_node_t *node = item;
+
+	xfree(node->name);
+	xfree(node);
+}
+
+extern void fwd_node_record(const char *name, int rc, int usec)
+{
+	fwd_node_t *node;
+
+	if (!name)
+		return;
+
+	slurm_mutex_lock(&fwd_node_mutex);
+	if (!fwd_node_hash)
+		fwd_node_hash = xhash_init(_fwd_node_id, _fwd_node_free);
+
+	if (!(node = xhash_get_str(fwd_node_hash, name))) {
+		/* Nothing worth remembering about this node */
+		if (!rc && (usec < 0)) {
+			slurm_mutex_unlock(&fwd_node_mutex);
+			return;
+		}
+		node = xmalloc(sizeof(*node));
+		node->name = xstrdup(name);
+		node->usec = -1;
+		xhash_add(fwd_node_hash, node);
+	}
+
+	if (rc) {
+		if (!node->fail_time)
+			log_flag(ROUTE, "%s: %s failed (%s), moving it to the end of branches",
+				 __func__, name, slurm_strerror(rc));
+		node->fail_time = time(NULL);
+	} else {
+		node->fail_time = 0;
+	}
+
+	if (usec >= 0) {
+		if (node->usec < 0)
+			node->usec = usec;
+		else
+			node->usec = ((node->usec * 7) + usec) / 8;
+		if (!fwd_node_usec)
+			fwd_node_usec = usec;
+		else
+			fwd_node_usec = ((fwd_node_usec * 7) + usec) / 8;
+	}
+	slurm_mutex_unlock(&fwd_node_mutex);
+}
+
+typedef struct {
+	const char *name;
+	int usec;
+} record_ret_args_t;
+
+static int _record_ret_data(void *x, void *arg)
+{
+	ret_data_info_t *ret_data_info = x;
+	record_ret_args_t *args = arg;
+	int rc = SLURM_SUCCESS, usec = -1;
+
+	if (ret_data_info->type == RESPONSE_FORWARD_FAILED)
+		rc = ret_data_info->err ? ret_data_info->err : SLURM_ERROR;
+	else if (args->name && !xstrcmp(args->name, ret_data_info->node_name))
+		usec = args->usec;
+	fwd_node_record(ret_data_info->node_name, rc, usec);
+
+	return 0;
+}
+
+/*
+ * Record every node of a response list. name, if set, is the node that was
+ * contacted directly without forwarding and took usec to respond.
+ */
+static void _record_ret_list(List ret_list, const char *name, int usec)
+{
+	record_ret_args_t args = {
+		.name = name,
+		.usec = usec,
+	};
+
+	if (ret_list)
+		(void) list_for_each(ret_list, _record_ret_data, &args);
+}
+
+extern void fwd_node_record_ret_list(List ret_list)
+{
+	_record_ret_list(ret_list, NULL, -1);
+}
+
+/* Must hold fwd_node_mutex */
+static fwd_node_state_t _fwd_node_state(const char *name, time_t now)
+{
+	fwd_node_t *node = xhash_get_str(fwd_node_hash, name);
+
+	if (!node)
+		return FWD_NODE_OK;
+	if (node->fail_time && ((now - node->fail_time) < FWD_FAIL_AGE))
+		return FWD_NODE_FAILED;
+	if ((node->usec > FWD_SLOW_MIN) &&
+	    (node->usec > (fwd_node_usec * FWD_SLOW_FACTOR)))
+		return FWD_NODE_SLOW;
+	return FWD_NODE_OK;
+}
+
+/*
+ * Move nodes that are slow or failed to the end of the branch, keeping the
+ * order of nodes in the same state. The branch head, and the node tried next
+ * if it does not respond, is then the first healthy node.
+ * Must hold fwd_node_mutex.
+ */
+static hostlist_t *_order_branch(hostlist_t *hl, time_t now)
+{
+	hostlist_t *state_hl[FWD_NODE_STATE_CNT] = { NULL };
+	hostlist_iterator_t *itr;
+	fwd_node_state_t state, max_state = FWD_NODE_OK;
+	bool ordered = true;
+	char *name;
+
+	itr = hostlist_iterator_create(hl);
+	while ((name = hostlist_next(itr))) {
+		state = _fwd_node_state(name, now);
+		if (state < max_state)
+			ordered = false;
+		else
+			max_state = state;
+		free(name);
+		if (!ordered)
+			break;
+	}
+	hostlist_iterator_destroy(itr);
+
+	if (ordered)
+		return hl;
+
+	for (int i = 0; i < FWD_NODE_STATE_CNT; i++)
+		state_hl[i] = hostlist_create(NULL);
+	while ((name = hostlist_shift(hl))) {
+		hostlist_push_host(state_hl[_fwd_node_state(name, now)], name);
+		free(name);
+	}
+	hostlist_destroy(hl);
+
+	for (int i = 1; i < FWD_NODE_STATE_CNT; i++) {
+		hostlist_push_list(state_hl[FWD_NODE_OK], state_hl[i]);
+		hostlist_destroy(state_hl[i]);
+	}
+
+	if (slurm_conf.debug_flags & DEBUG_FLAG_ROUTE) {
+		char *buf = hostlist_ranged_string_xmalloc(state_hl[FWD_NODE_OK]);
+		log_flag(ROUTE, "reordered branch to %s", buf);
+		xfree(buf);
+	}
+
+	return state_hl[FWD_NODE_OK];
+}
+
+extern int fwd_split_hostlist(hostlist_t *hl, hostlist_t ***sp_hl, int *count,
+			      uint16_t tree_width)
+{
+	time_t now;
+
+	if (topology_g_split_hostlist(hl, sp_hl, count, tree_width))
+		return SLURM_ERROR;
+
+	slurm_mutex_lock(&fwd_node_mutex);
+	if (fwd_node_hash && xhash_count(fwd_node_hash)) {
+		now = time(NULL);
+		for (int i = 0; i < *count; i++)
+			(*sp_hl)[i] = _order_branch((*sp_hl)[i], now);
+	}
+	slurm_mutex_unlock(&fwd_node_mutex);
+
+	return SLURM_SUCCESS;
+}
+
 /*
  * start_msg_tree  - logic to begin the forward tree and
  *                   accumulate the return codes from processes getting the
@@ -819,14 +1070,10 @@ extern List start_msg_tree(hostlist_t *hl, slurm_msg_t *msg, int timeout)
 	xassert(hl);
 	xassert(msg);
 
-	hostlist_uniq(hl);
-	host_count = hostlist_count(hl);
-
-	_get_alias_addrs(hl, msg, &host_count);
-	_get_dynamic_addrs(hl, msg);
+	host_count = fwd_prepare_msg_tree(hl, msg);
 
-	if (topology_g_split_hostlist(hl, &sp_hl, &hl_count,
-				      msg->forward.tree_width)) {
+	if (fwd_split_hostlist(hl, &sp_hl, &hl_count,
+			       msg->forward.tree_width)) {
 		error("unable to split forward hostlist");
 		return NULL;
 	}
@@ -99,6 +99,50 @@ extern int forward_msg(forward_struct_t *forward_struct,
  */
 extern List start_msg_tree(hostlist_t *hl, slurm_msg_t *msg, int timeout);
 
+/*
+ * fwd_prepare_msg_tree - remove duplicate hosts from hl and set up any
+ *	addresses msg needs to carry to reach them, as start_msg_tree() does
+ *	before splitting hl.
+ *
+ * IN/OUT: hl      - hostlist_t   - list of every node to send message to,
+ *                                  unresolvable nodes may be removed
+ * IN/OUT: msg     - slurm_msg_t  - message to send
+ * RET int         - number of hosts left in hl
+ */
+extern int fwd_prepare_msg_tree(hostlist_t *hl, slurm_msg_t *msg);
+
+/*
+ * fwd_split_hostlist - split hl into branches with topology_g_split_hostlist()
+ *	and reorder each branch so that nodes which recently failed or respond
+ *	much slower than the rest are not picked as branch heads.
+ *
+ * IN: hl          - hostlist_t   - list of every node to send message to
+ * OUT: sp_hl      - hostlist_t** - the array of hostlists that will be malloced
+ * OUT: count      - int *        - the count of created hostlists
+ * IN: tree_width  - uint16_t     - desired width of each branch, 0 for default
+ * RET: SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int fwd_split_hostlist(hostlist_t *hl, hostlist_t ***sp_hl, int *count,
+			      uint16_t tree_width);
+
+/*
+ * fwd_node_record - note the outcome of contacting a node, used by
+ *	fwd_split_hostlist() to build later trees
+ *
+ * IN: name        - char *       - node name
+ * IN: rc          - int          - SLURM_SUCCESS or error contacting the node
+ * IN: usec        - int          - time the node took to respond on its own,
+ *                                  -1 if unknown (e.g. it forwarded too)
+ */
+extern void fwd_node_record(const char *name, int rc, int usec);
+
+/*
+ * fwd_node_record_ret_list - fwd_node_record() every node in a response list
+ *
+ * IN: ret_list    - List         - list of ret_data_info_t
+ */
+extern void fwd_node_record_ret_list(List ret_list);
+
 /*
  * mark_as_failed_forward- mark a node as failed and add it to "ret_list"
  *
@@ -1618,6 +1618,8 @@ uint16_t parse_compress_type(const char *arg)
 	if (!arg) {
 #if HAVE_LZ4
 		return COMPRESS_LZ4;
+#elif HAVE_ZSTD
+		return COMPRESS_ZSTD;
 #else
 		error("No compression library available, compression disabled.");
 		return COMPRESS_OFF;
@@ -1626,6 +1628,8 @@ uint16_t parse_compress_type(const char *arg)
 
 	if (!strcasecmp(arg, "lz4"))
 		return COMPRESS_LZ4;
+	else if (!strcasecmp(arg, "zstd"))
+		return COMPRESS_ZSTD;
 	else if (!strcasecmp(arg, "none"))
 		return COMPRESS_OFF;
 
@@ -533,6 +533,8 @@ slurm_errtab_t slurm_errtab[] = {
 	  "Unable to satisfy cpu bind request"			},
 	{ ERRTAB_ENTRY(ESLURMD_CPU_LAYOUT_ERROR),
 	  "Unable to layout tasks on given cpus"		},
+	{ ERRTAB_ENTRY(ESLURMD_BCAST_BLOCK_NOT_CACHED),
+	  "File broadcast block not in cache"			},
 
 	/* socket specific Slurm communications error */
 
@@ -977,6 +977,8 @@ static char *arg_get_compress(slurm_opt_t *opt)
 
 	if (opt->srun_opt->compress == COMPRESS_LZ4)
 		return xstrdup("lz4");
+	if (opt->srun_opt->compress == COMPRESS_ZSTD)
+		return xstrdup("zstd");
 	return xstrdup("none");
 }
 static void arg_reset_compress(slurm_opt_t *opt)
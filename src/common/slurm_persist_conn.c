@@ -38,6 +38,7 @@
 
 #include <poll.h>
 #include <pthread.h>
+#include <sys/uio.h>
 
 #if HAVE_SYS_PRCTL_H
 #include <sys/prctl.h>
@@ -450,9 +451,10 @@ extern void slurm_persist_conn_recv_thread_init(slurm_persist_conn_t *persist_co
 	service_conn->conn = persist_conn;
 	service_conn->thread_loc = thread_loc;
 
-	persist_conn->timeout = 0; /* If this isn't zero we won't wait forever
-				      like we want to.
-				   */
+	if (!(persist_conn->flags & PERSIST_FLAG_IDLE_TIMEOUT))
+		persist_conn->timeout = 0; /* If this isn't zero we won't wait
+					      forever like we want to.
+					   */
 
 	//_service_connection(service_conn);
 	slurm_thread_create(&persist_service_conn[thread_loc]->thread_id,
@@ -584,6 +586,21 @@ extern int slurm_persist_conn_open_without_init(
  * Returned completely filled in.
  * Returns SLURM_SUCCESS on success or SLURM_ERROR on failure */
 extern int slurm_persist_conn_open(slurm_persist_conn_t *persist_conn)
+{
+	if (!persist_conn->shutdown)
+		persist_conn->shutdown = &shutdown_time;
+
+	if (slurm_persist_conn_open_without_init(persist_conn) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	return slurm_persist_conn_init(persist_conn);
+}
+
+/* Send an init message over an already opened persistent socket connection
+ * IN/OUT - persistent connection with fd, rem_host and rem_port filled in.
+ * Returned completely filled in.
+ * Returns SLURM_SUCCESS on success or SLURM_ERROR on failure */
+extern int slurm_persist_conn_init(slurm_persist_conn_t *persist_conn)
 {
 	int rc = SLURM_ERROR;
 	slurm_msg_t req_msg;
@@ -593,9 +610,6 @@ extern int slurm_persist_conn_open(slurm_persist_conn_t *persist_conn)
 	if (!persist_conn->shutdown)
 		persist_conn->shutdown = &shutdown_time;
 
-	if (slurm_persist_conn_open_without_init(persist_conn) != SLURM_SUCCESS)
-		return rc;
-
 	slurm_msg_t_init(&req_msg);
 
 	/* Always send the lowest protocol since we don't know what version the
@@ -651,7 +665,13 @@ extern int slurm_persist_conn_open(slurm_persist_conn_t *persist_conn)
 		}
 
 		if (rc != SLURM_SUCCESS) {
-			if (resp) {
+			if (resp && (persist_conn->flags &
+				     PERSIST_FLAG_SUPPRESS_ERR)) {
+				log_flag(NET, "%s: persistent connection init to %s:%d refused: %s",
+					 __func__, persist_conn->rem_host,
+					 persist_conn->rem_port,
+					 slurm_strerror(rc));
+			} else if (resp) {
 				error("%s: Something happened with the receiving/processing of the persistent connection init message to %s:%d: %s",
 				      __func__, persist_conn->rem_host,
 				      persist_conn->rem_port, resp->comment);
@@ -870,6 +890,7 @@ extern int slurm_persist_send_msg(slurm_persist_conn_t *persist_conn,
 	char *msg;
 	ssize_t msg_wrote;
 	int rc, retry_cnt = 0;
+	struct iovec iov[2];
 
 	xassert(persist_conn);
 
@@ -901,11 +922,24 @@ extern int slurm_persist_send_msg(slurm_persist_conn_t *persist_conn,
 
 	msg_size = get_buf_offset(buffer);
 	nw_size = htonl(msg_size);
-	msg_wrote = write(persist_conn->fd, &nw_size, sizeof(nw_size));
-	if (msg_wrote != sizeof(nw_size))
+	msg = get_buf_data(buffer);
+
+	/*
+	 * Send the size together with the message. Writing the size alone
+	 * lets Nagle's algorithm hold back the message until the size is
+	 * acknowledged, which costs a delayed ACK on every request.
+	 */
+	iov[0].iov_base = &nw_size;
+	iov[0].iov_len = sizeof(nw_size);
+	iov[1].iov_base = msg;
+	iov[1].iov_len = msg_size;
+	msg_wrote = writev(persist_conn->fd, iov, 2);
+	if (msg_wrote < (ssize_t) sizeof(nw_size))
 		return EAGAIN;
+	msg_wrote -= sizeof(nw_size);
+	msg += msg_wrote;
+	msg_size -= msg_wrote;
 
-	msg = get_buf_data(buffer);
 	while (msg_size > 0) {
 		rc = slurm_persist_conn_writeable(persist_conn);
 		if (rc == -1)
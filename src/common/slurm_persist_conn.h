@@ -47,6 +47,10 @@
 #define PERSIST_FLAG_SUPPRESS_ERR   SLURM_BIT(4)
 #define PERSIST_FLAG_EXT_DBD        SLURM_BIT(5)
 #define PERSIST_FLAG_DONT_UPDATE_CLUSTER SLURM_BIT(6)
+#define PERSIST_FLAG_IDLE_TIMEOUT   SLURM_BIT(7) /* close after timeout idle */
+
+/* slurmctld closes persistent client connections idle for this long */
+#define PERSIST_CLIENT_IDLE_TIMEOUT 300 /* seconds */
 
 #define PERSIST_CONN_NOT_INITED -2
 
@@ -57,6 +61,7 @@ typedef enum {
 	PERSIST_TYPE_HA_CTL,
 	PERSIST_TYPE_HA_DBD,
 	PERSIST_TYPE_ACCT_UPDATE,
+	PERSIST_TYPE_CLIENT,
 } persist_conn_type_t;
 
 typedef struct {
@@ -121,6 +126,9 @@ extern void slurm_persist_conn_recv_server_fini(void);
  * IN - thread_loc - location in the persist_conn thread pool.  This number can
  *                   be got from slurm_persist_conn_wait_for_thread_loc or given
  *                   -1 to get one inside the function.
+ * The connection waits forever for the next message unless
+ * PERSIST_FLAG_IDLE_TIMEOUT is set, in which case it is closed once idle for
+ * persist_conn->timeout msec.
  * IN - arg - arbitrary argument that will be sent to the callback as well as
  *            the callback in the persist_conn.
  */
@@ -150,6 +158,13 @@ extern int slurm_persist_conn_open_without_init(
  * Returns SLURM_SUCCESS on success or SLURM_ERROR on failure */
 extern int slurm_persist_conn_open(slurm_persist_conn_t *persist_conn);
 
+/* Send an init message over an already opened persistent socket connection
+ * to establish the connection.
+ * IN/OUT - persistent connection with fd, rem_host and rem_port filled in.
+ * Returned completely filled in.
+ * Returns SLURM_SUCCESS on success or SLURM_ERROR on failure */
+extern int slurm_persist_conn_init(slurm_persist_conn_t *persist_conn);
+
 /* Close the persistent connection don't free structure or members */
 extern void slurm_persist_conn_close(slurm_persist_conn_t *persist_conn);
 
@@ -66,6 +66,7 @@
 #include "src/common/net.h"
 #include "src/common/pack.h"
 #include "src/common/read_config.h"
+#include "src/common/slurm_persist_conn.h"
 #include "src/interfaces/accounting_storage.h"
 #include "src/interfaces/auth.h"
 #include "src/common/slurm_protocol_interface.h"
@@ -96,10 +97,19 @@ strong_alias(get_unit_type, slurm_get_unit_type);
 /* EXTERNAL VARIABLES */
 
 /* #DEFINES */
+/* how long to wait before retrying a refused persistent connection */
+#define CTLD_PERSIST_RETRY_SEC 60
 
 /* STATIC VARIABLES */
 static int message_timeout = -1;
 
+/* see slurm_persist_controller_conn_init() */
+static pthread_mutex_t ctld_persist_lock = PTHREAD_MUTEX_INITIALIZER;
+static slurm_persist_conn_t *ctld_persist_conn = NULL;
+static bool ctld_persist_enabled = false;
+static time_t ctld_persist_retry = 0;
+static time_t ctld_persist_last_use = 0;
+
 /* STATIC FUNCTIONS */
 static char *_global_auth_key(void);
 static void  _remap_slurmctld_errno(void);
@@ -1077,12 +1087,8 @@ List slurm_receive_msgs(int fd, int steps, int timeout)
 {
 	char *buf = NULL;
 	size_t buflen = 0;
-	header_t header;
 	int rc;
-	void *auth_cred = NULL;
-	slurm_msg_t msg;
 	buf_t *buffer;
-	ret_data_info_t *ret_data_info = NULL;
 	List ret_list = NULL;
 	int orig_timeout = timeout;
 	char *peer = NULL;
@@ -1097,9 +1103,6 @@ List slurm_receive_msgs(int fd, int steps, int timeout)
 		peer = fd_resolve_peer(fd);
 	}
 
-	slurm_msg_t_init(&msg);
-	msg.conn_fd = fd;
-
 	if (timeout <= 0) {
 		/* convert secs to msec */
 		timeout = slurm_conf.msg_timeout * 1000;
@@ -1134,14 +1137,49 @@ List slurm_receive_msgs(int fd, int steps, int timeout)
 	 *  the message.
 	 */
 	if (slurm_msg_recvfrom_timeout(fd, &buf, &buflen, 0, timeout) < 0) {
-		forward_init(&header.forward);
 		rc = errno;
-		goto total_return;
+
+		/* peer may have not been resolved already */
+		if (!peer)
+			peer = fd_resolve_peer(fd);
+
+		error("%s: [%s] failed: %s",
+		      __func__, peer, slurm_strerror(rc));
+		usleep(10000);	/* Discourage brute force attack */
+		xfree(peer);
+		errno = rc;
+		return NULL;
 	}
 
 	log_flag_hex(NET_RAW, buf, buflen, "%s: [%s] read", __func__, peer);
+	xfree(peer);
 	buffer = create_buf(buf, buflen);
 
+	ret_list = slurm_unpack_received_msgs(buffer, fd);
+	if ((rc = errno) != SLURM_SUCCESS) {
+		usleep(10000);	/* Discourage brute force attack */
+		errno = rc;
+	}
+
+	return ret_list;
+}
+
+extern List slurm_unpack_received_msgs(buf_t *buffer, int fd)
+{
+	header_t header;
+	int rc;
+	void *auth_cred = NULL;
+	slurm_msg_t msg;
+	ret_data_info_t *ret_data_info = NULL;
+	List ret_list = NULL;
+	char *peer = NULL;
+
+	if (slurm_conf.debug_flags & DEBUG_FLAG_NET)
+		peer = fd_resolve_peer(fd);
+
+	slurm_msg_t_init(&msg);
+	msg.conn_fd = fd;
+
 	if (unpack_header(&header, buffer) == SLURM_ERROR) {
 		FREE_NULL_BUFFER(buffer);
 		rc = SLURM_COMMUNICATIONS_RECEIVE_ERROR;
@@ -1258,7 +1296,6 @@ total_return:
 
 		error("%s: [%s] failed: %s",
 		      __func__, peer, slurm_strerror(rc));
-		usleep(10000);	/* Discourage brute force attack */
 	} else {
 		if (!ret_list)
 			ret_list = list_create(destroy_data_info);
@@ -1273,7 +1310,6 @@ total_return:
 	errno = rc;
 	xfree(peer);
 	return ret_list;
-
 }
 
 extern List slurm_receive_resp_msgs(int fd, int steps, int timeout)
@@ -2248,6 +2284,157 @@ _send_and_recv_msgs(int fd, slurm_msg_t *req, int timeout)
 	return ret_list;
 }
 
+extern void slurm_persist_controller_conn_init(void)
+{
+	slurm_mutex_lock(&ctld_persist_lock);
+	ctld_persist_enabled = xstrcasestr(slurm_conf.slurmctld_params,
+					   "enable_persist_clients");
+	slurm_mutex_unlock(&ctld_persist_lock);
+}
+
+extern void slurm_persist_controller_conn_fini(void)
+{
+	slurm_mutex_lock(&ctld_persist_lock);
+	ctld_persist_enabled = false;
+	slurm_persist_conn_destroy(ctld_persist_conn);
+	ctld_persist_conn = NULL;
+	slurm_mutex_unlock(&ctld_persist_lock);
+}
+
+/* Close the persistent connection so the next RPC reconnects */
+static void _close_persist_controller(void)
+{
+	slurm_mutex_lock(&ctld_persist_lock);
+	slurm_persist_conn_close(ctld_persist_conn);
+	slurm_mutex_unlock(&ctld_persist_lock);
+}
+
+/*
+ * Open the persistent connection to the controller and authenticate it
+ * IN/OUT index - SlurmctldHost to try first, set to the one contacted
+ * OUT fallback - set if the controller refused the persistent connection
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+static int _open_persist_controller(int *index, bool *fallback)
+{
+	slurm_persist_conn_t *conn = ctld_persist_conn;
+	slurm_addr_t addr;
+
+	if ((conn->fd = _open_controller(&addr, index, NULL)) < 0)
+		return SLURM_ERROR;
+
+	fd_set_nonblocking(conn->fd);
+	net_set_keep_alive(conn->fd);
+
+	(void) slurm_get_peer_addr(conn->fd, &addr);
+	if (!conn->rem_host)
+		conn->rem_host = xmalloc(INET6_ADDRSTRLEN);
+	slurm_get_ip_str(&addr, conn->rem_host, INET6_ADDRSTRLEN);
+	conn->rem_port = slurm_get_port(&addr);
+
+	/* Send the lowest protocol version until slurmctld tells us its own */
+	conn->version = SLURM_MIN_PROTOCOL_VERSION;
+	conn->timeout = slurm_conf.msg_timeout * MSEC_IN_SEC;
+	conn->r_uid = slurm_conf.slurm_user_id;
+
+	if (slurm_persist_conn_init(conn)) {
+		log_flag(NET, "%s: slurmctld refused persistent connection, opening a new connection for each RPC for the next %d seconds",
+			 __func__, CTLD_PERSIST_RETRY_SEC);
+		ctld_persist_retry = time(NULL) + CTLD_PERSIST_RETRY_SEC;
+		*fallback = true;
+		return SLURM_ERROR;
+	}
+
+	log_flag(NET, "%s: opened persistent connection to slurmctld %s:%hu",
+		 __func__, conn->rem_host, conn->rem_port);
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Send a request and receive the response over the persistent connection to
+ * the controller, opening it first if needed.
+ * IN req - request to send
+ * OUT resp - response
+ * IN/OUT index - SlurmctldHost to connect to
+ * OUT fallback - set if req was not sent and should go over a new connection
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+static int _send_recv_persist_controller_msg(slurm_msg_t *req,
+					     slurm_msg_t *resp, int *index,
+					     bool *fallback)
+{
+	int rc = SLURM_ERROR;
+
+	*fallback = true;
+
+	/* Never wait on an RPC another thread has in flight */
+	if (pthread_mutex_trylock(&ctld_persist_lock))
+		return SLURM_ERROR;
+
+	if (!ctld_persist_enabled || (ctld_persist_retry > time(NULL)))
+		goto done;
+
+	if (!ctld_persist_conn) {
+		ctld_persist_conn = xmalloc(sizeof(*ctld_persist_conn));
+		ctld_persist_conn->cluster_name =
+			xstrdup(slurm_conf.cluster_name);
+		ctld_persist_conn->fd = -1;
+		/* slurmctld may not permit it, which is not an error */
+		ctld_persist_conn->flags = PERSIST_FLAG_SUPPRESS_ERR;
+		ctld_persist_conn->persist_type = PERSIST_TYPE_CLIENT;
+	}
+
+	/* slurmctld closes the idle connection when it restarts */
+	if ((ctld_persist_conn->fd >= 0) &&
+	    (slurm_persist_conn_writeable(ctld_persist_conn) != 1)) {
+		log_flag(NET, "%s: persistent connection to slurmctld lost, reconnecting",
+			 __func__);
+		slurm_persist_conn_close(ctld_persist_conn);
+	}
+
+	/*
+	 * Reconnect well before slurmctld closes the idle connection so a
+	 * request is never sent while it is being closed.
+	 */
+	if ((ctld_persist_conn->fd >= 0) &&
+	    (difftime(time(NULL), ctld_persist_last_use) >=
+	     (PERSIST_CLIENT_IDLE_TIMEOUT / 2))) {
+		log_flag(NET, "%s: persistent connection to slurmctld idle, reconnecting",
+			 __func__);
+		slurm_persist_conn_close(ctld_persist_conn);
+	}
+
+	if (ctld_persist_conn->fd < 0) {
+		*fallback = false;
+		if (_open_persist_controller(index, fallback))
+			goto done;
+		*fallback = true;
+	}
+
+	slurm_msg_t_init(resp);
+	req->conn = ctld_persist_conn;
+	resp->conn = ctld_persist_conn;
+
+	if (slurm_send_node_msg(ctld_persist_conn->fd, req)) {
+		/* slurmctld never saw it, send it over a new connection */
+		slurm_persist_conn_close(ctld_persist_conn);
+		goto done;
+	}
+
+	/* Request was sent so it must not be sent again */
+	*fallback = false;
+	ctld_persist_last_use = time(NULL);
+	if ((rc = slurm_receive_msg(ctld_persist_conn->fd, resp, 0)))
+		slurm_seterrno(SLURM_COMMUNICATIONS_RECEIVE_ERROR);
+
+done:
+	req->conn = NULL;
+	resp->conn = NULL;
+	slurm_mutex_unlock(&ctld_persist_lock);
+	return rc;
+}
+
 /*
  * slurm_send_recv_controller_msg
  * opens a connection to the controller, sends the controller a message,
@@ -2292,13 +2479,23 @@ tryagain:
 	slurm_conf_unlock();
 
 	while (true) {
-		if ((fd = _open_controller(&ctrl_addr, &index,
-					   comm_cluster_rec)) < 0) {
+		bool fallback = true;
+
+		if (!comm_cluster_rec)
+			rc = _send_recv_persist_controller_msg(request_msg,
+							       response_msg,
+							       &index,
+							       &fallback);
+		if (!fallback) {
+			/* handled over persistent connection */
+		} else if ((fd = _open_controller(&ctrl_addr, &index,
+						  comm_cluster_rec)) < 0) {
 			rc = -1;
 			break;
+		} else {
+			rc = _send_and_recv_msg(fd, request_msg, response_msg,
+						0);
 		}
-
-		rc = _send_and_recv_msg(fd, request_msg, response_msg, 0);
 		if (response_msg->auth_cred)
 			auth_g_destroy(response_msg->auth_cred);
 
@@ -2313,6 +2510,8 @@ tryagain:
 			< (slurmctld_timeout + (slurmctld_timeout / 2)))) {
 			log_flag(NET, "%s: SlurmctldHost[%d] is in standby, trying next",
 				 __func__, index);
+			if (!fallback)
+				_close_persist_controller();
 			index++;
 
 			/*
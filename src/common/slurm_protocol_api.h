@@ -238,6 +238,16 @@ int slurm_receive_msg(int fd, slurm_msg_t *msg, int timeout);
  *                errno set.
  */
 List slurm_receive_msgs(int fd, int steps, int timeout);
+
+/*
+ * Unpack a complete response read from fd without blocking, as
+ * slurm_receive_msgs() does after reading it.
+ * IN buffer	- response as read from the wire (length prefix removed),
+ *		  always consumed
+ * IN fd	- file descriptor the response came from, only used for logging
+ * RET List	- same as slurm_receive_msgs(), errno set on failure
+ */
+extern List slurm_unpack_received_msgs(buf_t *buffer, int fd);
 extern List slurm_receive_resp_msgs(int fd, int steps, int timeout);
 
 /*
@@ -421,6 +431,22 @@ extern int slurm_send_recv_controller_msg(slurm_msg_t * request_msg,
 				slurm_msg_t * response_msg,
 				slurmdb_cluster_rec_t *comm_cluster_rec);
 
+/*
+ * Send the RPCs of slurm_send_recv_controller_msg() over one persistent
+ * connection to the controller that is authenticated once, instead of opening
+ * and authenticating a new connection for every RPC. The connection is opened
+ * on the first RPC and reopened if slurmctld closes it. Threads that find it
+ * busy and RPCs to other clusters use a new connection as before. Does
+ * nothing unless SlurmctldParameters=enable_persist_clients.
+ *
+ * Only for long lived clients that send every RPC as the same user, since
+ * RPCs over the connection are all run as the user that opened it.
+ */
+extern void slurm_persist_controller_conn_init(void);
+
+/* Close the persistent connection to the controller, if any */
+extern void slurm_persist_controller_conn_fini(void);
+
 
 /* slurm_send_recv_node_msg
  * opens a connection to node,
@@ -1947,6 +1947,7 @@ extern void slurm_free_epilog_complete_msg(epilog_complete_msg_t * msg)
 {
 	if (msg) {
 		xfree(msg->node_name);
+		xfree(msg->nodes);
 		xfree(msg);
 	}
 }
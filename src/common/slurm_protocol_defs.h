@@ -775,7 +775,8 @@ typedef struct signal_tasks_msg {
 typedef struct epilog_complete_msg {
 	uint32_t job_id;
 	uint32_t return_code;
-	char    *node_name;
+	char    *node_name;	/* may be a hostlist expression */
+	char    *nodes;		/* job's nodes, set when sent to a slurmd */
 } epilog_complete_msg_t;
 
 #define REBOOT_FLAGS_ASAP 0x0001	/* Drain to reboot ASAP */
@@ -1219,6 +1220,7 @@ enum compress_type {
 	COMPRESS_OFF = 0,	/* no compression */
 				/* = 1 was zlib */
 	COMPRESS_LZ4 = 2,	/* lz4 compression */
+	COMPRESS_ZSTD = 3,	/* zstd compression */
 };
 
 typedef enum {
@@ -1227,6 +1229,7 @@ typedef enum {
 	FILE_BCAST_LAST_BLOCK = 1 << 1,	/* last file block */
 	FILE_BCAST_SO = 1 << 2, 	/* shared object */
 	FILE_BCAST_EXE = 1 << 3,	/* executable ahead of shared object */
+	FILE_BCAST_DIGEST = 1 << 4,	/* only digest of block data is sent */
 } file_bcast_flags_t;
 
 typedef struct file_bcast_msg {
@@ -1246,6 +1249,7 @@ typedef struct file_bcast_msg {
 	uint64_t block_offset;	/* offset for this data block */
 	uint32_t uncomp_len;	/* uncompressed length of this data block */
 	char *block;		/* data for this block */
+	slurm_hash_t digest;	/* hash of uncompressed block data */
 	uint64_t file_size;	/* file size */
 } file_bcast_msg_t;
 
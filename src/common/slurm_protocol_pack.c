@@ -2521,7 +2521,12 @@ _pack_epilog_comp_msg(epilog_complete_msg_t * msg, buf_t *buffer,
 		      uint16_t protocol_version)
 {
 	xassert(msg);
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_24_05_PROTOCOL_VERSION) {
+		pack32((uint32_t)msg->job_id, buffer);
+		pack32((uint32_t)msg->return_code, buffer);
+		packstr(msg->node_name, buffer);
+		packstr(msg->nodes, buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		pack32((uint32_t)msg->job_id, buffer);
 		pack32((uint32_t)msg->return_code, buffer);
 		packstr(msg->node_name, buffer);
@@ -2538,7 +2543,12 @@ _unpack_epilog_comp_msg(epilog_complete_msg_t ** msg, buf_t *buffer,
 	tmp_ptr = xmalloc(sizeof(epilog_complete_msg_t));
 	*msg = tmp_ptr;
 
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_24_05_PROTOCOL_VERSION) {
+		safe_unpack32(&(tmp_ptr->job_id), buffer);
+		safe_unpack32(&(tmp_ptr->return_code), buffer);
+		safe_unpackstr(&(tmp_ptr->node_name), buffer);
+		safe_unpackstr(&(tmp_ptr->nodes), buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		safe_unpack32(&(tmp_ptr->job_id), buffer);
 		safe_unpack32(&(tmp_ptr->return_code), buffer);
 		safe_unpackstr(&(tmp_ptr->node_name), buffer);
@@ -8642,6 +8652,9 @@ static void _pack_file_bcast(file_bcast_msg_t * msg , buf_t *buffer,
 		pack64(msg->block_offset, buffer);
 		pack64(msg->file_size, buffer);
 		packmem(msg->block, msg->block_len, buffer);
+		pack8(msg->digest.type, buffer);
+		packmem_array((char *) msg->digest.hash,
+			      sizeof(msg->digest.hash), buffer);
 		pack_sbcast_cred(msg->cred, buffer, protocol_version);
 	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		pack32(msg->block_no, buffer);
@@ -8699,6 +8712,9 @@ static int _unpack_file_bcast(file_bcast_msg_t ** msg_ptr , buf_t *buffer,
 		safe_unpackmem_xmalloc(&msg->block, &uint32_tmp, buffer);
 		if (uint32_tmp != msg->block_len)
 			goto unpack_error;
+		safe_unpack8(&msg->digest.type, buffer);
+		safe_unpackmem_array((char *) msg->digest.hash,
+				     sizeof(msg->digest.hash), buffer);
 
 		msg->cred = unpack_sbcast_cred(buffer, msg,
 					       protocol_version);
@@ -9462,6 +9478,15 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 			safe_unpack32(&msg->bf_backfilled_het_jobs, buffer);
 			safe_unpack32_array(&msg->bf_exit,
 					    &msg->bf_exit_cnt, buffer);
+
+			if (protocol_version >= SLURM_24_05_PROTOCOL_VERSION) {
+				safe_unpack32(&msg->dbd_agent_batch_cnt,
+					      buffer);
+				safe_unpack32(&msg->dbd_agent_latency_max,
+					      buffer);
+				safe_unpack64(&msg->dbd_agent_latency_sum,
+					      buffer);
+			}
 		}
 
 		safe_unpack32(&msg->rpc_type_size, buffer);
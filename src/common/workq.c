@@ -36,6 +36,7 @@
 #include "config.h"
 
 #include <pthread.h>
+#include <time.h>
 
 #include "slurm/slurm.h"
 
@@ -46,34 +47,94 @@
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
+/*
+ * Counters shared by all workers are only accessed with atomics to avoid
+ * taking workq->mutex for every work added or run.
+ */
+#define ATOMIC_GET(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define ATOMIC_SET(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST)
+#define ATOMIC_INC(ptr) __atomic_add_fetch(ptr, 1, __ATOMIC_SEQ_CST)
+#define ATOMIC_DEC(ptr) __atomic_sub_fetch(ptr, 1, __ATOMIC_SEQ_CST)
+
+typedef struct {
+	/* number of work run */
+	uint64_t count;
+	/* number of work taken from another worker's queue */
+	uint64_t stolen;
+	/* number of work timed while queued (only with DebugFlags=WORKQ) */
+	uint64_t timed;
+	/* time work spent queued before running */
+	uint64_t wait_usec;
+	uint64_t max_wait_usec;
+} workq_stats_t;
+
+typedef struct workq_work_s workq_work_t;
+
+/*
+ * FIFO of work linked through workq_work_t.next. A plain mutex and no list
+ * nodes keep adding and running work cheaper than with a list_t.
+ */
+typedef struct {
+	pthread_mutex_t mutex;
+	workq_work_t *head;
+	workq_work_t *tail;
+	/* number of work in queue (atomic) */
+	int count;
+} workq_queue_t;
+
 struct workq_s {
 	int magic;
 	/* list of workq_worker_t */
 	list_t *workers;
-	/* list of workq_work_t */
-	list_t *work;
+	/*
+	 * array of queues with one per worker.
+	 * Workers run work from their own queue first and then steal from the
+	 * other queues once their queue is empty.
+	 */
+	workq_queue_t *queues;
+	/* next queue for work added from outside of the workers (atomic) */
+	unsigned int next_queue;
+
+	/* work queued but not yet running (atomic) */
+	int pending;
+	/* workq_add_work() calls past the shutdown check (atomic) */
+	int adding;
+	/* workers running work (atomic) */
+	int active;
+	/* workers waiting on cond (atomic) */
+	int idle;
+	/* a worker was signaled and has not looked for work yet (atomic) */
+	bool waking;
+	/* threads in _wait_workers_idle() (atomic) */
+	int idle_waiters;
+	/* manger is actively shutting down (atomic) */
+	bool shutdown;
 
 	/* track simple stats for logging */
-	int active;
 	int total;
-
-	/* manger is actively shutting down */
-	bool shutdown;
+	workq_stats_t stats;
 
 	/* number of threads */
 	int threads;
 
 	pthread_mutex_t mutex;
+	/* signaled when work is queued or on shutdown */
 	pthread_cond_t cond;
+	/* signaled when active reaches 0 */
+	pthread_cond_t idle_cond;
 };
 
-typedef struct {
+struct workq_work_s {
 	int magic;
+	/* next work in the same queue */
+	workq_work_t *next;
 	work_func_t func;
 	void *arg;
 	/* tag for logging */
 	const char *tag;
-} workq_work_t;
+	/* when work was queued */
+	struct timespec queued;
+};
 
 typedef struct {
 	int magic;
@@ -83,12 +144,23 @@ typedef struct {
 	workq_t *workq;
 	/* unique id for tracking */
 	int id;
+	/* stats only modified by worker */
+	workq_stats_t stats;
 } workq_worker_t;
 
 #define MAGIC_WORKQ 0xD23424EF
 #define MAGIC_WORKER 0xD2342412
 #define MAGIC_WORK 0xD23AB412
 
+/*
+ * Worker running in the current thread to allow work added by work to be
+ * queued to the same worker.
+ *
+ * FIXME: __thread is non-standard, and may cause build failures on unusual
+ * systems. Only used within GCC until a better solution is found.
+ */
+static __thread workq_worker_t *current_worker = NULL;
+
 static void *_worker(void *arg);
 
 static inline void _check_magic_workq(workq_t *workq)
@@ -96,7 +168,8 @@ static inline void _check_magic_workq(workq_t *workq)
 	xassert(workq);
 	xassert(workq->magic == MAGIC_WORKQ);
 	xassert(workq->workers);
-	xassert(workq->active >= 0);
+	xassert(workq->queues);
+	xassert(ATOMIC_GET(&workq->active) >= 0);
 }
 
 static inline void _check_magic_worker(workq_worker_t *worker)
@@ -114,6 +187,15 @@ static inline void _check_magic_work(workq_work_t *work)
 	xassert(work->func);
 }
 
+static void _merge_stats(workq_stats_t *dst, const workq_stats_t *src)
+{
+	dst->count += src->count;
+	dst->stolen += src->stolen;
+	dst->timed += src->timed;
+	dst->wait_usec += src->wait_usec;
+	dst->max_wait_usec = MAX(dst->max_wait_usec, src->max_wait_usec);
+}
+
 static int _find_worker(void *x, void *arg)
 {
 	return (x == arg);
@@ -133,12 +215,15 @@ static void _worker_delete(void *x)
 				   worker);
 
 	worker->workq->total--;
+	_merge_stats(&worker->workq->stats, &worker->stats);
 
 	/* workq may get freed at any time after unlocking */
 	slurm_mutex_unlock(&worker->workq->mutex);
 	xassert(worker == x);
 
-	log_flag(WORKQ, "%s: [%u] free worker", __func__, worker->id);
+	log_flag(WORKQ, "%s: [%u] free worker after running %"PRIu64" work (%"PRIu64" stolen)",
+		 __func__, worker->id, worker->stats.count,
+		 worker->stats.stolen);
 
 	worker->magic = ~MAGIC_WORKER;
 	xfree(worker);
@@ -164,14 +249,19 @@ extern workq_t *new_workq(int count)
 	workq_t *workq = xmalloc(sizeof(*workq));
 
 	xassert(count < 1024);
+	xassert(count > 0);
 
 	workq->magic = MAGIC_WORKQ;
 	workq->workers = list_create(NULL);
-	workq->work = list_create(_work_delete);
+	workq->queues = xcalloc(count, sizeof(*workq->queues));
 	workq->threads = count;
 
+	for (int i = 0; i < count; i++)
+		slurm_mutex_init(&workq->queues[i].mutex);
+
 	slurm_mutex_init(&workq->mutex);
 	slurm_cond_init(&workq->cond, NULL);
+	slurm_cond_init(&workq->idle_cond, NULL);
 
 	_check_magic_workq(workq);
 
@@ -199,10 +289,13 @@ static void _wait_workers_idle(workq_t *workq)
 
 	slurm_mutex_lock(&workq->mutex);
 	log_flag(WORKQ, "%s: checking %u workers",
-		 __func__, list_count(workq->work));
+		 __func__, ATOMIC_GET(&workq->active));
 
-	while (workq->active)
-		slurm_cond_wait(&workq->cond, &workq->mutex);
+	/* advertise before checking active to pair with _worker() */
+	ATOMIC_INC(&workq->idle_waiters);
+	while (ATOMIC_GET(&workq->active))
+		slurm_cond_wait(&workq->idle_cond, &workq->mutex);
+	ATOMIC_DEC(&workq->idle_waiters);
 
 	slurm_mutex_unlock(&workq->mutex);
 	log_flag(WORKQ, "%s: all workers are idle", __func__);
@@ -216,9 +309,9 @@ static void _wait_work_complete(workq_t *workq)
 	_check_magic_workq(workq);
 
 	slurm_mutex_lock(&workq->mutex);
-	xassert(workq->shutdown);
+	xassert(ATOMIC_GET(&workq->shutdown));
 	log_flag(WORKQ, "%s: waiting for %u queued workers",
-		 __func__, list_count(workq->work));
+		 __func__, ATOMIC_GET(&workq->pending));
 	slurm_mutex_unlock(&workq->mutex);
 
 	while (true) {
@@ -252,17 +345,23 @@ extern void quiesce_workq(workq_t *workq)
 	slurm_mutex_lock(&workq->mutex);
 
 	log_flag(WORKQ, "%s: shutting down with %u queued jobs",
-		 __func__, list_count(workq->work));
+		 __func__, ATOMIC_GET(&workq->pending));
 
 	/* notify of shutdown */
-	workq->shutdown = true;
+	ATOMIC_SET(&workq->shutdown, true);
 	slurm_cond_broadcast(&workq->cond);
 	slurm_mutex_unlock(&workq->mutex);
 
 	_wait_work_complete(workq);
 
 	xassert(list_count(workq->workers) == 0);
-	xassert(list_count(workq->work) == 0);
+	xassert(ATOMIC_GET(&workq->pending) == 0);
+
+	log_flag(WORKQ, "%s: ran %"PRIu64" work (%"PRIu64" stolen) with queue latency avg=%"PRIu64"usec max=%"PRIu64"usec",
+		 __func__, workq->stats.count, workq->stats.stolen,
+		 (workq->stats.timed ?
+		  (workq->stats.wait_usec / workq->stats.timed) : 0),
+		 workq->stats.max_wait_usec);
 }
 
 extern void free_workq(workq_t *workq)
@@ -276,16 +375,85 @@ extern void free_workq(workq_t *workq)
 	quiesce_workq(workq);
 
 	FREE_NULL_LIST(workq->workers);
-	FREE_NULL_LIST(workq->work);
+	for (int i = 0; i < workq->threads; i++) {
+		xassert(!workq->queues[i].head);
+		slurm_mutex_destroy(&workq->queues[i].mutex);
+	}
+	xfree(workq->queues);
 	workq->magic = ~MAGIC_WORKQ;
 	xfree(workq);
 }
 
+static void _queue_append(workq_queue_t *queue, workq_work_t *head,
+			  workq_work_t *tail, int count)
+{
+	slurm_mutex_lock(&queue->mutex);
+	if (queue->tail)
+		queue->tail->next = head;
+	else
+		queue->head = head;
+	queue->tail = tail;
+	ATOMIC_SET(&queue->count, (queue->count + count));
+	slurm_mutex_unlock(&queue->mutex);
+}
+
+/*
+ * Remove work from the front of queue
+ * IN/OUT count_ptr - max work to remove (> 0) / number of work removed
+ * OUT tail_ptr - last work removed
+ * RET first work removed (linked through next) or NULL if queue is empty
+ */
+static workq_work_t *_queue_pop(workq_queue_t *queue, int *count_ptr,
+				workq_work_t **tail_ptr)
+{
+	workq_work_t *head, *tail;
+	int count = 1, max = *count_ptr;
+
+	xassert(max > 0);
+
+	slurm_mutex_lock(&queue->mutex);
+	if (!(head = queue->head)) {
+		slurm_mutex_unlock(&queue->mutex);
+		return NULL;
+	}
+
+	for (tail = head; (count < max) && tail->next; count++)
+		tail = tail->next;
+
+	if (!(queue->head = tail->next))
+		queue->tail = NULL;
+	ATOMIC_SET(&queue->count, (queue->count - count));
+	slurm_mutex_unlock(&queue->mutex);
+
+	tail->next = NULL;
+	*count_ptr = count;
+	*tail_ptr = tail;
+	return head;
+}
+
+/*
+ * Wake a sleeping worker to run or steal queued work. Only one worker is
+ * woken at a time, a woken worker that finds more work queued wakes the next.
+ */
+static void _wake_worker(workq_t *workq)
+{
+	bool waking = false;
+
+	if (!ATOMIC_GET(&workq->idle) || ATOMIC_GET(&workq->waking) ||
+	    !__atomic_compare_exchange_n(&workq->waking, &waking, true, false,
+					 __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		return;
+
+	slurm_mutex_lock(&workq->mutex);
+	slurm_cond_signal(&workq->cond);
+	slurm_mutex_unlock(&workq->mutex);
+}
+
 extern int workq_add_work(workq_t *workq, work_func_t func, void *arg,
 			  const char *tag)
 {
 	int rc = SLURM_SUCCESS;
-
+	workq_queue_t *queue;
 	workq_work_t *work = xmalloc(sizeof(*work));
 	_check_magic_workq(workq);
 
@@ -296,15 +464,40 @@ extern int workq_add_work(workq_t *workq, work_func_t func, void *arg,
 
 	_check_magic_work(work);
 
-	slurm_mutex_lock(&workq->mutex);
-	/* add to work list and signal a thread */
-	if (workq->shutdown)
+	/* only time work when the latency will be logged */
+	if ((slurm_conf.debug_flags & DEBUG_FLAG_WORKQ) &&
+	    clock_gettime(CLOCK_MONOTONIC, &work->queued))
+		fatal("%s: clock_gettime() failed: %m", __func__);
+
+	/*
+	 * Workers will not exit while adding is non-zero to avoid work getting
+	 * queued after the last worker has exited.
+	 */
+	ATOMIC_INC(&workq->adding);
+
+	if (ATOMIC_GET(&workq->shutdown)) {
 		rc = ESLURM_DISABLED;
-	else { /* workq is not shutdown */
-		list_append(workq->work, work);
-		slurm_cond_signal(&workq->cond);
+	} else {
+		/* keep work added by work on the same worker */
+		if (current_worker && (current_worker->workq == workq))
+			queue = &workq->queues[current_worker->id - 1];
+		else
+			queue = &workq->queues[
+				__atomic_fetch_add(&workq->next_queue, 1,
+						   __ATOMIC_RELAXED) %
+				workq->threads];
+
+		_queue_append(queue, work, work, 1);
+		ATOMIC_INC(&workq->pending);
 	}
-	slurm_mutex_unlock(&workq->mutex);
+
+	/*
+	 * Check for idle workers after the work is visible in the queue to
+	 * pair with _wait_for_work() checking the queues after becoming idle.
+	 */
+	ATOMIC_DEC(&workq->adding);
+
+	_wake_worker(workq);
 
 	if (rc)
 		_work_delete(work);
@@ -312,67 +505,184 @@ extern int workq_add_work(workq_t *workq, work_func_t func, void *arg,
 	return rc;
 }
 
+/* Pop work from worker's queue or steal work from another worker's queue */
+static workq_work_t *_pop_work(workq_worker_t *worker, bool *stolen_ptr)
+{
+	workq_t *workq = worker->workq;
+	const int id = worker->id - 1;
+	workq_work_t *work, *tail = NULL;
+	int count = 1;
+
+	if ((work = _queue_pop(&workq->queues[id], &count, &tail)))
+		return work;
+
+	/* avoid locking every queue when there is nothing to steal */
+	if (!ATOMIC_GET(&workq->pending))
+		return NULL;
+
+	for (int i = 1; i < workq->threads; i++) {
+		workq_queue_t *queue =
+			&workq->queues[(id + i) % workq->threads];
+
+		if (!(count = ATOMIC_GET(&queue->count)))
+			continue;
+
+		/*
+		 * Steal the older half of the queue at once to avoid stealing
+		 * again for every work. The stolen work is moved to our queue
+		 * after unlocking the other queue as locking 2 queues at once
+		 * could deadlock.
+		 */
+		count = MAX((count / 2), 1);
+		if (!(work = _queue_pop(queue, &count, &tail)))
+			continue;
+
+		if (count > 1)
+			_queue_append(&workq->queues[id], work->next, tail,
+				      (count - 1));
+		work->next = NULL;
+		*stolen_ptr = true;
+		break;
+	}
+
+	return work;
+}
+
+static bool _is_queues_empty(workq_t *workq)
+{
+	for (int i = 0; i < workq->threads; i++)
+		if (ATOMIC_GET(&workq->queues[i].count))
+			return false;
+
+	return true;
+}
+
+/*
+ * Wait until there may be new work
+ * RET true to check for work again or false to shutdown worker
+ */
+static bool _wait_for_work(workq_worker_t *worker)
+{
+	workq_t *workq = worker->workq;
+	bool run = true, shutdown;
+	int adding;
+
+	slurm_mutex_lock(&workq->mutex);
+
+	/*
+	 * Advertise as idle before checking for pending work to pair with
+	 * workq_add_work() queuing work before checking idle. Order of checks
+	 * matters: adding must be read before pending to catch work queued
+	 * by a workq_add_work() that checked shutdown before it was set.
+	 * pending may briefly include work already popped by another worker
+	 * so the queues are checked before trying again. waking is cleared
+	 * before checking pending as _wake_worker() skips signaling while it
+	 * is set.
+	 */
+	ATOMIC_INC(&workq->idle);
+	ATOMIC_SET(&workq->waking, false);
+	shutdown = ATOMIC_GET(&workq->shutdown);
+	adding = ATOMIC_GET(&workq->adding);
+
+	if (ATOMIC_GET(&workq->pending) && !_is_queues_empty(workq)) {
+		/* work was queued after the queues were checked */
+	} else if (shutdown && !adding) {
+		run = false;
+	} else {
+		log_flag(WORKQ, "%s: [%u] waiting for work. Current active workers %u/%u",
+			 __func__, worker->id, ATOMIC_GET(&workq->active),
+			 workq->total);
+		slurm_cond_wait(&workq->cond, &workq->mutex);
+		ATOMIC_SET(&workq->waking, false);
+	}
+
+	ATOMIC_DEC(&workq->idle);
+	slurm_mutex_unlock(&workq->mutex);
+
+	return run;
+}
+
+static void _update_stats(workq_worker_t *worker, workq_work_t *work,
+			  bool stolen)
+{
+	struct timespec now;
+	uint64_t wait_usec;
+
+	worker->stats.count++;
+	if (stolen)
+		worker->stats.stolen++;
+
+	if (!work->queued.tv_sec && !work->queued.tv_nsec)
+		return;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now))
+		fatal("%s: clock_gettime() failed: %m", __func__);
+
+	wait_usec = ((now.tv_sec - work->queued.tv_sec) * USEC_IN_SEC) +
+		    ((now.tv_nsec - work->queued.tv_nsec) / NSEC_IN_USEC);
+
+	worker->stats.timed++;
+	worker->stats.wait_usec += wait_usec;
+	worker->stats.max_wait_usec =
+		MAX(worker->stats.max_wait_usec, wait_usec);
+}
+
 static void *_worker(void *arg)
 {
 	workq_worker_t *worker = arg;
 	workq_t *workq = worker->workq;
 	_check_magic_worker(worker);
 
+	current_worker = worker;
+
 	slurm_mutex_lock(&workq->mutex);
 	worker->workq->total++;
 	slurm_mutex_unlock(&workq->mutex);
 
 	while (true) {
-		workq_work_t *work = NULL;
-		slurm_mutex_lock(&workq->mutex);
-
-		work = list_pop(workq->work);
+		bool stolen = false;
+		workq_work_t *work = _pop_work(worker, &stolen);
 
 		/* wait for work if nothing to do */
 		if (!work) {
-			if (workq->shutdown) {
-				/* give up lock as we are about to be deleted */
-				slurm_mutex_unlock(&workq->mutex);
-
-				log_flag(WORKQ, "%s: [%u] shutting down",
-					 __func__, worker->id);
-				_worker_delete(worker);
-				break;
-			}
-
-			log_flag(WORKQ, "%s: [%u] waiting for work. Current active workers %u/%u",
-				 __func__, worker->id, worker->workq->active,
-				 worker->workq->total);
-			slurm_cond_wait(&workq->cond, &workq->mutex);
-			slurm_mutex_unlock(&workq->mutex);
-			continue;
+			if (_wait_for_work(worker))
+				continue;
+
+			log_flag(WORKQ, "%s: [%u] shutting down",
+				 __func__, worker->id);
+			current_worker = NULL;
+			_worker_delete(worker);
+			break;
 		}
 
 		/* got work, run it! */
-		worker->workq->active++;
+		if (ATOMIC_DEC(&workq->pending))
+			_wake_worker(workq);
+		ATOMIC_INC(&workq->active);
+		_update_stats(worker, work, stolen);
 
-		log_flag(WORKQ, "%s: [%u->%s] running active_workers=%u/%u queue=%u",
+		log_flag(WORKQ, "%s: [%u->%s] running%s active_workers=%u/%u queue=%u",
 			 __func__, worker->id, work->tag,
-			 worker->workq->active, worker->workq->total,
-			 list_count(workq->work));
-
-		slurm_mutex_unlock(&workq->mutex);
+			 (stolen ? " stolen work" : ""),
+			 ATOMIC_GET(&workq->active), workq->total,
+			 ATOMIC_GET(&workq->pending));
 
 		/* run work now */
 		_check_magic_work(work);
 		work->func(work->arg);
 
-		slurm_mutex_lock(&workq->mutex);
-
-		workq->active--;
+		/* only wake _wait_workers_idle() once all workers are idle */
+		if (!ATOMIC_DEC(&workq->active) &&
+		    ATOMIC_GET(&workq->idle_waiters)) {
+			slurm_mutex_lock(&workq->mutex);
+			slurm_cond_broadcast(&workq->idle_cond);
+			slurm_mutex_unlock(&workq->mutex);
+		}
 
 		log_flag(WORKQ, "%s: [%u->%s] finished active_workers=%u/%u queue=%u",
 			 __func__, worker->id, work->tag,
-			 worker->workq->active, worker->workq->total,
-			 list_count(workq->work));
-
-		slurm_cond_broadcast(&workq->cond);
-		slurm_mutex_unlock(&workq->mutex);
+			 ATOMIC_GET(&workq->active), workq->total,
+			 ATOMIC_GET(&workq->pending));
 
 		_work_delete(work);
 	}
@@ -382,15 +692,9 @@ static void *_worker(void *arg)
 
 extern int workq_get_active(workq_t *workq)
 {
-	int active;
-
 	_check_magic_workq(workq);
 
-	slurm_mutex_lock(&workq->mutex);
-	active = workq->active;
-	slurm_mutex_unlock(&workq->mutex);
-
-	return active;
+	return ATOMIC_GET(&workq->active);
 }
 
 extern int get_workq_thread_count(const workq_t *workq)
@@ -51,7 +51,7 @@
 static char *_build_label(int task_id, int task_id_width,
 			  uint32_t het_job_offset,
 			  uint32_t het_job_task_offset);
-static int _write_line(int fd, char *prefix, char *suffix, void *buf, int len);
+static int _write_line(int fd, void *buf, int len);
 
 /*
  * fd             is the file descriptor to write to
@@ -64,9 +64,10 @@ static int _write_line(int fd, char *prefix, char *suffix, void *buf, int len);
  *                label for the task id
  * task_id_width  is the number of digits to use for the task id
  *
- * Write as many lines from the message as possible.  Return
- * the number of bytes from the message that have been written,
- * or -1 on error.  If len==0, -1 will be returned.
+ * Write the whole message, labelling each line if requested, with a single
+ * write() so output from several tasks or hetjob components cannot be
+ * interleaved.  Return the number of bytes from the message that have been
+ * written, or -1 on error.  If len==0, -1 will be returned.
  *
  * If the message ends in a partial line (line does not end
  * in a '\n'), then add a newline to the output file, but only
@@ -76,50 +77,64 @@ extern int write_labelled_message(int fd, void *buf, int len, int task_id,
 				  uint32_t het_job_offset,
 				  uint32_t het_job_task_offset,
 				  bool label, int task_id_width)
+{
+	buf_t *buffer;
+	int rc;
+
+	if (len <= 0)
+		return -1;
+
+	if (!label)
+		return _write_line(fd, buf, len);
+
+	buffer = init_buf(len);
+	append_labelled_message(buffer, buf, len, task_id, het_job_offset,
+				het_job_task_offset, label, task_id_width);
+	rc = _write_line(fd, get_buf_data(buffer), get_buf_offset(buffer));
+	FREE_NULL_BUFFER(buffer);
+
+	if (rc < 0)
+		return rc;
+	return len;
+}
+
+static void _append(buf_t *buffer, void *data, int len)
+{
+	if (remaining_buf(buffer) < len)
+		grow_buf(buffer, len);
+	memcpy(&buffer->head[buffer->processed], data, len);
+	buffer->processed += len;
+}
+
+extern void append_labelled_message(buf_t *buffer, void *buf, int len,
+				    int task_id, uint32_t het_job_offset,
+				    uint32_t het_job_task_offset,
+				    bool label, int task_id_width)
 {
 	void *start, *end;
-	char *prefix = NULL, *suffix = NULL;
-	int remaining = len;
-	int written = 0;
-	int line_len;
-	int rc = -1;
-
-	if (label) {
-		prefix = _build_label(task_id, task_id_width, het_job_offset,
-				      het_job_task_offset);
+	char *prefix;
+	int line_len, pre;
+
+	if (!label) {
+		_append(buffer, buf, len);
+		return;
 	}
 
-	while (remaining > 0) {
-		start = buf + written;
-		end = memchr(start, '\n', remaining);
-		if (end == NULL) { /* no newline found */
-			if (label)
-				suffix = "\n";
-			rc = _write_line(fd, prefix, suffix, start, remaining);
-			if (rc <= 0) {
-				goto done;
-			} else {
-				remaining -= rc;
-				written += rc;
-			}
-		} else {
+	prefix = _build_label(task_id, task_id_width, het_job_offset,
+			      het_job_task_offset);
+	pre = strlen(prefix);
+	for (start = buf; len > 0; start += line_len, len -= line_len) {
+		if ((end = memchr(start, '\n', len)))
 			line_len = (int)(end - start) + 1;
-			rc = _write_line(fd, prefix, suffix, start, line_len);
-			if (rc <= 0) {
-				goto done;
-			} else {
-				remaining -= rc;
-				written += rc;
-			}
-		}
-
+		else
+			line_len = len;
+		_append(buffer, prefix, pre);
+		_append(buffer, start, line_len);
+		/* Terminate a partial line in label mode */
+		if (!end)
+			_append(buffer, "\n", 1);
 	}
-done:
 	xfree(prefix);
-	if (written > 0)
-		return written;
-	else
-		return rc;
 }
 
 /*
@@ -149,32 +164,11 @@ static char *_build_label(int task_id, int task_id_width,
 /*
  * Blocks until write is complete, regardless of the file descriptor being in
  * non-blocking mode.
- * I/O from multiple hetjob components may be present, so add prefix/suffix to
- * buffer before issuing write to avoid interleaved output from multiple
- * components.
  */
-static int _write_line(int fd, char *prefix, char *suffix, void *buf, int len)
+static int _write_line(int fd, void *buf, int len)
 {
-	int left, n, pre = 0, post = 0;
-	void *ptr, *tmp = NULL;
-
-	if (prefix || suffix) {
-		if (prefix)
-			pre = strlen(prefix);
-		if (suffix)
-			post = strlen(suffix);
-		tmp = xmalloc(pre + len + post);
-		if (prefix)
-			memcpy(tmp, prefix, pre);
-		memcpy(tmp + pre, buf, len);
-		if (suffix)
-			memcpy(tmp + pre + len, suffix, post);
-		ptr = tmp;
-		left = pre + len + post;
-	} else {
-		ptr = buf;
-		left = len;
-	}
+	int left = len, n;
+	void *ptr = buf;
 
 	while (left > 0) {
 	again:
@@ -191,7 +185,6 @@ static int _write_line(int fd, char *prefix, char *suffix, void *buf, int len)
 		left -= n;
 		ptr += n;
 	}
-	xfree(tmp);
 
 	return len;
 }
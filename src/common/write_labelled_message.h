@@ -40,6 +40,7 @@
 #define _HAVE_WRITE_LABELLED_MESSAGE
 
 #include "slurm/slurm.h"
+#include "src/common/pack.h"
 
 /*
  * fd             is the file descriptor to write to
@@ -52,7 +53,7 @@
  *                label for the task id
  * task_id_width  is the number of digits to use for the task id
  *
- * Write as many lines from the message as possible.  Return
+ * Write the whole message with a single write().  Return
  * the number of bytes from the message that have been written,
  * or -1 on error.  If len==0, -1 will be returned.
  *
@@ -65,4 +66,13 @@ extern int write_labelled_message(int fd, void *buf, int len, int task_id,
 				  uint32_t het_job_task_offset,
 				  bool label, int task_id_width);
 
+/*
+ * Append the message to buffer as write_labelled_message() would write it,
+ * so that the output of several messages can be written with one write().
+ */
+extern void append_labelled_message(buf_t *buffer, void *buf, int len,
+				    int task_id, uint32_t het_job_offset,
+				    uint32_t het_job_task_offset,
+				    bool label, int task_id_width);
+
 #endif
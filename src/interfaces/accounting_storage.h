@@ -52,9 +52,16 @@
 
 typedef enum {
 	ACCT_STORAGE_INFO_CONN_ACTIVE,
-	ACCT_STORAGE_INFO_AGENT_COUNT
+	ACCT_STORAGE_INFO_AGENT_COUNT,
+	ACCT_STORAGE_INFO_AGENT_STATS
 } acct_storage_info_t;
 
+typedef struct {
+	uint32_t batch_cnt; /* message batches acknowledged by the DBD */
+	uint32_t latency_max; /* longest batch round trip in usec */
+	uint64_t latency_sum; /* total of batch round trips in usec */
+} acct_storage_agent_stats_t;
+
 extern uid_t db_api_uid;
 
 extern int acct_storage_g_init(void); /* load the plugin */
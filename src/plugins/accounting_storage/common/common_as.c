@@ -887,11 +887,11 @@ static char *_make_archive_name(time_t period_start, time_t period_end,
 extern int archive_write_file(buf_t *buffer, char *cluster_name,
 			      time_t period_start, time_t period_end,
 			      char *arch_dir, char *arch_type,
-			      uint32_t archive_period)
+			      uint32_t archive_period, char **archive_file)
 {
 	int fd = 0;
 	int rc = SLURM_SUCCESS;
-	char *new_file = NULL;
+	char *new_file = NULL, *tmp_file = NULL;
 	static pthread_mutex_t local_file_lock = PTHREAD_MUTEX_INITIALIZER;
 
 	xassert(buffer);
@@ -906,24 +906,44 @@ extern int archive_write_file(buf_t *buffer, char *cluster_name,
 	debug("Storing %s archive for %s at %s",
 	      arch_type, cluster_name, new_file);
 
-	fd = creat(new_file, 0600);
+	/*
+	 * Write to a temporary name and rename it once it is on disk so a
+	 * crash never leaves a truncated archive behind under a valid name.
+	 */
+	tmp_file = xstrdup_printf("%s.new", new_file);
+
+	fd = creat(tmp_file, 0600);
 	if (fd < 0) {
-		error("Can't save archive, create file %s error %m", new_file);
+		error("Can't save archive, create file %s error %m", tmp_file);
 		rc = SLURM_ERROR;
 	} else {
 		safe_write(fd, get_buf_data(buffer), get_buf_offset(buffer));
-		fsync(fd);
+		if (fsync(fd) < 0)
+			goto rwfail;
 		close(fd);
+
+		if (rename(tmp_file, new_file)) {
+			error("Can't save archive, rename %s to %s error %m",
+			      tmp_file, new_file);
+			(void) unlink(tmp_file);
+			rc = SLURM_ERROR;
+		} else if (archive_file) {
+			*archive_file = new_file;
+			new_file = NULL;
+		}
 	}
 
+	xfree(tmp_file);
 	xfree(new_file);
 	slurm_mutex_unlock(&local_file_lock);
 
 	return rc;
 
 rwfail:
-	error("Error writing file %s, %m", new_file);
+	error("Error writing file %s, %m", tmp_file);
 	close(fd);
+	(void) unlink(tmp_file);
+	xfree(tmp_file);
 	xfree(new_file);
 	slurm_mutex_unlock(&local_file_lock);
 
@@ -69,6 +69,9 @@
 
 #define MAX_PURGE_LIMIT 50000 /* Number of records that are purged at a time
 				 so that locks can be periodically released. */
+#define MAX_ARCHIVE_SEGMENT 10000 /* Number of records packed into a single
+				    archive file so a purge pass never holds
+				    more than that in an archive buffer. */
 #define MAX_ARCHIVE_AGE (60 * 60 * 24 * 60) /* If archive data is older than
 					       this then archive by month to
 					       handle large datasets. */
@@ -3317,7 +3320,8 @@ static buf_t *_pack_archive_events(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	for (uint32_t i = 0; (i < cnt) && (row = mysql_fetch_row(result));
+	     i++) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[EVENT_REQ_START]);
 
@@ -3410,7 +3414,8 @@ static buf_t *_pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	for (uint32_t i = 0; (i < cnt) && (row = mysql_fetch_row(result));
+	     i++) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[JOB_REQ_SUBMIT]);
 
@@ -3738,7 +3743,8 @@ static buf_t *_pack_archive_job_env(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	for (uint32_t i = 0; (i < cnt) && (row = mysql_fetch_row(result));
+	     i++) {
 		if (period_start && !*period_start)
 			error("period_start should already be set");
 
@@ -3846,7 +3852,8 @@ static buf_t *_pack_archive_job_script(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	for (uint32_t i = 0; (i < cnt) && (row = mysql_fetch_row(result));
+	     i++) {
 		if (period_start && !*period_start)
 			error("period_start should already be set");
 
@@ -3956,7 +3963,8 @@ static buf_t *_pack_archive_resvs(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	for (uint32_t i = 0; (i < cnt) && (row = mysql_fetch_row(result));
+	     i++) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[RESV_REQ_START]);
 
@@ -4089,7 +4097,8 @@ static buf_t *_pack_archive_steps(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	for (uint32_t i = 0; (i < cnt) && (row = mysql_fetch_row(result));
+	     i++) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[STEP_REQ_START]);
 
@@ -4340,7 +4349,8 @@ static buf_t *_pack_archive_suspends(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	for (uint32_t i = 0; (i < cnt) && (row = mysql_fetch_row(result));
+	     i++) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[SUSPEND_REQ_START]);
 
@@ -4419,7 +4429,8 @@ static buf_t *_pack_archive_txns(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	for (uint32_t i = 0; (i < cnt) && (row = mysql_fetch_row(result));
+	     i++) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[TXN_REQ_TS]);
 
@@ -4534,7 +4545,8 @@ static buf_t *_pack_archive_usage(MYSQL_RES *result, char *cluster_name,
 	pack32(cnt, buffer);
 	pack16(period, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	for (uint32_t i = 0; (i < cnt) && (row = mysql_fetch_row(result));
+	     i++) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[USAGE_START]);
 
@@ -4661,7 +4673,8 @@ static buf_t *_pack_archive_cluster_usage(MYSQL_RES *result, char *cluster_name,
 	pack32(cnt, buffer);
 	pack16(period, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	for (uint32_t i = 0; (i < cnt) && (row = mysql_fetch_row(result));
+	     i++) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[CLUSTER_START]);
 
@@ -4757,6 +4770,18 @@ static char *_load_cluster_usage(uint16_t rpc_version, buf_t *buffer,
 	return insert;
 }
 
+static int _unlink_archive_file(void *x, void *arg)
+{
+	char *file = x;
+
+	if (unlink(file))
+		error("Can't remove partial archive %s: %m", file);
+	else
+		info("Removed archive %s of failed archive run", file);
+
+	return SLURM_SUCCESS;
+}
+
 /* returns count of events archived or SLURM_ERROR on error */
 static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
 			       char *cluster_name, char *col_name,
@@ -4767,8 +4792,9 @@ static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
 	MYSQL_RES *result = NULL;
 	char *cols = NULL, *query = NULL, *parent_table = NULL,
 		*hash_col = NULL;
-	uint32_t cnt = 0;
+	uint32_t cnt = 0, packed = 0;
 	buf_t *buffer;
+	List seg_files = NULL;
 	int error_code = 0;
 	buf_t *(*pack_func)(MYSQL_RES *result, char *cluster_name,
 			    uint32_t cnt, uint32_t usage_info,
@@ -4868,15 +4894,38 @@ static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
 		return 0;
 	}
 
-	buffer = (*pack_func)(result, cluster_name, cnt, usage_info,
-			      period_start);
+	/*
+	 * Write the rows out in segments of at most MAX_ARCHIVE_SEGMENT
+	 * records, each one in its own archive file, instead of packing the
+	 * whole pass into one buffer.  The rows are only purged by the caller
+	 * once every segment made it to disk, so if one segment fails the
+	 * ones already written are removed again.  Otherwise the next run
+	 * would archive the same rows a second time.
+	 */
+	seg_files = list_create(xfree_ptr);
+	while (packed < cnt) {
+		uint32_t seg_cnt = MIN(cnt - packed, MAX_ARCHIVE_SEGMENT);
+		char *seg_file = NULL;
+
+		buffer = (*pack_func)(result, cluster_name, seg_cnt,
+				      usage_info, period_start);
+		error_code = archive_write_file(buffer, cluster_name,
+						*period_start, period_end,
+						arch_dir, sql_table,
+						archive_period, &seg_file);
+		FREE_NULL_BUFFER(buffer);
+
+		if (error_code != SLURM_SUCCESS)
+			break;
+
+		list_append(seg_files, seg_file);
+		packed += seg_cnt;
+	}
 	mysql_free_result(result);
 
-	error_code = archive_write_file(buffer, cluster_name,
-					*period_start, period_end,
-					arch_dir, sql_table,
-					archive_period);
-	FREE_NULL_BUFFER(buffer);
+	if (error_code != SLURM_SUCCESS)
+		list_for_each(seg_files, _unlink_archive_file, NULL);
+	FREE_NULL_LIST(seg_files);
 
 	if (error_code != SLURM_SUCCESS)
 		return error_code;
@@ -42,6 +42,7 @@
 #include "as_mysql_archive.h"
 #include "src/common/parse_time.h"
 #include "src/common/slurm_time.h"
+#include "src/common/xhash.h"
 
 enum {
 	TIME_ALLOC,
@@ -55,6 +56,9 @@ enum {
 	WCKEY_TABLES
 };
 
+/* Number of hours of jobs to load from the job table per query */
+#define ROLLUP_JOB_CHUNK_HOURS 24
+
 typedef struct {
 	uint64_t count;
 	uint32_t id;
@@ -139,14 +143,38 @@ static int _find_loc_tres(void *x, void *key)
 	return 0;
 }
 
-static int _find_id_usage(void *x, void *key)
+static void _id_usage_hash_id(void *item, const char **key,
+			      uint32_t *key_len)
 {
-	local_id_usage_t *loc = (local_id_usage_t *)x;
-	uint32_t id = *(uint32_t *)key;
+	local_id_usage_t *loc = item;
 
-	if (loc->id == id)
-		return 1;
-	return 0;
+	*key = (char *) &loc->id;
+	*key_len = sizeof(loc->id);
+}
+
+/*
+ * Find the local_id_usage_t for id in usage_hash, adding a new one to both
+ * usage_list and usage_hash if it isn't there yet.  The list keeps the order
+ * the records were first seen in while the hash avoids scanning it for every
+ * job of the hour.
+ */
+static local_id_usage_t *_get_id_usage(List usage_list, xhash_t *usage_hash,
+				       int id, bool create_tres)
+{
+	local_id_usage_t *usage = xhash_get(usage_hash, (char *) &id,
+					    sizeof(id));
+
+	if (!usage) {
+		usage = xmalloc(sizeof(local_id_usage_t));
+		usage->id = id;
+		list_append(usage_list, usage);
+		xhash_add(usage_hash, usage);
+	}
+
+	if (create_tres && !usage->loc_tres)
+		usage->loc_tres = list_create(_destroy_local_tres_usage);
+
+	return usage;
 }
 
 static void _remove_job_tres_time_from_cluster(List c_tres, List j_tres,
@@ -1261,7 +1289,9 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 	time_t curr_end = curr_start + add_sec;
 	char *query = NULL;
 	MYSQL_RES *result = NULL;
+	MYSQL_RES *job_result = NULL;
 	MYSQL_ROW row;
+	time_t job_chunk_end = 0;
 	list_itr_t *a_itr = NULL;
 	list_itr_t *c_itr = NULL;
 	list_itr_t *w_itr = NULL;
@@ -1270,6 +1300,8 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 	List cluster_down_list = list_create(_destroy_local_cluster_usage);
 	List wckey_usage_list = list_create(_destroy_local_id_usage);
 	List resv_usage_list = list_create(_destroy_local_resv_usage);
+	xhash_t *assoc_usage_hash = xhash_init(_id_usage_hash_id, NULL);
+	xhash_t *wckey_usage_hash = xhash_init(_id_usage_hash_id, NULL);
 	uint16_t track_wckey = slurm_get_track_wckey();
 	local_cluster_usage_t *loc_c_usage = NULL;
 	local_cluster_usage_t *c_usage = NULL;
@@ -1387,28 +1419,45 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 		if (c_usage)
 			xassert(c_usage->loc_tres);
 
-		/* now get the jobs during this time only  */
-		query = xstrdup_printf("select %s from \"%s_%s\" as job "
-				       "FORCE INDEX (rollup) "
-				       "where (job.time_eligible && "
-				       "job.time_eligible < %ld && "
-				       "(job.time_end >= %ld || "
-				       "job.time_end = 0)) "
-				       "group by job.job_db_inx "
-				       "order by job.id_assoc, "
-				       "job.time_eligible",
-				       job_str, cluster_name, job_table,
-				       curr_end, curr_start);
+		/*
+		 * Get the jobs for a whole chunk of hours at once and only
+		 * walk the rows in memory for each hour instead of scanning
+		 * the job table again for every hour.  Long running jobs
+		 * would otherwise be read back once per hour of their life.
+		 */
+		if (curr_end > job_chunk_end) {
+			if (job_result)
+				mysql_free_result(job_result);
+
+			job_chunk_end = MAX(curr_end,
+					    MIN(end, curr_start +
+						(add_sec *
+						 ROLLUP_JOB_CHUNK_HOURS)));
+			query = xstrdup_printf(
+				"select %s from \"%s_%s\" as job "
+				"FORCE INDEX (rollup) "
+				"where (job.time_eligible && "
+				"job.time_eligible < %ld && "
+				"(job.time_end >= %ld || "
+				"job.time_end = 0)) "
+				"group by job.job_db_inx "
+				"order by job.id_assoc, "
+				"job.time_eligible",
+				job_str, cluster_name, job_table,
+				job_chunk_end, curr_start);
 
-		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
-		if (!(result = mysql_db_query_ret(
-			      mysql_conn, query, 0))) {
-			rc = SLURM_ERROR;
-			goto end_it;
-		}
-		xfree(query);
+			DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
+				 query);
+			if (!(job_result = mysql_db_query_ret(
+				      mysql_conn, query, 0))) {
+				rc = SLURM_ERROR;
+				goto end_it;
+			}
+			xfree(query);
+		} else
+			mysql_data_seek(job_result, 0);
 
-		while ((row = mysql_fetch_row(result))) {
+		while ((row = mysql_fetch_row(job_result))) {
 			//uint32_t job_id = slurm_atoul(row[JOB_REQ_JOBID]);
 			uint32_t assoc_id = slurm_atoul(row[JOB_REQ_ASSOCID]);
 			uint32_t wckey_id = slurm_atoul(row[JOB_REQ_WCKEYID]);
@@ -1423,6 +1472,11 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 			int loc_seconds = 0;
 			int seconds = 0, suspend_seconds = 0;
 
+			/* Skip jobs of the chunk not running this hour */
+			if ((row_eligible >= curr_end) ||
+			    (row_end && (row_end < curr_start)))
+				continue;
+
 			if (row_start && (row_start < curr_start))
 				row_start = curr_start;
 
@@ -1458,7 +1512,6 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 					      mysql_conn,
 					      query, 0))) {
 					rc = SLURM_ERROR;
-					mysql_free_result(result);
 					goto end_it;
 				}
 				xfree(query);
@@ -1485,13 +1538,13 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 			}
 
 			if (last_id != assoc_id) {
-				a_usage = xmalloc(sizeof(local_id_usage_t));
-				a_usage->id = assoc_id;
-				list_append(assoc_usage_list, a_usage);
-				last_id = assoc_id;
 				/* a_usage->loc_tres is made later,
 				   don't do it here.
 				*/
+				a_usage = _get_id_usage(assoc_usage_list,
+							assoc_usage_hash,
+							assoc_id, false);
+				last_id = assoc_id;
 			}
 
 			/* Short circuit this so so we don't get a pointer. */
@@ -1500,20 +1553,9 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 
 			/* do the wckey calculation */
 			if (last_wckeyid != wckey_id) {
-				list_iterator_reset(w_itr);
-				while ((w_usage = list_next(w_itr)))
-					if (w_usage->id == wckey_id)
-						break;
-
-				if (!w_usage) {
-					w_usage = xmalloc(
-						sizeof(local_id_usage_t));
-					w_usage->id = wckey_id;
-					list_append(wckey_usage_list,
-						    w_usage);
-					w_usage->loc_tres = list_create(
-						_destroy_local_tres_usage);
-				}
+				w_usage = _get_id_usage(wckey_usage_list,
+							wckey_usage_hash,
+							wckey_id, true);
 				last_wckeyid = wckey_id;
 			}
 
@@ -1674,7 +1716,6 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 			_add_planned_time(c_usage, row_start, row_eligible,
 					  array_pending, row_rcpu);
 		}
-		mysql_free_result(result);
 
 		/* now figure out how much more to add to the
 		   associations that could had run in the reservation
@@ -1722,19 +1763,11 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 					r_usage->local_assocs);
 				while ((assoc = list_next(tmp_itr))) {
 					uint32_t associd = slurm_atoul(assoc);
-					if ((last_id != associd) &&
-					    !(a_usage = list_find_first(
-						      assoc_usage_list,
-						      _find_id_usage,
-						      &associd))) {
-						a_usage = xmalloc(
-							sizeof(local_id_usage_t));
-						a_usage->id = associd;
-						list_append(assoc_usage_list,
-							    a_usage);
-						a_usage->loc_tres = list_create(
-							_destroy_local_tres_usage);
-					}
+					if (last_id != associd)
+						a_usage = _get_id_usage(
+							assoc_usage_list,
+							assoc_usage_hash,
+							associd, true);
 					last_id = associd;
 
 					_add_time_tres(a_usage->loc_tres,
@@ -1824,6 +1857,8 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 		a_usage     = NULL;
 		w_usage     = NULL;
 
+		xhash_clear(assoc_usage_hash);
+		xhash_clear(wckey_usage_hash);
 		list_flush(assoc_usage_list);
 		list_flush(cluster_down_list);
 		list_flush(wckey_usage_list);
@@ -1832,6 +1867,8 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 		curr_end = curr_start + add_sec;
 	}
 end_it:
+	if (job_result)
+		mysql_free_result(job_result);
 	xfree(query);
 	xfree(suspend_str);
 	xfree(job_str);
@@ -1846,6 +1883,8 @@ end_it:
 	if (r_itr)
 		list_iterator_destroy(r_itr);
 
+	xhash_free(assoc_usage_hash);
+	xhash_free(wckey_usage_hash);
 	FREE_NULL_LIST(assoc_usage_list);
 	FREE_NULL_LIST(cluster_down_list);
 	FREE_NULL_LIST(wckey_usage_list);
@@ -3553,6 +3553,9 @@ extern int acct_storage_p_get_data(void *db_conn, acct_storage_info_t dinfo,
 	case ACCT_STORAGE_INFO_AGENT_COUNT:
 		*int_data = slurmdbd_agent_queue_count();
 		break;
+	case ACCT_STORAGE_INFO_AGENT_STATS:
+		slurmdbd_agent_get_stats(data);
+		break;
 	default:
 		error("data request %d invalid", dinfo);
 		rc = SLURM_ERROR;
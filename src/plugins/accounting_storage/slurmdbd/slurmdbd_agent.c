@@ -53,14 +53,34 @@ enum {
 typedef struct {
 	uint32_t msg_size;
 	list_t *my_list;
+	uint32_t skip;
 } foreach_get_my_list_t;
 
+typedef struct {
+	uint16_t purge_type;
+	uint32_t skip;
+} foreach_purge_agent_list_t;
+
+typedef struct {
+	int rc;
+	uint32_t skip; /* messages of failed batches before this batch */
+	uint32_t acked; /* messages of this batch acknowledged */
+} foreach_get_rc_t;
+
+typedef struct {
+	uint32_t msg_cnt; /* messages of agent_list sent in this batch */
+	bool mult; /* sent as a DBD_SEND_MULT_MSG */
+	struct timeval sent; /* when the batch was sent */
+} dbd_batch_t;
+
 slurm_persist_conn_t *slurmdbd_conn = NULL;
 
 
 #define DBD_MAGIC		0xDEAD3219
 #define DEBUG_PRINT_MAX_MSG_TYPES 10
 #define MAX_DBD_DEFAULT_ACTION MAX_DBD_ACTION_DISCARD
+#define MAX_DBD_BATCH_MSGS 1000 /* messages per DBD_SEND_MULT_MSG */
+#define MAX_DBD_BATCHES_IN_FLIGHT 4 /* batches sent before reading a reply */
 
 static pthread_mutex_t agent_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  agent_cond = PTHREAD_COND_INITIALIZER;
@@ -77,6 +97,14 @@ static pthread_cond_t  slurmdbd_cond = PTHREAD_COND_INITIALIZER;
 
 static int max_dbd_msg_action = MAX_DBD_DEFAULT_ACTION;
 
+/* Protected by agent_lock */
+static acct_storage_agent_stats_t agent_stats = { 0 };
+/*
+ * Messages at the head of agent_list sent and not yet acknowledged, or left
+ * by a failed batch before ones still in flight
+ */
+static uint32_t agent_in_flight_msgs = 0;
+
 static int _unpack_return_code(uint16_t rpc_version, buf_t *buffer)
 {
 	uint16_t msg_type = -1;
@@ -148,7 +176,7 @@ static int _unpack_return_code(uint16_t rpc_version, buf_t *buffer)
 
 static int _get_return_code(void)
 {
-	int rc = SLURM_ERROR;
+	int rc = SLURM_COMMUNICATIONS_RECEIVE_ERROR;
 	buf_t *buffer = slurm_persist_recv_msg(slurmdbd_conn);
 	if (buffer == NULL)
 		return rc;
@@ -159,36 +187,75 @@ static int _get_return_code(void)
 	return rc;
 }
 
+/*
+ * Remove a message acknowledged by slurmdbd from agent_list. The first skip
+ * messages belong to earlier batches that failed and must be sent again.
+ * Caller must hold agent_lock.
+ * RET true if a message was removed
+ */
+static bool _remove_acked_msg(uint32_t skip)
+{
+	list_itr_t *itr;
+	buf_t *buffer;
+
+	if (!agent_list)
+		return false;
+
+	if (!skip) {
+		buffer = list_dequeue(agent_list);
+	} else {
+		itr = list_iterator_create(agent_list);
+		while ((buffer = list_next(itr)) && skip)
+			skip--;
+		if (buffer)
+			(void) list_remove(itr);
+		list_iterator_destroy(itr);
+	}
+
+	if (!buffer)
+		return false;
+	FREE_NULL_BUFFER(buffer);
+	return true;
+}
+
 static int _get_return_codes(void *x, void *arg)
 {
 	buf_t *out_buf = x;
-	int *rc_ptr = arg;
-	buf_t *b;
+	foreach_get_rc_t *args = arg;
 
-	if ((*rc_ptr = _unpack_return_code(slurmdbd_conn->version, out_buf)) !=
-	    SLURM_SUCCESS)
+	if ((args->rc = _unpack_return_code(slurmdbd_conn->version,
+					    out_buf)) != SLURM_SUCCESS)
 		return -1;
 
-	if ((b = list_dequeue(agent_list))) {
-		FREE_NULL_BUFFER(b);
-	} else {
+	if (_remove_acked_msg(args->skip))
+		args->acked++;
+	else
 		error("DBD_GOT_MULT_MSG unpack message error");
-	}
 
 	return 0;
 }
 
-static int _handle_mult_rc_ret(void)
+/*
+ * Read the reply to a DBD_SEND_MULT_MSG batch and remove the messages it
+ * acknowledges from agent_list.
+ * IN skip - messages of earlier failed batches at the head of agent_list
+ * OUT acked - count of messages of this batch removed
+ */
+static int _handle_mult_rc_ret(uint32_t skip, uint32_t *acked)
 {
 	buf_t *buffer;
 	uint16_t msg_type;
 	persist_rc_msg_t *msg = NULL;
 	dbd_list_msg_t *list_msg = NULL;
+	foreach_get_rc_t args = {
+		.rc = SLURM_ERROR,
+		.skip = skip,
+	};
 	int rc = SLURM_ERROR;
 
 	buffer = slurm_persist_recv_msg(slurmdbd_conn);
 	if (buffer == NULL)
-		return rc;
+		return SLURM_COMMUNICATIONS_RECEIVE_ERROR;
 
 	safe_unpack16(&msg_type, buffer);
 	switch (msg_type) {
@@ -204,10 +271,12 @@ static int _handle_mult_rc_ret(void)
 		slurm_mutex_lock(&agent_lock);
 		if (agent_list) {
 			list_for_each(list_msg->my_list, _get_return_codes,
-				      &rc);
+				      &args);
 		}
 		slurm_mutex_unlock(&agent_lock);
 		slurmdbd_free_list_msg(list_msg);
+		rc = args.rc;
+		*acked = args.acked;
 		break;
 	case PERSIST_RC:
 		if (slurm_persist_unpack_rc_msg(
@@ -484,14 +553,21 @@ end_it:
 }
 
 /*
- * Purge queued records from the agent queue
+ * Purge queued records from the agent queue, leaving alone the ones already
+ * sent in a batch still waiting for its reply.
  */
 static int _purge_agent_list_req(void *x, void *arg)
 {
 	uint16_t msg_type;
 	uint32_t offset;
 	buf_t *buffer = x;
-	uint16_t purge_type = *(uint16_t *)arg;
+	foreach_purge_agent_list_t *args = arg;
+	uint16_t purge_type = args->purge_type;
+
+	if (args->skip) {
+		args->skip--;
+		return 0;
+	}
 
 	offset = get_buf_offset(buffer);
 	if (offset < 2)
@@ -531,16 +607,22 @@ static void _max_dbd_msg_action(uint32_t *msg_cnt)
 
 	/* MAX_DBD_ACTION_DISCARD */
 	if (*msg_cnt >= (slurm_conf.max_dbd_msgs - 1)) {
-		uint16_t purge_type = DBD_STEP_START;
+		foreach_purge_agent_list_t args = {
+			.purge_type = DBD_STEP_START,
+			.skip = agent_in_flight_msgs,
+		};
 		purged = list_delete_all(agent_list, _purge_agent_list_req,
-					 &purge_type);
+					 &args);
 		*msg_cnt -= purged;
 		info("purge %d step records", purged);
 	}
 	if (*msg_cnt >= (slurm_conf.max_dbd_msgs - 1)) {
-		uint16_t purge_type = DBD_JOB_START;
+		foreach_purge_agent_list_t args = {
+			.purge_type = DBD_JOB_START,
+			.skip = agent_in_flight_msgs,
+		};
 		purged = list_delete_all(agent_list, _purge_agent_list_req,
-					 &purge_type);
+					 &args);
 		*msg_cnt -= purged;
 		info("purge %d job start records", purged);
 	}
@@ -597,6 +679,12 @@ static int _get_my_list(void *x, void *arg)
 	buf_t *buffer = x;
 	foreach_get_my_list_t *args = arg;
 
+	/* Already sent in a batch still waiting for its reply */
+	if (args->skip) {
+		args->skip--;
+		return 0;
+	}
+
 	args->msg_size += size_buf(buffer);
 	if (args->msg_size > MAX_MSG_SIZE)
 		return -1;
@@ -605,29 +693,197 @@ static int _get_my_list(void *x, void *arg)
 	return 0;
 }
 
+/*
+ * Pack the next batch of messages from agent_list, skipping the first
+ * in_flight messages which were already sent and not yet acknowledged.
+ * RET buffer to send or NULL if there is nothing left to send. When
+ * batch->mult is false the buffer is the one queued in agent_list and must
+ * not be freed by the caller.
+ */
+static buf_t *_pack_batch(uint32_t in_flight, dbd_batch_t *batch)
+{
+	persist_msg_t list_req = { 0 };
+	dbd_list_msg_t list_msg = { 0 };
+	buf_t *buffer = NULL;
+	uint32_t cnt;
+
+	slurm_mutex_lock(&agent_lock);
+	if (!agent_list || ((cnt = list_count(agent_list)) <= in_flight)) {
+		slurm_mutex_unlock(&agent_lock);
+		return NULL;
+	}
+
+	if (!in_flight && (cnt == 1)) {
+		batch->msg_cnt = 1;
+		batch->mult = false;
+		buffer = list_peek(agent_list);
+	} else {
+		int max_rpcs = in_flight + MAX_DBD_BATCH_MSGS;
+		foreach_get_my_list_t args = {
+			.msg_size = sizeof(list_req),
+			.my_list = list_create(NULL),
+			.skip = in_flight,
+		};
+
+		list_for_each_max(agent_list, &max_rpcs, _get_my_list, &args,
+				  1, true);
+
+		list_req.msg_type = DBD_SEND_MULT_MSG;
+		list_req.conn = slurmdbd_conn;
+		list_req.data = &list_msg;
+		list_msg.my_list = args.my_list;
+
+		if ((batch->msg_cnt = list_count(args.my_list))) {
+			batch->mult = true;
+			buffer = pack_slurmdbd_msg(&list_req,
+						   SLURM_PROTOCOL_VERSION);
+		} else if (!in_flight) {
+			/* First message alone is over MAX_MSG_SIZE */
+			batch->msg_cnt = 1;
+			batch->mult = false;
+			buffer = list_peek(agent_list);
+		}
+		FREE_NULL_LIST(args.my_list);
+	}
+	if (buffer)
+		agent_in_flight_msgs = in_flight + batch->msg_cnt;
+	slurm_mutex_unlock(&agent_lock);
+
+	return buffer;
+}
+
+static void _record_batch_latency(dbd_batch_t *batch)
+{
+	uint32_t latency = slurm_delta_tv(&batch->sent);
+
+	slurm_mutex_lock(&agent_lock);
+	agent_stats.batch_cnt++;
+	agent_stats.latency_sum += latency;
+	agent_stats.latency_max = MAX(agent_stats.latency_max, latency);
+	slurm_mutex_unlock(&agent_lock);
+
+	log_flag(DBD_AGENT, "slurmdbd agent batch of %u messages acknowledged in %u usec",
+		 batch->msg_cnt, latency);
+}
+
+/*
+ * Send the queued messages keeping up to MAX_DBD_BATCHES_IN_FLIGHT batches
+ * on the wire before waiting for a reply. slurmdbd processes the messages
+ * of a connection in order and replies in the same order, so the replies
+ * are matched to the oldest batch sent. Messages stay in agent_list until
+ * acknowledged.
+ * After a batch fails no new batch is sent, but the replies to the batches
+ * already sent are still applied as slurmdbd has committed them. Only the
+ * messages of the failed batches stay queued to be sent again.
+ * NOTE: slurmdbd_lock must be locked on entry. Nothing is left in flight on
+ * return so slurmdbd_agent_send_recv() can use the connection.
+ * RET SLURM_SUCCESS or error code of the first failed batch.
+ */
+static int _send_batches(void)
+{
+	dbd_batch_t batches[MAX_DBD_BATCHES_IN_FLIGHT];
+	dbd_batch_t *batch;
+	int head = 0, in_flight = 0;
+	uint32_t in_flight_msgs = 0, failed_msgs = 0, acked;
+	int rc = SLURM_SUCCESS, batch_rc;
+	buf_t *buffer;
+
+	while (true) {
+		while ((rc == SLURM_SUCCESS) &&
+		       (in_flight < MAX_DBD_BATCHES_IN_FLIGHT) && !halt_agent &&
+		       !*slurmdbd_conn->shutdown) {
+			batch = &batches[(head + in_flight) %
+					 MAX_DBD_BATCHES_IN_FLIGHT];
+			if (!(buffer = _pack_batch(in_flight_msgs, batch)))
+				break;
+
+			batch->sent.tv_sec = 0;
+			(void) slurm_delta_tv(&batch->sent);
+
+			/*
+			 * NOTE: agent_lock is clear here, so we can add more
+			 * requests to the queue while waiting for this RPC to
+			 * complete.
+			 */
+			rc = slurm_persist_send_msg(slurmdbd_conn, buffer);
+			if (batch->mult)
+				FREE_NULL_BUFFER(buffer);
+			if (rc != SLURM_SUCCESS) {
+				if (!*slurmdbd_conn->shutdown)
+					error("Failure sending message: %d: %m",
+					      rc);
+				break;
+			}
+
+			in_flight++;
+			in_flight_msgs += batch->msg_cnt;
+		}
+
+		if (!in_flight)
+			break;
+
+		batch = &batches[head];
+		head = (head + 1) % MAX_DBD_BATCHES_IN_FLIGHT;
+		in_flight--;
+		in_flight_msgs -= batch->msg_cnt;
+
+		acked = 0;
+		if (batch->mult) {
+			batch_rc = _handle_mult_rc_ret(failed_msgs, &acked);
+		} else if ((batch_rc = _get_return_code()) == SLURM_SUCCESS) {
+			slurm_mutex_lock(&agent_lock);
+			if (_remove_acked_msg(failed_msgs))
+				acked = 1;
+			slurm_mutex_unlock(&agent_lock);
+		} else if ((batch_rc == EAGAIN) && !*slurmdbd_conn->shutdown) {
+			error("Failure with message need to resend: %d: %m",
+			      batch_rc);
+		}
+
+		/* Unacknowledged messages of this batch stay queued */
+		slurm_mutex_lock(&agent_lock);
+		failed_msgs += batch->msg_cnt - acked;
+		agent_in_flight_msgs = failed_msgs + in_flight_msgs;
+		slurm_mutex_unlock(&agent_lock);
+
+		if (batch_rc == SLURM_SUCCESS) {
+			_record_batch_latency(batch);
+			continue;
+		}
+
+		if (rc == SLURM_SUCCESS)
+			rc = batch_rc;
+
+		/*
+		 * Without this reply the ones of later batches can not be
+		 * matched to their messages, which stay queued to be resent.
+		 */
+		if (batch_rc == SLURM_COMMUNICATIONS_RECEIVE_ERROR)
+			break;
+	}
+
+	slurm_mutex_lock(&agent_lock);
+	agent_in_flight_msgs = 0;
+	slurm_mutex_unlock(&agent_lock);
+
+	return rc;
+}
+
 static void *_agent(void *x)
 {
 	int rc;
 	uint32_t cnt;
-	buf_t *buffer;
 	struct timespec abs_time;
 	static time_t fail_time = 0;
-	persist_msg_t list_req = {0};
-	dbd_list_msg_t list_msg;
 	DEF_TIMERS;
 
 	slurm_mutex_lock(&agent_lock);
 	agent_running = true;
 	slurm_mutex_unlock(&agent_lock);
 
-	list_req.msg_type = DBD_SEND_MULT_MSG;
-	list_req.conn = slurmdbd_conn;
-	list_req.data = &list_msg;
-	memset(&list_msg, 0, sizeof(dbd_list_msg_t));
-
 	log_flag(DBD_AGENT, "slurmdbd agent_count=%d with msg_type=%s",
 		 list_count(agent_list),
-		 slurmdbd_msg_type_2_str(list_req.msg_type, 1));
+		 slurmdbd_msg_type_2_str(DBD_SEND_MULT_MSG, 1));
 
 	while (*slurmdbd_conn->shutdown == 0) {
 		slurm_mutex_lock(&slurmdbd_lock);
@@ -669,65 +925,16 @@ static void *_agent(void *x)
 		} else if (((cnt > 0) && ((cnt % 100) == 0)) ||
 		           (slurm_conf.debug_flags & DEBUG_FLAG_DBD_AGENT))
 			info("agent_count:%d", cnt);
-		/* Leave item on the queue until processing complete */
-		if (agent_list) {
-			if (cnt > 1) {
-				int max_rpcs = 1000;
-				foreach_get_my_list_t args = {
-					.msg_size = sizeof(list_req),
-					.my_list = list_create(NULL),
-				};
-
-				list_msg.my_list = args.my_list;
-
-				list_for_each_max(agent_list, &max_rpcs,
-						  _get_my_list, &args, 1, true);
-				buffer = pack_slurmdbd_msg(
-					&list_req, SLURM_PROTOCOL_VERSION);
-			} else
-				buffer = list_peek(agent_list);
-		} else
-			buffer = NULL;
 		slurm_mutex_unlock(&agent_lock);
-		if (buffer == NULL) {
-			slurm_mutex_unlock(&slurmdbd_lock);
-
-			slurm_mutex_lock(&assoc_cache_mutex);
-			if (slurmdbd_conn->fd >= 0 &&
-			    (running_cache != RUNNING_CACHE_STATE_NOTRUNNING))
-				slurm_cond_signal(&assoc_cache_cond);
-			slurm_mutex_unlock(&assoc_cache_mutex);
 
-			END_TIMER2("slurmdbd agent: empty buffer");
-			continue;
-		}
-
-		/* NOTE: agent_lock is clear here, so we can add more
-		 * requests to the queue while waiting for this RPC to
-		 * complete. */
-		rc = slurm_persist_send_msg(slurmdbd_conn, buffer);
-		if (rc != SLURM_SUCCESS) {
-			if (*slurmdbd_conn->shutdown) {
-				slurm_mutex_unlock(&slurmdbd_lock);
-				END_TIMER2("slurmdbd agent: shutdown");
-				break;
-			}
-			error("Failure sending message: %d: %m", rc);
-		} else if (list_msg.my_list) {
-			rc = _handle_mult_rc_ret();
-		} else {
-			rc = _get_return_code();
-			if (rc == EAGAIN) {
-				if (*slurmdbd_conn->shutdown) {
-					slurm_mutex_unlock(&slurmdbd_lock);
-					END_TIMER2("slurmdbd agent: EAGAIN on shutdown");
-					break;
-				}
-				error("Failure with "
-				      "message need to resend: %d: %m", rc);
-			}
+		rc = _send_batches();
+		if ((rc != SLURM_SUCCESS) && *slurmdbd_conn->shutdown) {
+			slurm_mutex_unlock(&slurmdbd_lock);
+			END_TIMER2("slurmdbd agent: shutdown");
+			break;
 		}
 		slurm_mutex_unlock(&slurmdbd_lock);
+
 		slurm_mutex_lock(&assoc_cache_mutex);
 		if (slurmdbd_conn->fd >= 0 &&
 		    (running_cache != RUNNING_CACHE_STATE_NOTRUNNING))
@@ -735,30 +942,9 @@ static void *_agent(void *x)
 		slurm_mutex_unlock(&assoc_cache_mutex);
 
 		slurm_mutex_lock(&agent_lock);
-		if (agent_list && (rc == SLURM_SUCCESS)) {
-			/*
-			 * If we sent a mult_msg we just need to free buffer,
-			 * we don't need to requeue, just mark list_msg.my_list
-			 * as NULL as that is the sign we sent a mult_msg.
-			 */
-			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					FREE_NULL_LIST(list_msg.my_list);
-				list_msg.my_list = NULL;
-			} else
-				buffer = list_dequeue(agent_list);
-
-			FREE_NULL_BUFFER(buffer);
+		if (rc == SLURM_SUCCESS) {
 			fail_time = 0;
 		} else {
-			/* We need to free a mult_msg even on failure */
-			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					FREE_NULL_LIST(list_msg.my_list);
-				list_msg.my_list = NULL;
-				FREE_NULL_BUFFER(buffer);
-			}
-
 			fail_time = time(NULL);
 
 			if (slurm_conf.debug_flags & DEBUG_FLAG_DBD_AGENT) {
@@ -993,6 +1179,13 @@ extern int slurmdbd_agent_queue_count(void)
 	return list_count(agent_list);
 }
 
+extern void slurmdbd_agent_get_stats(acct_storage_agent_stats_t *stats)
+{
+	slurm_mutex_lock(&agent_lock);
+	*stats = agent_stats;
+	slurm_mutex_unlock(&agent_lock);
+}
+
 extern void slurmdbd_agent_config_setup(void)
 {
 	char *tmp_ptr;
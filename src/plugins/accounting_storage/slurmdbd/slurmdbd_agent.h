@@ -74,6 +74,9 @@ extern bool slurmdbd_conn_active(void);
 /* Return the number of messages waiting to be sent to the DBD */
 extern int slurmdbd_agent_queue_count(void);
 
+/* Copy the agent's batch statistics into stats */
+extern void slurmdbd_agent_get_stats(acct_storage_agent_stats_t *stats);
+
 /* set up local variables based on slurm.conf params */
 extern void slurmdbd_agent_config_setup(void);
 
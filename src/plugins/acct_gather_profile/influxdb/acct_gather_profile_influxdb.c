@@ -45,6 +45,8 @@
  *  Copyright (C) 2002 The Regents of the University of California.
  \*****************************************************************************/
 
+#include "config.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
@@ -57,6 +59,10 @@
 #include <math.h>
 #include <curl/curl.h>
 
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "src/common/slurm_xlator.h"
 #include "src/common/fd.h"
 #include "src/common/macros.h"
@@ -69,6 +75,9 @@
 #include "src/interfaces/proctrack.h"
 
 #define DEFAULT_INFLUXDB_TIMEOUT 10
+#define INFLUXDB_FLUSH_INTERVAL 30	/* max seconds samples stay buffered */
+#define INFLUXDB_MAX_BACKOFF 60		/* max seconds between failed sends */
+#define INFLUXDB_MAX_PENDING 64		/* max full buffers waiting to be sent */
 
 /*
  * These variables are required by the generic plugin interface.  If they
@@ -131,8 +140,19 @@ static slurm_influxdb_conf_t influxdb_conf;
 static uint32_t g_profile_running = ACCT_GATHER_PROFILE_NOT_SET;
 static stepd_step_rec_t *g_job = NULL;
 
+/*
+ * Samples are appended to datastr. Full buffers are queued in send_list and
+ * posted to influxdb by send_thread, so sampling never waits on the server.
+ */
+static pthread_mutex_t send_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t send_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t send_thread = 0;
+static bool send_shutdown = false;
+static list_t *send_list = NULL;
 static char *datastr = NULL;
 static int datastrlen = 0;
+static time_t datastr_time = 0;	/* when the first sample was buffered */
+static struct curl_slist *gzip_headers = NULL;
 
 static table_t *tables = NULL;
 static size_t tables_max_len = 0;
@@ -193,74 +213,89 @@ static size_t _write_callback(void *contents, size_t size, size_t nmemb,
 	return realsize;
 }
 
-/* Try to send data to influxdb */
-static int _send_data(const char *data)
+#if HAVE_ZLIB
+/*
+ * Compress data in the gzip format influxdb accepts with
+ * "Content-Encoding: gzip".
+ * OUT out_len - size of the compressed data
+ * RET compressed data, caller must xfree(), or NULL on error
+ */
+static char *_gzip_data(const char *data, size_t length, size_t *out_len)
+{
+	z_stream strm = { 0 };
+	char *out;
+	uLong bound;
+	int rc;
+
+	/* windowBits 15 + 16 to write a gzip header and trailer */
+	if ((rc = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			       15 + 16, 8, Z_DEFAULT_STRATEGY)) != Z_OK) {
+		error("%s %s: deflateInit2 failed: %d",
+		      plugin_type, __func__, rc);
+		return NULL;
+	}
+
+	bound = deflateBound(&strm, length);
+	out = xmalloc(bound);
+	strm.next_in = (Bytef *) data;
+	strm.avail_in = length;
+	strm.next_out = (Bytef *) out;
+	strm.avail_out = bound;
+
+	if ((rc = deflate(&strm, Z_FINISH)) != Z_STREAM_END) {
+		error("%s %s: deflate failed: %d", plugin_type, __func__, rc);
+		xfree(out);
+	} else {
+		*out_len = strm.total_out;
+	}
+	deflateEnd(&strm);
+
+	return out;
+}
+#endif
+
+/*
+ * Post data to influxdb
+ * OUT retry - true if the request may succeed later, e.g. when the server
+ *	could not be reached or is overloaded
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+static int _send_data(CURL *curl_handle, const char *data, bool *retry)
 {
-	CURL *curl_handle = NULL;
 	CURLcode res;
 	struct http_response chunk;
 	int rc = SLURM_SUCCESS;
 	long response_code;
 	static int error_cnt = 0;
-	char *url = NULL;
-	size_t length;
+	size_t length = strlen(data), send_len = length;
+	char *gzip_data = NULL;
 
 	debug3("%s %s called", plugin_type, __func__);
 
-	/*
-	 * Every compute node which is sampling data will try to establish a
-	 * different connection to the influxdb server. In order to reduce the
-	 * number of connections, every time a new sampled data comes in, it
-	 * is saved in the 'datastr' buffer. Once this buffer is full, then we
-	 * try to open the connection and send this buffer, instead of opening
-	 * one per sample.
-	 */
-	if (data && ((datastrlen + strlen(data)) <= BUF_SIZE)) {
-		xstrcat(datastr, data);
-		length = strlen(data);
-		datastrlen += length;
-		log_flag(PROFILE, "%s %s: %zu bytes of data added to buffer. New buffer size: %d",
-			 plugin_type, __func__, length, datastrlen);
-		return rc;
-	}
+	*retry = false;
 
 	DEF_TIMERS;
 	START_TIMER;
 
-	if (curl_global_init(CURL_GLOBAL_ALL) != 0) {
-		error("%s %s: curl_global_init: %m", plugin_type, __func__);
-		rc = SLURM_ERROR;
-		goto cleanup_global_init;
-	} else if ((curl_handle = curl_easy_init()) == NULL) {
-		error("%s %s: curl_easy_init: %m", plugin_type, __func__);
-		rc = SLURM_ERROR;
-		goto cleanup_easy_init;
-	}
-
-	xstrfmtcat(url, "%s/write?db=%s&rp=%s&precision=s", influxdb_conf.host,
-		   influxdb_conf.database, influxdb_conf.rt_policy);
-
 	chunk.message = xmalloc(1);
 	chunk.size = 0;
 
-	curl_easy_setopt(curl_handle, CURLOPT_URL, url);
-	if (influxdb_conf.password)
-		curl_easy_setopt(curl_handle, CURLOPT_PASSWORD,
-				 influxdb_conf.password);
-	curl_easy_setopt(curl_handle, CURLOPT_POST, 1);
-	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, datastr);
-	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, strlen(datastr));
-	if (influxdb_conf.username)
-		curl_easy_setopt(curl_handle, CURLOPT_USERNAME,
-				 influxdb_conf.username);
-	curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, _write_callback);
+#if HAVE_ZLIB
+	if (gzip_headers && (gzip_data = _gzip_data(data, length, &send_len)))
+		data = gzip_data;
+#endif
+	/* Send the body uncompressed if it could not be compressed */
+	curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER,
+			 gzip_data ? gzip_headers : NULL);
+	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, data);
+	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, (long) send_len);
 	curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *) &chunk);
-	curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, influxdb_conf.timeout);
 
 	if ((res = curl_easy_perform(curl_handle)) != CURLE_OK) {
 		if ((error_cnt++ % 100) == 0)
-			error("%s %s: curl_easy_perform failed to send data (discarded). Reason: %s",
+			error("%s %s: curl_easy_perform failed to send data. Reason: %s",
 			      plugin_type, __func__, curl_easy_strerror(res));
+		*retry = true;
 		rc = SLURM_ERROR;
 		goto cleanup;
 	}
@@ -285,12 +320,16 @@ static int _send_data(const char *data)
 			error_cnt = 0;
 	} else {
 		rc = SLURM_ERROR;
+		if ((response_code >= 500) || (response_code == 408) ||
+		    (response_code == 429))
+			*retry = true;
 		debug2("%s %s: data write failed, response code: %ld",
 		       plugin_type, __func__, response_code);
 		if (slurm_conf.debug_flags & DEBUG_FLAG_PROFILE) {
 			/* Strip any trailing newlines. */
-			while (chunk.message[strlen(chunk.message) - 1] == '\n')
-				chunk.message[strlen(chunk.message) - 1] = '\0';
+			while (chunk.size &&
+			       (chunk.message[chunk.size - 1] == '\n'))
+				chunk.message[--chunk.size] = '\0';
 			info("%s %s: JSON response body: %s", plugin_type,
 			     __func__, chunk.message);
 		}
@@ -298,25 +337,186 @@ static int _send_data(const char *data)
 
 cleanup:
 	xfree(chunk.message);
-	xfree(url);
-cleanup_easy_init:
-	curl_easy_cleanup(curl_handle);
-cleanup_global_init:
-	curl_global_cleanup();
+	xfree(gzip_data);
 
 	END_TIMER;
-	log_flag(PROFILE, "%s %s: took %s to send data",
-		 plugin_type, __func__, TIME_STR);
+	log_flag(PROFILE, "%s %s: took %s to send %zu bytes of data as %zu bytes",
+		 plugin_type, __func__, TIME_STR, length, send_len);
 
-	if (data) {
-		datastr = xstrdup(data);
-		datastrlen = strlen(data);
-	} else {
-		datastr[0] = '\0';
-		datastrlen = 0;
+	return rc;
+}
+
+/* Queue datastr to be sent, send_mutex must be locked */
+static void _queue_data(void)
+{
+	static int drop_cnt = 0;
+
+	if (!datastrlen)
+		return;
+
+	/*
+	 * Every compute node which is sampling data will try to establish a
+	 * different connection to the influxdb server. In order to reduce the
+	 * number of requests, samples are saved in the 'datastr' buffer and
+	 * only sent once it is full, a task ends or INFLUXDB_FLUSH_INTERVAL
+	 * passed. If the server does not keep up, the oldest data is dropped.
+	 */
+	if (list_count(send_list) >= INFLUXDB_MAX_PENDING) {
+		xfree_ptr(list_dequeue(send_list));
+		if ((drop_cnt++ % 100) == 0)
+			error("%s %s: %d buffers already waiting to be sent, oldest data discarded",
+			      plugin_type, __func__, INFLUXDB_MAX_PENDING);
 	}
 
-	return rc;
+	list_enqueue(send_list, datastr);
+	datastr = NULL;
+	datastrlen = 0;
+	slurm_cond_signal(&send_cond);
+}
+
+/* Add data to the buffer of samples, never waits on the server */
+static void _buffer_data(const char *data)
+{
+	size_t length = strlen(data);
+
+	slurm_mutex_lock(&send_mutex);
+	if (datastrlen && ((datastrlen + length) > BUF_SIZE))
+		_queue_data();
+	if (!datastrlen) {
+		/* Arm the flush timer of the send thread */
+		datastr_time = time(NULL);
+		slurm_cond_signal(&send_cond);
+	}
+	xstrcat(datastr, data);
+	datastrlen += length;
+	log_flag(PROFILE, "%s %s: %zu bytes of data added to buffer. New buffer size: %d",
+		 plugin_type, __func__, length, datastrlen);
+	slurm_mutex_unlock(&send_mutex);
+}
+
+/* Set up the handle used for every request, reusing the connection */
+static CURL *_init_curl(char **url)
+{
+	CURL *curl_handle;
+
+	if (!(curl_handle = curl_easy_init())) {
+		error("%s %s: curl_easy_init: %m", plugin_type, __func__);
+		return NULL;
+	}
+
+	xstrfmtcat(*url, "%s/write?db=%s&rp=%s&precision=s",
+		   influxdb_conf.host, influxdb_conf.database,
+		   influxdb_conf.rt_policy);
+
+	curl_easy_setopt(curl_handle, CURLOPT_URL, *url);
+	if (influxdb_conf.password)
+		curl_easy_setopt(curl_handle, CURLOPT_PASSWORD,
+				 influxdb_conf.password);
+	curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
+	if (influxdb_conf.username)
+		curl_easy_setopt(curl_handle, CURLOPT_USERNAME,
+				 influxdb_conf.username);
+	curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, _write_callback);
+	curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT,
+			 (long) influxdb_conf.timeout);
+	curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+#if HAVE_ZLIB
+	gzip_headers = curl_slist_append(NULL, "Content-Encoding: gzip");
+#endif
+
+	return curl_handle;
+}
+
+/*
+ * Send queued buffers to influxdb. A buffer that fails to be sent for a reason
+ * which may go away is retried, waiting twice as long after each failure up to
+ * INFLUXDB_MAX_BACKOFF. At shutdown everything left is tried once.
+ */
+static void *_send_thread_func(void *arg)
+{
+	CURL *curl_handle = NULL;
+	char *url = NULL, *data;
+	int backoff = 0;
+	time_t retry_time = 0;
+
+	if (curl_global_init(CURL_GLOBAL_ALL) != 0) {
+		error("%s %s: curl_global_init: %m", plugin_type, __func__);
+		goto cleanup_global_init;
+	}
+	curl_handle = _init_curl(&url);
+
+	slurm_mutex_lock(&send_mutex);
+	while (true) {
+		struct timespec ts = { 0, 0 };
+		time_t now = time(NULL);
+		bool retry = false;
+		int rc;
+
+		if (datastrlen &&
+		    (send_shutdown ||
+		     (now >= (datastr_time + INFLUXDB_FLUSH_INTERVAL))))
+			_queue_data();
+
+		if (!list_count(send_list)) {
+			if (send_shutdown)
+				break;
+			if (datastrlen) {
+				ts.tv_sec = datastr_time +
+					    INFLUXDB_FLUSH_INTERVAL;
+				slurm_cond_timedwait(&send_cond, &send_mutex,
+						     &ts);
+			} else {
+				slurm_cond_wait(&send_cond, &send_mutex);
+			}
+			continue;
+		}
+
+		if (!send_shutdown && (now < retry_time)) {
+			ts.tv_sec = retry_time;
+			slurm_cond_timedwait(&send_cond, &send_mutex, &ts);
+			continue;
+		}
+
+		data = list_dequeue(send_list);
+		slurm_mutex_unlock(&send_mutex);
+
+		if (curl_handle)
+			rc = _send_data(curl_handle, data, &retry);
+		else
+			rc = SLURM_ERROR;
+
+		slurm_mutex_lock(&send_mutex);
+		if (!rc) {
+			backoff = 0;
+			retry_time = 0;
+		} else if (retry && !send_shutdown) {
+			list_push(send_list, data);
+			data = NULL;
+			backoff = backoff ? MIN(backoff * 2,
+						INFLUXDB_MAX_BACKOFF) : 1;
+			retry_time = time(NULL) + backoff;
+			log_flag(PROFILE, "%s %s: retrying in %d seconds, %d buffers waiting",
+				 plugin_type, __func__, backoff,
+				 list_count(send_list));
+		} else if (retry && list_count(send_list)) {
+			error("%s %s: unable to send data at shutdown, %d buffers discarded",
+			      plugin_type, __func__, list_count(send_list));
+			list_flush(send_list);
+		} else {
+			debug2("%s %s: data discarded", plugin_type, __func__);
+		}
+		xfree(data);
+	}
+	slurm_mutex_unlock(&send_mutex);
+
+	xfree(url);
+	if (curl_handle)
+		curl_easy_cleanup(curl_handle);
+	curl_slist_free_all(gzip_headers);
+	gzip_headers = NULL;
+	curl_global_cleanup();
+cleanup_global_init:
+	return NULL;
 }
 
 /*
@@ -330,7 +530,7 @@ extern int init(void)
 	if (!running_in_slurmstepd())
 		return SLURM_SUCCESS;
 
-	datastr = xmalloc(BUF_SIZE);
+	send_list = list_create(xfree_ptr);
 	return SLURM_SUCCESS;
 }
 
@@ -338,7 +538,16 @@ extern int fini(void)
 {
 	debug3("%s %s called", plugin_type, __func__);
 
+	if (send_thread) {
+		slurm_mutex_lock(&send_mutex);
+		send_shutdown = true;
+		slurm_cond_signal(&send_cond);
+		slurm_mutex_unlock(&send_mutex);
+		slurm_thread_join(send_thread);
+	}
+
 	_free_tables();
+	FREE_NULL_LIST(send_list);
 	xfree(datastr);
 	xfree(influxdb_conf.host);
 	xfree(influxdb_conf.database);
@@ -454,6 +663,11 @@ extern int acct_gather_profile_p_node_step_start(stepd_step_rec_t* job)
 	debug2("%s %s: option --profile=%s", plugin_type, __func__,
 	       profile_str);
 	g_profile_running = _determine_profile();
+
+	/* Started here as influxdb_conf is not set yet in init() */
+	if ((g_profile_running > ACCT_GATHER_PROFILE_NONE) && !send_thread)
+		slurm_thread_create(&send_thread, _send_thread_func, NULL);
+
 	return rc;
 }
 
@@ -495,7 +709,12 @@ extern int acct_gather_profile_p_task_end(pid_t taskpid)
 {
 	debug3("%s %s called", plugin_type, __func__);
 
-	_send_data(NULL);
+	if (!send_thread)
+		return SLURM_SUCCESS;
+
+	slurm_mutex_lock(&send_mutex);
+	_queue_data();
+	slurm_mutex_unlock(&send_mutex);
 	return SLURM_SUCCESS;
 }
 
@@ -592,7 +811,8 @@ extern int acct_gather_profile_p_add_sample_data(int table_id, void *data,
 		}
 	}
 
-	_send_data(str);
+	if (str)
+		_buffer_data(str);
 	xfree(str);
 
 	return SLURM_SUCCESS;
@@ -50,6 +50,7 @@
 
 #include "slurm/slurm_errno.h"
 #include "src/common/slurm_xlator.h"
+#include "src/common/auth_cache.h"
 #include "src/common/pack.h"
 #include "src/common/read_config.h"
 #include "src/common/slurm_protocol_api.h"
@@ -96,6 +97,7 @@ const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 const bool hash_enable = true;
 
 static int bad_cred_test = -1;
+static auth_cache_t *cred_cache = NULL;
 
 /*
  * The Munge implementation of the slurm AUTH credential
@@ -114,6 +116,17 @@ typedef struct {
 	int dlen;          /* payload data length */
 } auth_credential_t;
 
+/*
+ * Fields of a verified credential kept in cred_cache
+ */
+typedef struct {
+	struct in_addr addr;
+	uid_t uid;
+	gid_t gid;
+	void *data;
+	int dlen;
+} cached_cred_t;
+
 extern auth_credential_t *auth_p_create(char *opts, uid_t r_uid, void *data,
 					int dlen);
 extern void auth_p_destroy(auth_credential_t *cred);
@@ -123,6 +136,60 @@ extern void auth_p_destroy(auth_credential_t *cred);
 static int _decode_cred(auth_credential_t *c, char *socket, bool test);
 static void _print_cred(munge_ctx_t ctx);
 
+static void _free_cached_cred(void *x)
+{
+	cached_cred_t *cached = x;
+
+	free(cached->data);
+	xfree(cached);
+}
+
+static bool _copy_cached_cred(void *x, void *arg)
+{
+	cached_cred_t *cached = x;
+	auth_credential_t *c = arg;
+
+	c->addr = cached->addr;
+	c->uid = cached->uid;
+	c->gid = cached->gid;
+	if (cached->data && cached->dlen) {
+		/* matches munge_decode() which uses malloc() */
+		c->data = malloc(cached->dlen);
+		memcpy(c->data, cached->data, cached->dlen);
+		c->dlen = cached->dlen;
+	}
+
+	return true;
+}
+
+static void _cache_cred(auth_credential_t *c, munge_ctx_t ctx)
+{
+	cached_cred_t *cached;
+	time_t encode_time;
+	int ttl;
+
+	if (!cred_cache)
+		return;
+
+	if ((munge_ctx_get(ctx, MUNGE_OPT_ENCODE_TIME, &encode_time) !=
+	     EMUNGE_SUCCESS) ||
+	    (munge_ctx_get(ctx, MUNGE_OPT_TTL, &ttl) != EMUNGE_SUCCESS))
+		return;
+
+	cached = xmalloc(sizeof(*cached));
+	cached->addr = c->addr;
+	cached->uid = c->uid;
+	cached->gid = c->gid;
+	if (c->data && c->dlen) {
+		cached->data = malloc(c->dlen);
+		memcpy(cached->data, c->data, c->dlen);
+		cached->dlen = c->dlen;
+	}
+
+	auth_cache_add(cred_cache, c->m_str, strlen(c->m_str),
+		       (encode_time + ttl), cached);
+}
+
 /*
  *  Munge plugin initialization
  */
@@ -157,12 +224,20 @@ int init(void)
 		xfree(socket);
 		auth_p_destroy(cred);
 	}
+
+	if (running_in_daemon())
+		cred_cache = auth_cache_create(plugin_type,
+					       auth_cache_get_size(),
+					       _free_cached_cred);
+
 	debug("loaded");
 	return rc;
 }
 
 extern int fini(void)
 {
+	auth_cache_destroy(cred_cache);
+	cred_cache = NULL;
 	return SLURM_SUCCESS;
 }
 
@@ -514,6 +589,26 @@ static int _decode_cred(auth_credential_t *c, char *socket, bool test)
 	if (c->verified)
 		return SLURM_SUCCESS;
 
+	/*
+	 * munged rejects any credential it has already decoded, so a hit here
+	 * is a replay that can be refused without another round trip to
+	 * munged. Entries are dropped once munged would consider the
+	 * credential expired.
+	 */
+	if (!test && auth_cache_find(cred_cache, c->m_str, strlen(c->m_str),
+				     _copy_cached_cred, c)) {
+#ifdef MULTIPLE_SLURMD
+		debug2("We had a replayed cred, but this is expected in multiple slurmd mode.");
+		c->verified = true;
+		return SLURM_SUCCESS;
+#else
+		error("Munge decode failed: Replayed credential (uid=%u gid=%u)",
+		      c->uid, c->gid);
+		slurm_seterrno(ESLURM_AUTH_CRED_INVALID);
+		return SLURM_ERROR;
+#endif
+	}
+
 	if ((ctx = munge_ctx_create()) == NULL) {
 		error("munge_ctx_create failure");
 		return SLURM_ERROR;
@@ -578,6 +673,9 @@ again:
 	else
 		c->verified = true;
 
+	if (c->verified && !test)
+		_cache_cred(c, ctx);
+
 done:
 	munge_ctx_destroy(ctx);
 	return err ? SLURM_ERROR : SLURM_SUCCESS;
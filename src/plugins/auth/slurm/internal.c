@@ -35,6 +35,7 @@
 
 #include <jwt.h>
 #include <inttypes.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -43,9 +44,11 @@
 #include "src/common/slurm_xlator.h"
 
 #include "src/common/assoc_mgr.h"
+#include "src/common/auth_cache.h"
 #include "src/common/log.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/read_config.h"
+#include "src/common/run_in_daemon.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -54,6 +57,58 @@
 static int lifespan = DEFAULT_TTL;
 static buf_t *slurm_key = NULL;
 static char *this_hostname = NULL;
+static auth_cache_t *cred_cache = NULL;
+
+typedef struct {
+	auth_cred_t *cred;
+	uid_t r_uid;
+} cached_cred_t;
+
+typedef struct {
+	auth_cred_t *cred;
+	uid_t decoder_uid;
+} find_cred_args_t;
+
+static void _free_cached_cred(void *x)
+{
+	cached_cred_t *cached = x;
+
+	destroy_cred(cached->cred);
+	xfree(cached);
+}
+
+/* Copy verified fields between a cred and its cached copy */
+static void _copy_verified_cred(auth_cred_t *src, auth_cred_t *dst)
+{
+
+	dst->verified = true;
+	dst->ctime = src->ctime;
+	dst->uid = src->uid;
+	dst->gid = src->gid;
+	dst->hostname = xstrdup(src->hostname);
+	dst->cluster = xstrdup(src->cluster);
+	dst->context = xstrdup(src->context);
+	if (src->data && src->dlen) {
+		dst->data = xmalloc(src->dlen);
+		memcpy(dst->data, src->data, src->dlen);
+		dst->dlen = src->dlen;
+	}
+	dst->id = copy_identity(src->id);
+}
+
+static bool _find_cached_cred(void *x, void *arg)
+{
+	cached_cred_t *cached = x;
+	find_cred_args_t *args = arg;
+
+	/* Same check as decode_jwt() as r_uid is not part of the cache key */
+	if ((cached->r_uid != (uid_t) SLURM_AUTH_UID_ANY) &&
+	    (cached->r_uid != args->decoder_uid))
+		return false;
+
+	_copy_verified_cred(cached->cred, args->cred);
+	return true;
+}
 
 static void _check_key_permissions(const char *path, int bad_perms)
 {
@@ -83,8 +138,13 @@ static void _check_key_permissions(const char *path, int bad_perms)
 
 extern void init_internal(void)
 {
-	char *key_file = xstrdup(getenv("SLURM_SACK_KEY"));
+	char *key_file;
 
+	/* May be called repeatedly through cred_p_create() */
+	if (slurm_key)
+		return;
+
+	key_file = xstrdup(getenv("SLURM_SACK_KEY"));
 	if (!key_file)
 		key_file = get_extra_conf_path("slurm.key");
 
@@ -102,10 +162,17 @@ extern void init_internal(void)
 
 	if (!(lifespan = slurm_get_auth_ttl()))
 		lifespan = DEFAULT_TTL;
+
+	if (running_in_daemon())
+		cred_cache = auth_cache_create(plugin_type,
+					       auth_cache_get_size(),
+					       _free_cached_cred);
 }
 
 extern void fini_internal(void)
 {
+	auth_cache_destroy(cred_cache);
+	cred_cache = NULL;
 	FREE_NULL_BUFFER(slurm_key);
 	xfree(this_hostname);
 	/* save token cache to state */
@@ -211,6 +278,10 @@ fail:
 extern int verify_internal(auth_cred_t *cred, uid_t decoder_uid)
 {
 	jwt_t *jwt = NULL;
+	find_cred_args_t args = {
+		.cred = cred,
+		.decoder_uid = decoder_uid,
+	};
 
 	if (!slurm_key)
 		fatal("slurm_key missing");
@@ -228,6 +299,17 @@ extern int verify_internal(auth_cred_t *cred, uid_t decoder_uid)
 		goto fail;
 	}
 
+	/*
+	 * Token was already verified by this process and has not yet expired.
+	 * auth/slurm tokens carry no nonce so there is no replay state to
+	 * maintain beyond what the cached expiration already enforces.
+	 * A hit with a mismatched r_uid falls through to decode_jwt() to
+	 * reject it.
+	 */
+	if (auth_cache_find(cred_cache, cred->token, strlen(cred->token),
+			    _find_cached_cred, &args))
+		return SLURM_SUCCESS;
+
 	if (!(jwt = decode_jwt(cred->token, true, decoder_uid))) {
 		error("%s: decode_jwt() failed", __func__);
 		goto fail;
@@ -256,6 +338,16 @@ extern int verify_internal(auth_cred_t *cred, uid_t decoder_uid)
 		}
 	}
 
+	if (cred_cache) {
+		cached_cred_t *cached = xmalloc(sizeof(*cached));
+
+		cached->cred = new_cred();
+		cached->r_uid = jwt_get_grant_int(jwt, "ruid");
+		_copy_verified_cred(cred, cached->cred);
+		auth_cache_add(cred_cache, cred->token, strlen(cred->token),
+			       jwt_get_grant_int(jwt, "exp"), cached);
+	}
+
 	jwt_free(jwt);
 
 	return SLURM_SUCCESS;
@@ -86,10 +86,27 @@ static char *ctl_names[] = {
 	[CG_DEVICES] = "devices",
 };
 
+/* Files of a task cgroup read at every accounting poll */
+typedef enum {
+	TASK_STAT_CPU,
+	TASK_STAT_MEM_CURRENT,
+	TASK_STAT_MEM,
+	TASK_STAT_CNT
+} task_stat_t;
+
+static const char *task_stat_files[] = {
+	[TASK_STAT_CPU] = "cpu.stat",
+	[TASK_STAT_MEM_CURRENT] = "memory.current",
+	[TASK_STAT_MEM] = "memory.stat",
+};
+
 typedef struct {
 	xcgroup_t task_cg;
 	uint32_t taskid;
 	bpf_program_t p;
+	int stat_fd[TASK_STAT_CNT];	/* kept open between polls, or -1 */
+	char *stat_buf;			/* pread() buffer for stat files */
+	size_t stat_buf_size;
 } task_cg_info_t;
 
 typedef struct {
@@ -439,10 +456,20 @@ static int _setup_controllers()
 				int_cg_ns.avail_controllers);
 }
 
+static void _close_task_stat_fds(task_cg_info_t *t)
+{
+	for (int i = 0; i < TASK_STAT_CNT; i++) {
+		if (t->stat_fd[i] >= 0)
+			(void) close(t->stat_fd[i]);
+		t->stat_fd[i] = -1;
+	}
+}
+
 static int _rmdir_task(void *x, void *arg)
 {
 	task_cg_info_t *t = (task_cg_info_t *) x;
 
+	_close_task_stat_fds(t);
 	if (common_cgroup_delete(&t->task_cg) != SLURM_SUCCESS)
 		log_flag(CGROUP, "Failed to delete %s: %m", t->task_cg.path);
 
@@ -463,6 +490,7 @@ static int _find_task_cg_info(void *x, void *key)
 static int _find_purge_task_special(task_cg_info_t *task_ptr, uint32_t *id)
 {
 	if (task_ptr->taskid == *id) {
+		_close_task_stat_fds(task_ptr);
 		if (common_cgroup_delete(&task_ptr->task_cg) != SLURM_SUCCESS)
 			log_flag(CGROUP, "Failed to cleanup %s: %m",
 				 task_ptr->task_cg.path);
@@ -477,8 +505,10 @@ static void _free_task_cg_info(void *x)
 	task_cg_info_t *task_cg = (task_cg_info_t *)x;
 
 	if (task_cg) {
+		_close_task_stat_fds(task_cg);
 		common_cgroup_destroy(&task_cg->task_cg);
 		free_ebpf_prog(&task_cg->p);
+		xfree(task_cg->stat_buf);
 		xfree(task_cg);
 	}
 }
@@ -1947,6 +1977,8 @@ extern int cgroup_p_task_addto(cgroup_ctl_type_t ctl, stepd_step_rec_t *step,
 					     &task_id))) {
 		task_cg_info = xmalloc(sizeof(*task_cg_info));
 		task_cg_info->taskid = task_id;
+		for (int i = 0; i < TASK_STAT_CNT; i++)
+			task_cg_info->stat_fd[i] = -1;
 		need_to_add = true;
 	}
 
@@ -2011,11 +2043,83 @@ extern int cgroup_p_task_addto(cgroup_ctl_type_t ctl, stepd_step_rec_t *step,
 	return SLURM_SUCCESS;
 }
 
+/*
+ * Read a stat file of a task cgroup into t->stat_buf. The file is kept open,
+ * pread() at offset 0 makes the kernel generate its content again.
+ * RET NUL terminated content of the file or NULL on error
+ */
+static char *_read_task_stat(task_cg_info_t *t, task_stat_t stat)
+{
+	char *path;
+	ssize_t n;
+
+	if (t->stat_fd[stat] < 0) {
+		path = xstrdup_printf("%s/%s", t->task_cg.path,
+				      task_stat_files[stat]);
+		t->stat_fd[stat] = open(path, O_RDONLY | O_CLOEXEC);
+		if (t->stat_fd[stat] < 0) {
+			log_flag(CGROUP, "Cannot open %s: %m", path);
+			xfree(path);
+			return NULL;
+		}
+		xfree(path);
+	}
+
+	if (!t->stat_buf) {
+		t->stat_buf_size = 4096;
+		t->stat_buf = xmalloc(t->stat_buf_size);
+	}
+
+	while ((n = pread(t->stat_fd[stat], t->stat_buf,
+			  t->stat_buf_size - 1, 0)) ==
+	       (t->stat_buf_size - 1)) {
+		/* The file may not fit, read it again into a larger buffer */
+		t->stat_buf_size *= 2;
+		xrealloc(t->stat_buf, t->stat_buf_size);
+	}
+	if (n < 0) {
+		log_flag(CGROUP, "Cannot read %s/%s: %m",
+			 t->task_cg.path, task_stat_files[stat]);
+		(void) close(t->stat_fd[stat]);
+		t->stat_fd[stat] = -1;
+		return NULL;
+	}
+	t->stat_buf[n] = '\0';
+
+	return t->stat_buf;
+}
+
+/*
+ * Get the values of keys from the content of a flat keyed file, made of
+ * "key value" lines, in a single pass. Values of keys not found are left
+ * untouched.
+ */
+static void _parse_keyed_stat(char *buf, const char **keys, uint64_t **vals,
+			      int cnt)
+{
+	char *line = buf;
+	int found = 0;
+	size_t len;
+
+	while (line && (found < cnt)) {
+		for (int i = 0; i < cnt; i++) {
+			len = strlen(keys[i]);
+			if (strncmp(line, keys[i], len) || (line[len] != ' '))
+				continue;
+			if (sscanf(line + len, " %"PRIu64, vals[i]) != 1)
+				log_flag(CGROUP, "Cannot parse %s field",
+					 keys[i]);
+			found++;
+			break;
+		}
+		if ((line = strchr(line, '\n')))
+			line++;
+	}
+}
+
 extern cgroup_acct_t *cgroup_p_task_get_acct_data(uint32_t task_id)
 {
-	char *cpu_stat = NULL, *memory_stat = NULL, *memory_current = NULL;
-	char *ptr;
-	size_t tmp_sz = 0;
+	char *buf;
 	cgroup_acct_t *stats = NULL;
 	task_cg_info_t *task_cg_info;
 
@@ -2030,39 +2134,6 @@ extern cgroup_acct_t *cgroup_p_task_get_acct_data(uint32_t task_id)
 		return NULL;
 	}
 
-	if (common_cgroup_get_param(&task_cg_info->task_cg,
-				    "cpu.stat",
-				    &cpu_stat,
-				    &tmp_sz) != SLURM_SUCCESS) {
-		if (task_id == task_special_id)
-			log_flag(CGROUP, "Cannot read task_special cpu.stat file");
-		else
-			log_flag(CGROUP, "Cannot read task %d cpu.stat file",
-				 task_id);
-	}
-
-	if (common_cgroup_get_param(&task_cg_info->task_cg,
-				    "memory.current",
-				    &memory_current,
-				    &tmp_sz) != SLURM_SUCCESS) {
-		if (task_id == task_special_id)
-			log_flag(CGROUP, "Cannot read task_special memory.current file");
-		else
-			log_flag(CGROUP, "Cannot read task %d memory.current file",
-				 task_id);
-	}
-
-	if (common_cgroup_get_param(&task_cg_info->task_cg,
-				    "memory.stat",
-				    &memory_stat,
-				    &tmp_sz) != SLURM_SUCCESS) {
-		if (task_id == task_special_id)
-			log_flag(CGROUP, "Cannot read task_special memory.stat file");
-		else
-			log_flag(CGROUP, "Cannot read task %d memory.stat file",
-				 task_id);
-	}
-
 	/*
 	 * Initialize values. A NO_VAL64 will indicate the caller that something
 	 * happened here. Values that aren't set here are returned as 0.
@@ -2073,17 +2144,11 @@ extern cgroup_acct_t *cgroup_p_task_get_acct_data(uint32_t task_id)
 	stats->total_rss = NO_VAL64;
 	stats->total_pgmajfault = NO_VAL64;
 
-	if (cpu_stat) {
-		ptr = xstrstr(cpu_stat, "user_usec");
-		if (ptr &&
-		    (sscanf(ptr, "user_usec %"PRIu64, &stats->usec) != 1))
-			error("Cannot parse user_sec field in cpu.stat file");
+	if ((buf = _read_task_stat(task_cg_info, TASK_STAT_CPU))) {
+		const char *keys[] = { "user_usec", "system_usec" };
+		uint64_t *vals[] = { &stats->usec, &stats->ssec };
 
-		ptr = xstrstr(cpu_stat, "system_usec");
-		if (ptr &&
-		    (sscanf(ptr, "system_usec %"PRIu64, &stats->ssec) != 1))
-			error("Cannot parse system_usec field in cpu.stat file");
-		xfree(cpu_stat);
+		_parse_keyed_stat(buf, keys, vals, ARRAY_SIZE(keys));
 	}
 
 	/*
@@ -2094,18 +2159,15 @@ extern cgroup_acct_t *cgroup_p_task_get_acct_data(uint32_t task_id)
 	 * memory the app has touched. Using this value makes it consistent with
 	 * the OOM killer limit.
 	 */
-	if (memory_current) {
-		if (sscanf(memory_current, "%"PRIu64, &stats->total_rss) != 1)
-			error("Cannot parse memory.current file");
-		xfree(memory_current);
-	}
-
-	if (memory_stat) {
-		ptr = xstrstr(memory_stat, "pgmajfault");
-		if (ptr && (sscanf(ptr, "pgmajfault %"PRIu64,
-				   &stats->total_pgmajfault) != 1))
-			log_flag(CGROUP, "Cannot parse pgmajfault field in memory.stat file");
-		xfree(memory_stat);
+	if ((buf = _read_task_stat(task_cg_info, TASK_STAT_MEM_CURRENT)) &&
+	    (sscanf(buf, "%"PRIu64, &stats->total_rss) != 1))
+		error("Cannot parse memory.current file");
+
+	if ((buf = _read_task_stat(task_cg_info, TASK_STAT_MEM))) {
+		const char *keys[] = { "pgmajfault" };
+		uint64_t *vals[] = { &stats->total_pgmajfault };
+
+		_parse_keyed_stat(buf, keys, vals, ARRAY_SIZE(keys));
 	}
 
 	return stats;
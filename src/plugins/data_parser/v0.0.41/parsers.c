@@ -6772,6 +6772,9 @@ static const parser_t PARSER_ARRAY(STATS_MSG)[] = {
 	add_parse(UINT32, agent_count, "agent_count", NULL),
 	add_parse(UINT32, agent_thread_count, "agent_thread_count", NULL),
 	add_parse(UINT32, dbd_agent_queue_size, "dbd_agent_queue_size", NULL),
+	add_parse(UINT32, dbd_agent_batch_cnt, "dbd_agent_batch_count", NULL),
+	add_parse(UINT32, dbd_agent_latency_max, "dbd_agent_latency_max", NULL),
+	add_parse(UINT64, dbd_agent_latency_sum, "dbd_agent_latency_sum", NULL),
 	add_parse(UINT32, gettimeofday_latency, "gettimeofday_latency", NULL),
 	add_parse(UINT32, schedule_cycle_max, "schedule_cycle_max", NULL),
 	add_parse(UINT32, schedule_cycle_last, "schedule_cycle_last", NULL),
@@ -52,6 +52,7 @@
 #include "src/interfaces/acct_gather_energy.h"
 #include "src/interfaces/acct_gather_filesystem.h"
 #include "src/interfaces/acct_gather_interconnect.h"
+#include "src/common/xhash.h"
 #include "src/common/xstring.h"
 #include "src/interfaces/proctrack.h"
 
@@ -70,9 +71,30 @@ char **assoc_mgr_tres_name_array;
 #endif
 
 
+/*
+ * Processes of the step with more than this many pids tracked get their
+ * /proc files reopened every poll instead of kept open, to bound our fds
+ */
+#define JAG_MAX_OPEN_PIDS 1024
+
+/* /proc files of a process of the step, kept open between polls */
+typedef struct {
+	pid_t pid;
+	int stat_fd;		/* /proc/<pid>/stat, -1 if not open */
+	int io_fd;		/* /proc/<pid>/io, -1 if not open */
+	int lwp;		/* _is_a_lwp() of the process behind stat_fd */
+	bool keep_open;		/* keep the fds open until the next poll */
+	uint32_t poll;		/* last poll that found pid in the container */
+	jag_prec_t *prec;	/* record of pid in prec_list, NULL if unknown */
+} jag_pid_t;
+
 static int cpunfo_frequency = 0;
 static long conv_units = 0;
 List prec_list = NULL;
+static xhash_t *pid_table = NULL;
+static uint32_t poll_cnt = 0;
+static jag_prec_t **prec_index = NULL;	/* prec_list sorted by ppid */
+static int prec_index_cnt = 0;
 
 static int my_pagesize = 0;
 static int energy_profile = ENERGY_DATA_NODE_ENERGY_UP;
@@ -301,7 +323,7 @@ again:
 
 /* _get_process_data_line() - get line of data from /proc/<pid>/stat
  *
- * IN:	in - input file descriptor
+ * IN:	in - input file descriptor, read from its start
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -323,7 +345,7 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
 	long unsigned f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13;
 	int exit_signal, last_cpu;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
+	num_read = pread(in, sbuf, (sizeof(sbuf) - 1), 0);
 	if (num_read <= 0)
 		return 0;
 	sbuf[num_read] = '\0';
@@ -359,14 +381,6 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
 	if ((nvals < 37) || (rss < 0))
 		return 0;
 
-	/*
-	 * If current pid corresponds to a Light Weight Process (Thread POSIX)
-	 * or there was an error, skip it, we will only account the original
-	 * process (pid==tgid).
-	 */
-	if (_is_a_lwp(prec->pid))
-		return 0;
-
 	/* Copy the values that slurm records into our data structure */
 	prec->ppid  = ppid;
 
@@ -445,7 +459,7 @@ static int _remove_share_data(char *proc_statm_file, jag_prec_t *prec)
 
 /* _get_process_io_data_line() - get line of data from /proc/<pid>/io
  *
- * IN:	in - input file descriptor
+ * IN:	in - input file descriptor, read from its start
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -462,7 +476,7 @@ static int _get_process_io_data_line(int in, jag_prec_t *prec) {
 	int num_read, nvals;
 	uint64_t rchar, wchar;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
+	num_read = pread(in, sbuf, (sizeof(sbuf) - 1), 0);
 	if (num_read <= 0)
 		return 0;
 	sbuf[num_read] = '\0';
@@ -472,9 +486,6 @@ static int _get_process_io_data_line(int in, jag_prec_t *prec) {
 	if (nvals < 4)
 		return 0;
 
-	if (_is_a_lwp(prec->pid))
-		return 0;
-
 	/* keep real value here since we aren't doubles */
 	prec->tres_data[TRES_ARRAY_FS_DISK].size_read = rchar;
 	prec->tres_data[TRES_ARRAY_FS_DISK].size_write = wchar;
@@ -517,15 +528,81 @@ void _set_smaps_file(char **proc_smaps_file, pid_t pid)
 		xstrfmtcat(*proc_smaps_file, "/proc/%d/smaps", pid);
 }
 
+static void _pid_id(void *item, const char **key, uint32_t *key_len)
+{
+	jag_pid_t *ent = item;
+
+	*key = (const char *) &ent->pid;
+	*key_len = sizeof(ent->pid);
+}
+
+static void _pid_close(jag_pid_t *ent)
+{
+	if (ent->stat_fd >= 0)
+		close(ent->stat_fd);
+	if (ent->io_fd >= 0)
+		close(ent->io_fd);
+	ent->stat_fd = -1;
+	ent->io_fd = -1;
+}
+
+static void _pid_free(void *x)
+{
+	jag_pid_t *ent = x;
+
+	_pid_close(ent);
+	xfree(ent);
+}
+
+/*
+ * (Re)open /proc/<pid>/stat and find out whether pid is a thread. The fd is
+ * opened with O_CLOEXEC so user tasks forked and exec'ed meanwhile do not
+ * inherit it. Once the process ends reads of the fd fail, even if the pid is
+ * reused, so a failed read means this has to be called again.
+ */
+static int _pid_open(jag_pid_t *ent)
+{
+	char proc_file[64];
+
+	_pid_close(ent);
+
+	snprintf(proc_file, sizeof(proc_file), "/proc/%d/stat", ent->pid);
+	if ((ent->stat_fd = open(proc_file, O_RDONLY | O_CLOEXEC)) < 0)
+		return SLURM_ERROR;  /* Assume the process went away */
+
+	if ((ent->lwp = _is_a_lwp(ent->pid)) < 0) {
+		_pid_close(ent);
+		return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+static void _find_gone_pids(void *x, void *arg)
+{
+	jag_pid_t *ent = x;
+
+	if (ent->poll != poll_cnt)
+		list_append(arg, ent);
+}
+
+static int _purge_gone_pid(void *x, void *arg)
+{
+	jag_pid_t *ent = x;
+
+	/* The record stays in prec_list, usage of ended processes counts */
+	xhash_delete(pid_table, (const char *) &ent->pid, sizeof(ent->pid));
+
+	return SLURM_SUCCESS;
+}
+
 static void _handle_stats(pid_t pid, jag_callbacks_t *callbacks, int tres_count)
 {
 	static int no_share_data = -1;
 	static int use_pss = -1;
 	static int disable_gpu_acct = -1;
 	char *proc_file = NULL;
-	FILE *stat_fp = NULL;
-	FILE *io_fp = NULL;
-	int fd, fd2;
+	jag_pid_t *ent;
 	jag_prec_t *prec = NULL;
 
 	if (no_share_data == -1) {
@@ -549,22 +626,26 @@ static void _handle_stats(pid_t pid, jag_callbacks_t *callbacks, int tres_count)
 			disable_gpu_acct = 0;
 	}
 
-	xstrfmtcat(proc_file, "/proc/%u/stat", pid);
-	if (!(stat_fp = fopen(proc_file, "r")))
-		return;  /* Assume the process went away */
+	if (!(ent = xhash_get(pid_table, (const char *) &pid, sizeof(pid)))) {
+		ent = xmalloc(sizeof(*ent));
+		ent->pid = pid;
+		ent->stat_fd = -1;
+		ent->io_fd = -1;
+		ent->keep_open =
+			(xhash_count(pid_table) < JAG_MAX_OPEN_PIDS);
+		xhash_add(pid_table, ent);
+	}
+	ent->poll = poll_cnt;
+
+	if ((ent->stat_fd < 0) && _pid_open(ent))
+		return;
+
 	/*
-	 * Close the file on exec() of user tasks.
-	 *
-	 * NOTE: If we fork() slurmstepd after the
-	 * fopen() above and before the fcntl() below,
-	 * then the user task may have this extra file
-	 * open, which can cause problems for
-	 * checkpoint/restart, but this should be a very rare
-	 * problem in practice.
+	 * If current pid corresponds to a Light Weight Process (Thread POSIX)
+	 * skip it, we will only account the original process (pid==tgid).
 	 */
-	fd = fileno(stat_fp);
-	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
-		error("%s: fcntl(%s): %m", __func__, proc_file);
+	if (ent->lwp)
+		goto finished;
 
 	prec = xmalloc(sizeof(*prec));
 
@@ -583,13 +664,13 @@ static void _handle_stats(pid_t pid, jag_callbacks_t *callbacks, int tres_count)
 
 	(void)_init_tres(prec, NULL);
 
-	if (!_get_process_data_line(fd, prec)) {
-		fclose(stat_fp);
-		goto bail_out;
+	if (!_get_process_data_line(ent->stat_fd, prec)) {
+		/* The process we had open ended, the pid may be in use again */
+		if (_pid_open(ent) || ent->lwp ||
+		    !_get_process_data_line(ent->stat_fd, prec))
+			goto bail_out;
 	}
 
-	fclose(stat_fp);
-
 	if (!disable_gpu_acct)
 		gpu_g_usage_read(pid, prec->tres_data);
 
@@ -610,26 +691,35 @@ static void _handle_stats(pid_t pid, jag_callbacks_t *callbacks, int tres_count)
 	}
 
 	xfree(proc_file);
-	xstrfmtcat(proc_file, "/proc/%u/io", pid);
-	if ((io_fp = fopen(proc_file, "r"))) {
-		fd2 = fileno(io_fp);
-		if (fcntl(fd2, F_SETFD, FD_CLOEXEC) == -1)
-			error("%s: fcntl: %m", __func__);
-		if (!_get_process_io_data_line(fd2, prec)) {
-			fclose(io_fp);
-			goto bail_out;
-		}
-		fclose(io_fp);
+	if (ent->io_fd < 0) {
+		xstrfmtcat(proc_file, "/proc/%u/io", pid);
+		ent->io_fd = open(proc_file, O_RDONLY | O_CLOEXEC);
+		xfree(proc_file);
 	}
+	if ((ent->io_fd >= 0) &&
+	    !_get_process_io_data_line(ent->io_fd, prec))
+		goto bail_out;
 
-	destroy_jag_prec(list_remove_first(prec_list, _find_prec, &prec->pid));
-	list_append(prec_list, prec);
-	xfree(proc_file);
-	return;
+	if (ent->prec) {
+		/* Update the record of pid in place */
+		xfree(ent->prec->tres_data);
+		memcpy(ent->prec, prec, sizeof(*prec));
+		xfree(prec);
+	} else {
+		destroy_jag_prec(list_remove_first(prec_list, _find_prec,
+						   &prec->pid));
+		list_append(prec_list, prec);
+		ent->prec = prec;
+	}
+	goto finished;
 
 bail_out:
+	xfree(proc_file);
 	xfree(prec->tres_data);
 	xfree(prec);
+finished:
+	if (!ent->keep_open)
+		_pid_close(ent);
 	return;
 }
 
@@ -639,10 +729,12 @@ static List _get_precs(List task_list, uint64_t cont_id,
 	int npids = 0;
 	struct jobacctinfo *jobacct = NULL;
 	pid_t *pids = NULL;
+	List gone_list;
 
 	xassert(task_list);
 
 	jobacct = list_peek(task_list);
+	poll_cnt++;
 
 	/* get only the processes in the proctrack container */
 	proctrack_g_get_pids(cont_id, &pids, &npids);
@@ -668,6 +760,12 @@ static List _get_precs(List task_list, uint64_t cont_id,
 		log_flag(JAG, "no pids in this container %"PRIu64, cont_id);
 	}
 
+	/* Close the files of processes no longer in the container */
+	gone_list = list_create(NULL);
+	xhash_walk(pid_table, _find_gone_pids, gone_list);
+	(void) list_for_each(gone_list, _purge_gone_pid, NULL);
+	FREE_NULL_LIST(gone_list);
+
 	return prec_list;
 }
 
@@ -810,6 +908,7 @@ extern void jag_common_init(long plugin_units)
 	uint32_t profile_opt;
 
 	prec_list = list_create(destroy_jag_prec);
+	pid_table = xhash_init(_pid_id, _pid_free);
 
 	acct_gather_profile_g_get(ACCT_GATHER_PROFILE_RUNNING,
 				  &profile_opt);
@@ -830,7 +929,10 @@ extern void jag_common_init(long plugin_units)
 
 extern void jag_common_fini(void)
 {
+	xhash_free(pid_table);
 	FREE_NULL_LIST(prec_list);
+	xfree(prec_index);
+	prec_index_cnt = 0;
 }
 
 extern void destroy_jag_prec(void *object)
@@ -883,14 +985,46 @@ static int _list_find_prec_by_pid(void *x, void *key)
         return 0;
 }
 
-static int _list_find_prec_by_ppid(void *x, void *key)
+static int _cmp_prec_ppid(const void *x, const void *y)
 {
-        jag_prec_t *j = (jag_prec_t *) x;
-        pid_t pid = *(pid_t *) key;
+	pid_t ppid_x = (*(jag_prec_t **) x)->ppid;
+	pid_t ppid_y = (*(jag_prec_t **) y)->ppid;
 
-        if (!j->visited && (j->ppid == pid))
-                return 1;
-        return 0;
+	return (ppid_x > ppid_y) - (ppid_x < ppid_y);
+}
+
+static int _add_prec_index(void *x, void *arg)
+{
+	prec_index[prec_index_cnt++] = x;
+
+	return SLURM_SUCCESS;
+}
+
+/* Sort prec_list by ppid into prec_index[] for _get_offspring_data() */
+static void _index_precs(void)
+{
+	prec_index_cnt = 0;
+	xrecalloc(prec_index, MAX(list_count(prec_list), 1),
+		  sizeof(*prec_index));
+	(void) list_for_each(prec_list, _add_prec_index, NULL);
+	qsort(prec_index, prec_index_cnt, sizeof(*prec_index), _cmp_prec_ppid);
+}
+
+/* Return index of the first prec in prec_index[] whose parent is ppid */
+static int _first_child(pid_t ppid)
+{
+	int lo = 0, hi = prec_index_cnt;
+
+	while (lo < hi) {
+		int mid = lo + ((hi - lo) / 2);
+
+		if (prec_index[mid]->ppid < ppid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
 }
 
 static int _reset_visited(jag_prec_t *prec, void *empty)
@@ -991,9 +1125,12 @@ static void _get_offspring_data(List prec_list, jag_prec_t *ancestor, pid_t pid)
 	list_append(tmp_list, prec);
 
 	while ((prec_tmp = list_dequeue(tmp_list))) {
-		while ((prec = list_find_first(prec_list,
-					      _list_find_prec_by_ppid,
-					       &(prec_tmp->pid)))) {
+		for (int i = _first_child(prec_tmp->pid);
+		     (i < prec_index_cnt) &&
+		     (prec_index[i]->ppid == prec_tmp->pid); i++) {
+			prec = prec_index[i];
+			if (prec->visited)
+				continue;
 			_aggregate_prec(prec, ancestor);
 			list_append(tmp_list, prec);
 		}
@@ -1041,6 +1178,7 @@ extern void jag_common_poll_data(List task_list, uint64_t cont_id,
 
 	(void)list_for_each(prec_list, (ListForF)_init_tres, NULL);
 	(*(callbacks->get_precs))(task_list, cont_id, callbacks);
+	_index_precs();
 
 	if (!list_count(prec_list) || !task_list || !list_count(task_list))
 		goto finished;	/* We have no business being here! */
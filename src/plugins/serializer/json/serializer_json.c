@@ -35,11 +35,7 @@
 
 #include "config.h"
 
-#if HAVE_JSON_C_INC
-#include <json-c/json.h>
-#else
-#include <json/json.h>
-#endif
+#include <math.h>
 
 #include "slurm/slurm.h"
 #include "src/common/slurm_xlator.h"
@@ -48,6 +44,7 @@
 #include "src/common/log.h"
 #include "src/common/read_config.h"
 #include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 #include "src/interfaces/serializer.h"
 
@@ -85,7 +82,33 @@ const char *mime_types[] = {
 	NULL
 };
 
-static json_object *_data_to_json(const data_t *d);
+#define WRITER_START_SIZE 4096
+#define JSON_MAX_DEPTH 64
+
+typedef struct {
+	char *buf;
+	size_t len; /* bytes written excluding \0 */
+	size_t size; /* bytes allocated */
+	bool pretty;
+} json_writer_t;
+
+typedef struct {
+	json_writer_t *w;
+	int level;
+	size_t count;
+} json_writer_args_t;
+
+typedef struct {
+	const char *src; /* start of JSON source */
+	const char *pos; /* current parsing position */
+	const char *end; /* end of JSON source */
+	json_writer_t scratch; /* buffer for decoding strings */
+	int rc;
+} json_parser_t;
+
+static void _write_data(json_writer_t *w, const data_t *d, int level);
+static void _write(json_writer_t *w, const char *str, size_t len);
+static bool _parse_value(json_parser_t *p, data_t *d, int depth);
 
 extern int serializer_p_init(void)
 {
@@ -102,129 +125,639 @@ extern int serializer_p_fini(void)
 }
 
 
-static json_object *_try_parse(const char *src, size_t stringlen,
-			       struct json_tokener *tok)
+static bool _parse_fail(json_parser_t *p, int rc, const char *why)
 {
-	json_object *jobj = json_tokener_parse_ex(tok, src, stringlen);
+	error("%s: JSON parsing error at byte %zu of %zu: %s",
+	      __func__, (size_t) (p->pos - p->src),
+	      (size_t) (p->end - p->src), why);
+	p->rc = rc;
+	return false;
+}
 
-	if (jobj == NULL) {
-		enum json_tokener_error jerr = json_tokener_get_error(tok);
-		error("%s: JSON parsing error %zu bytes: %s",
-		      __func__, stringlen, json_tokener_error_desc(jerr));
-		return NULL;
+/* Skip whitespace and C/C++ style comments like json-c does */
+static void _skip_whitespace(json_parser_t *p)
+{
+	while (p->pos < p->end) {
+		const char *close;
+
+		switch (*p->pos) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+			p->pos++;
+			continue;
+		case '/':
+			if (((p->pos + 1) < p->end) && (p->pos[1] == '/')) {
+				if (!(close = memchr(p->pos, '\n',
+						     (p->end - p->pos))))
+					close = p->end - 1;
+				p->pos = close + 1;
+				continue;
+			}
+			if (((p->pos + 1) < p->end) && (p->pos[1] == '*')) {
+				for (close = p->pos + 2; close < p->end;
+				     close++) {
+					if ((close[0] == '*') &&
+					    ((close + 1) < p->end) &&
+					    (close[1] == '/'))
+						break;
+				}
+				if (close >= p->end)
+					return;
+				p->pos = close + 2;
+				continue;
+			}
+			return;
+		default:
+			return;
+		}
 	}
-	if (tok->char_offset < stringlen)
-		log_flag(DATA, "%s: Extra %zu characters after JSON string detected",
-		     __func__, (stringlen - tok->char_offset));
+}
+
+/* Match literal case insensitively (as json-c does when not strict) */
+static bool _match_literal(json_parser_t *p, const char *literal)
+{
+	const size_t len = strlen(literal);
 
-	return jobj;
+	if ((p->end - p->pos) < len)
+		return false;
+	if (xstrncasecmp(p->pos, literal, len))
+		return false;
+
+	p->pos += len;
+	return true;
 }
 
-static data_t *_json_to_data(json_object *jobj, data_t *d)
+static void _write_utf8(json_writer_t *w, uint32_t cp)
 {
-	size_t arraylen = 0;
+	char utf8[4];
+	size_t len;
+
+	if (cp < 0x80) {
+		utf8[0] = cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		utf8[0] = 0xc0 | (cp >> 6);
+		utf8[1] = 0x80 | (cp & 0x3f);
+		len = 2;
+	} else if (cp < 0x10000) {
+		utf8[0] = 0xe0 | (cp >> 12);
+		utf8[1] = 0x80 | ((cp >> 6) & 0x3f);
+		utf8[2] = 0x80 | (cp & 0x3f);
+		len = 3;
+	} else {
+		utf8[0] = 0xf0 | (cp >> 18);
+		utf8[1] = 0x80 | ((cp >> 12) & 0x3f);
+		utf8[2] = 0x80 | ((cp >> 6) & 0x3f);
+		utf8[3] = 0x80 | (cp & 0x3f);
+		len = 4;
+	}
 
-	if (!d)
-		d = data_new();
+	_write(w, utf8, len);
+}
 
-	switch (json_object_get_type(jobj)) {
-	case json_type_null:
-		data_set_null(d);
-		break;
-	case json_type_boolean:
-		data_set_bool(d, json_object_get_boolean(jobj));
+/* Parse 4 hex digits of \u escape */
+static bool _parse_hex4(json_parser_t *p, uint32_t *cp)
+{
+	*cp = 0;
+
+	if ((p->end - p->pos) < 4)
+		return false;
+
+	for (int i = 0; i < 4; i++, p->pos++) {
+		const char c = *p->pos;
+
+		*cp <<= 4;
+		if ((c >= '0') && (c <= '9'))
+			*cp |= c - '0';
+		else if ((c >= 'a') && (c <= 'f'))
+			*cp |= c - 'a' + 10;
+		else if ((c >= 'A') && (c <= 'F'))
+			*cp |= c - 'A' + 10;
+		else
+			return false;
+	}
+
+	return true;
+}
+
+static bool _parse_escape(json_parser_t *p)
+{
+	uint32_t cp, low;
+	char c;
+
+	if (p->pos >= p->end)
+		return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+				   "unterminated escape");
+
+	switch ((c = *(p->pos++))) {
+	case '"':
+	case '\'':
+	case '\\':
+	case '/':
 		break;
-	case json_type_double:
-		data_set_float(d, json_object_get_double(jobj));
+	case 'b':
+		c = '\b';
 		break;
-	case json_type_int:
-		data_set_int(d, json_object_get_int64(jobj));
+	case 'f':
+		c = '\f';
 		break;
-	case json_type_object:
-		data_set_dict(d);
-		/* warning: json_object_object_foreach is an evil macro */
-		json_object_object_foreach(jobj, key, val) {
-			_json_to_data(val, data_key_set(d, key));
-		}
+	case 'n':
+		c = '\n';
 		break;
-	case json_type_array:
-		arraylen = json_object_array_length(jobj);
-		data_set_list(d);
-		for (size_t i = 0; i < arraylen; i++)
-			_json_to_data(json_object_array_get_idx(jobj, i),
-				      data_list_append(d));
+	case 'r':
+		c = '\r';
 		break;
-	case json_type_string:
-		data_set_string(d, json_object_get_string(jobj));
+	case 't':
+		c = '\t';
 		break;
+	case 'u':
+		if (!_parse_hex4(p, &cp))
+			return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+					   "invalid unicode escape");
+
+		if ((cp >= 0xd800) && (cp <= 0xdbff)) {
+			/* high surrogate must be followed by low surrogate */
+			if (((p->end - p->pos) >= 6) && (p->pos[0] == '\\') &&
+			    (p->pos[1] == 'u')) {
+				const char *at = p->pos;
+
+				p->pos += 2;
+				if (_parse_hex4(p, &low) && (low >= 0xdc00) &&
+				    (low <= 0xdfff)) {
+					cp = 0x10000 + ((cp - 0xd800) << 10) +
+					     (low - 0xdc00);
+				} else {
+					p->pos = at;
+					cp = 0xfffd;
+				}
+			} else {
+				cp = 0xfffd;
+			}
+		} else if ((cp >= 0xdc00) && (cp <= 0xdfff)) {
+			cp = 0xfffd;
+		}
+
+		_write_utf8(&p->scratch, cp);
+		return true;
 	default:
-		fatal_abort("%s: unknown JSON type", __func__);
-	};
+		return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+				   "invalid escape");
+	}
+
+	_write(&p->scratch, &c, 1);
+	return true;
+}
+
+/*
+ * Parse quoted string into p->scratch.
+ * Unescaped runs are located with memchr() and copied in one go, which lets
+ * libc use vectorized scanning for the common case of long plain strings.
+ */
+static bool _parse_string(json_parser_t *p)
+{
+	const char quote = *(p->pos++);
+
+	p->scratch.len = 0;
+
+	while (true) {
+		const char *close = memchr(p->pos, quote, (p->end - p->pos));
+		const char *esc;
+
+		if (!close)
+			return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+					   "unterminated string");
+
+		if (!(esc = memchr(p->pos, '\\', (close - p->pos)))) {
+			_write(&p->scratch, p->pos, (close - p->pos));
+			p->pos = close + 1;
+			break;
+		}
+
+		_write(&p->scratch, p->pos, (esc - p->pos));
+		p->pos = esc + 1;
+
+		if (!_parse_escape(p))
+			return false;
+	}
+
+	p->scratch.buf[p->scratch.len] = '\0';
+	return true;
+}
+
+static bool _parse_number(json_parser_t *p, data_t *d)
+{
+	const char *start = p->pos;
+	bool is_float = false;
+	char buf[64], *num, *end = NULL;
+
+	if ((p->pos < p->end) && (*p->pos == '-'))
+		p->pos++;
+
+	if (_match_literal(p, "Infinity")) {
+		data_set_float(d, ((*start == '-') ? -INFINITY : INFINITY));
+		return true;
+	}
+
+	for (; p->pos < p->end; p->pos++) {
+		const char c = *p->pos;
+
+		if ((c >= '0') && (c <= '9'))
+			continue;
+		if ((c == '.') || (c == 'e') || (c == 'E') ||
+		    (((c == '-') || (c == '+')) &&
+		     ((p->pos[-1] == 'e') || (p->pos[-1] == 'E'))))
+			is_float = true;
+		else
+			break;
+	}
+
+	/* source is not required to be terminated so copy out number */
+	if ((p->pos - start) < sizeof(buf)) {
+		memcpy(buf, start, (p->pos - start));
+		buf[p->pos - start] = '\0';
+		num = buf;
+	} else {
+		num = xstrndup(start, (p->pos - start));
+	}
+
+	errno = 0;
+	if (!is_float) {
+		int64_t value = strtoll(num, &end, 10);
+
+		if (errno == ERANGE) {
+			/* too large for int64_t: fall back to a double */
+			is_float = true;
+		} else if (!*end && (end != num)) {
+			data_set_int(d, value);
+		}
+	}
+
+	if (is_float) {
+		double value;
+
+		errno = 0;
+		value = strtod(num, &end);
+
+		if (!*end && (end != num))
+			data_set_float(d, value);
+	}
+
+	if (num != buf)
+		xfree(num);
+
+	if (!end || *end || (end == num))
+		return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+				   "invalid number");
+
+	return true;
+}
+
+static bool _parse_dict(json_parser_t *p, data_t *d, int depth)
+{
+	data_set_dict(d);
+	p->pos++;
+
+	while (true) {
+		data_t *child;
+
+		_skip_whitespace(p);
+
+		if (p->pos >= p->end)
+			return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+					   "unterminated object");
+
+		/* json-c allows trailing comma */
+		if (*p->pos == '}') {
+			p->pos++;
+			return true;
+		}
+
+		if ((*p->pos != '"') && (*p->pos != '\''))
+			return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+					   "expected object key");
+		if (!_parse_string(p))
+			return false;
+
+		if (!p->scratch.len)
+			return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+					   "empty object key");
+
+		/* last value wins for duplicate keys */
+		child = data_key_set(d, p->scratch.buf);
+
+		_skip_whitespace(p);
+		if ((p->pos >= p->end) || (*p->pos != ':'))
+			return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+					   "expected ':' after object key");
+		p->pos++;
+
+		if (!_parse_value(p, child, (depth + 1)))
+			return false;
+
+		_skip_whitespace(p);
+		if (p->pos >= p->end)
+			return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+					   "unterminated object");
+		if (*p->pos == ',') {
+			p->pos++;
+			continue;
+		}
+		if (*p->pos == '}') {
+			p->pos++;
+			return true;
+		}
+
+		return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+				   "expected ',' or '}' in object");
+	}
+}
+
+static bool _parse_list(json_parser_t *p, data_t *d, int depth)
+{
+	data_set_list(d);
+	p->pos++;
+
+	while (true) {
+		_skip_whitespace(p);
+
+		if (p->pos >= p->end)
+			return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+					   "unterminated array");
+
+		/* json-c allows trailing comma */
+		if (*p->pos == ']') {
+			p->pos++;
+			return true;
+		}
+
+		if (!_parse_value(p, data_list_append(d), (depth + 1)))
+			return false;
+
+		_skip_whitespace(p);
+		if (p->pos >= p->end)
+			return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+					   "unterminated array");
+		if (*p->pos == ',') {
+			p->pos++;
+			continue;
+		}
+		if (*p->pos == ']') {
+			p->pos++;
+			return true;
+		}
+
+		return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+				   "expected ',' or ']' in array");
+	}
+}
+
+/* Parse JSON value directly into data_t */
+static bool _parse_value(json_parser_t *p, data_t *d, int depth)
+{
+	if (depth > JSON_MAX_DEPTH)
+		return _parse_fail(p, ESLURM_DATA_PARSING_DEPTH,
+				   "nested too deep");
+
+	_skip_whitespace(p);
+
+	if (p->pos >= p->end)
+		return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+				   "expected value");
+
+	switch (*p->pos) {
+	case '{':
+		return _parse_dict(p, d, depth);
+	case '[':
+		return _parse_list(p, d, depth);
+	case '"':
+	case '\'':
+		if (!_parse_string(p))
+			return false;
+		data_set_string(d, p->scratch.buf);
+		return true;
+	case '-':
+	case '0':
+	case '1':
+	case '2':
+	case '3':
+	case '4':
+	case '5':
+	case '6':
+	case '7':
+	case '8':
+	case '9':
+		return _parse_number(p, d);
+	}
+
+	if (_match_literal(p, "null")) {
+		data_set_null(d);
+	} else if (_match_literal(p, "true")) {
+		data_set_bool(d, true);
+	} else if (_match_literal(p, "false")) {
+		data_set_bool(d, false);
+	} else if (_match_literal(p, "NaN")) {
+		data_set_float(d, NAN);
+	} else if (_match_literal(p, "Infinity")) {
+		data_set_float(d, INFINITY);
+	} else {
+		return _parse_fail(p, ESLURM_REST_FAIL_PARSING,
+				   "unexpected character");
+	}
+
+	return true;
+}
+
+static void _write(json_writer_t *w, const char *str, size_t len)
+{
+	if ((w->len + len + 1) > w->size) {
+		w->size = MAX((w->size * 2), (w->len + len + 1));
+		xrealloc_nz(w->buf, w->size);
+	}
+
+	memcpy((w->buf + w->len), str, len);
+	w->len += len;
+}
+
+#define _write_str(w, str) _write(w, str, strlen(str))
+
+static void _write_indent(json_writer_t *w, int level)
+{
+	static const char spaces[] = "                                ";
+
+	if (!w->pretty)
+		return;
+
+	for (int i = (level * 2); i > 0; i -= (sizeof(spaces) - 1))
+		_write(w, spaces, MIN(i, (sizeof(spaces) - 1)));
+}
+
+/* Escape string in the same way as json_escape_str() in json-c */
+static void _write_string(json_writer_t *w, const char *str)
+{
+	const char *run = str;
+
+	_write(w, "\"", 1);
+
+	for (const char *c = str; *c; c++) {
+		const char *esc = NULL;
+		char hex[7];
+
+		switch (*c) {
+		case '\b':
+			esc = "\\b";
+			break;
+		case '\n':
+			esc = "\\n";
+			break;
+		case '\r':
+			esc = "\\r";
+			break;
+		case '\t':
+			esc = "\\t";
+			break;
+		case '\f':
+			esc = "\\f";
+			break;
+		case '"':
+			esc = "\\\"";
+			break;
+		case '\\':
+			esc = "\\\\";
+			break;
+		case '/':
+			esc = "\\/";
+			break;
+		default:
+			if ((unsigned char) *c < ' ') {
+				snprintf(hex, sizeof(hex), "\\u%04x",
+					 (unsigned char) *c);
+				esc = hex;
+			}
+		}
+
+		if (!esc)
+			continue;
+
+		if (c > run)
+			_write(w, run, (c - run));
+		_write_str(w, esc);
+		run = c + 1;
+	}
+
+	_write_str(w, run);
+	_write(w, "\"", 1);
+}
 
-	return d;
+/* Format double in the same way as json-c */
+static void _write_float(json_writer_t *w, double value)
+{
+	char buf[64];
+
+	if (isnan(value)) {
+		_write_str(w, "NaN");
+	} else if (isinf(value)) {
+		_write_str(w, ((value > 0) ? "Infinity" : "-Infinity"));
+	} else {
+		snprintf(buf, sizeof(buf), "%.17g", value);
+		_write_str(w, buf);
+
+		/* Ensure it still looks like a float */
+		if (!strpbrk(buf, ".eE"))
+			_write_str(w, ".0");
+	}
 }
 
-static data_for_each_cmd_t _convert_dict_json(const char *key,
-					      const data_t *data,
-					      void *arg)
+/* Start next entry of a dictionary or list */
+static void _write_entry(json_writer_t *w, int level, size_t *count)
 {
-	json_object *jobj = arg;
-	json_object *jobject = _data_to_json(data);
+	if ((*count)++)
+		_write(w, ",", 1);
+	if (w->pretty)
+		_write(w, "\n", 1);
+	_write_indent(w, level);
+}
+
+static data_for_each_cmd_t _write_dict_entry(const char *key,
+					     const data_t *data, void *arg)
+{
+	json_writer_args_t *args = arg;
+
+	_write_entry(args->w, (args->level + 1), &args->count);
+	_write_string(args->w, key);
+	if (args->w->pretty)
+		_write(args->w, ": ", 2);
+	else
+		_write(args->w, ":", 1);
+	_write_data(args->w, data, (args->level + 1));
 
-	json_object_object_add(jobj, key, jobject);
 	return DATA_FOR_EACH_CONT;
 }
 
-static data_for_each_cmd_t _convert_list_json(const data_t *data, void *arg)
+static data_for_each_cmd_t _write_list_entry(const data_t *data, void *arg)
 {
-	json_object *jobj = arg;
-	json_object *jarray = _data_to_json(data);
+	json_writer_args_t *args = arg;
+
+	_write_entry(args->w, (args->level + 1), &args->count);
+	_write_data(args->w, data, (args->level + 1));
 
-	json_object_array_add(jobj, jarray);
 	return DATA_FOR_EACH_CONT;
 }
 
-static json_object *_data_to_json(const data_t *d)
+/*
+ * Write data as JSON text directly into writer buffer.
+ * Output is formatted the same as json-c formatted it.
+ */
+static void _write_data(json_writer_t *w, const data_t *d, int level)
 {
-	if (!d)
-		return NULL;
+	json_writer_args_t args = {
+		.w = w,
+		.level = level,
+	};
+	char buf[32];
 
 	switch (data_get_type(d)) {
+	case DATA_TYPE_NONE:
 	case DATA_TYPE_NULL:
-		return NULL;
+		_write_str(w, "null");
 		break;
 	case DATA_TYPE_BOOL:
-		return json_object_new_boolean(data_get_bool(d));
+		_write_str(w, (data_get_bool(d) ? "true" : "false"));
 		break;
 	case DATA_TYPE_FLOAT:
-		return json_object_new_double(data_get_float(d));
+		_write_float(w, data_get_float(d));
 		break;
 	case DATA_TYPE_INT_64:
-		return json_object_new_int64(data_get_int(d));
+		snprintf(buf, sizeof(buf), "%"PRId64, data_get_int(d));
+		_write_str(w, buf);
 		break;
 	case DATA_TYPE_DICT:
-	{
-		json_object *jobj = json_object_new_object();
-		if (data_dict_for_each_const(d, _convert_dict_json, jobj) < 0)
-			error("%s: unexpected error calling _convert_dict_json()",
+		_write(w, "{", 1);
+		if (data_dict_for_each_const(d, _write_dict_entry, &args) < 0)
+			error("%s: unexpected error calling _write_dict_entry()",
 			      __func__);
-		return jobj;
-	}
+		if (w->pretty && args.count) {
+			_write(w, "\n", 1);
+			_write_indent(w, level);
+		}
+		_write(w, "}", 1);
+		break;
 	case DATA_TYPE_LIST:
-	{
-		json_object *jobj = json_object_new_array();
-		if (data_list_for_each_const(d, _convert_list_json, jobj) < 0)
-			error("%s: unexpected error calling _convert_list_json()",
+		_write(w, "[", 1);
+		if (data_list_for_each_const(d, _write_list_entry, &args) < 0)
+			error("%s: unexpected error calling _write_list_entry()",
 			      __func__);
-		return jobj;
-	}
+		if (w->pretty && args.count) {
+			_write(w, "\n", 1);
+			_write_indent(w, level);
+		}
+		_write(w, "]", 1);
+		break;
 	case DATA_TYPE_STRING:
 	{
 		const char *str = data_get_string_const(d);
-		if (str)
-			return json_object_new_string(str);
-		else
-			return json_object_new_string("");
+		_write_string(w, (str ? str : ""));
 		break;
 	}
 	default:
@@ -236,66 +769,60 @@ extern int serialize_p_data_to_string(char **dest, size_t *length,
 				      const data_t *src,
 				      serializer_flags_t flags)
 {
-	struct json_object *jobj = _data_to_json(src);
-	int jflags = 0;
+	json_writer_t w = {
+		.pretty = (flags == SER_FLAGS_PRETTY),
+	};
 
 	/* can't be pretty and compact at the same time! */
 	xassert((flags & (SER_FLAGS_PRETTY | SER_FLAGS_COMPACT)) !=
 		(SER_FLAGS_PRETTY | SER_FLAGS_COMPACT));
 
-	switch (flags) {
-	case SER_FLAGS_PRETTY:
-		jflags = JSON_C_TO_STRING_SPACED | JSON_C_TO_STRING_PRETTY;
-		break;
-	case SER_FLAGS_COMPACT: /* fallthrough */
-	default:
-		jflags = JSON_C_TO_STRING_PLAIN;
-	}
+	w.size = WRITER_START_SIZE;
+	w.buf = xmalloc_nz(w.size);
 
-	/* string will die with jobj */
-	*dest = xstrdup(json_object_to_json_string_ext(jobj, jflags));
+	_write_data(&w, src, 0);
+	w.buf[w.len] = '\0';
+
+	*dest = w.buf;
 	if (length) {
 		/* add 1 for \0 */
-		*length = strlen(*dest) + 1;
+		*length = w.len + 1;
 	}
 
-	/* put is equiv to free() */
-	json_object_put(jobj);
-
 	return SLURM_SUCCESS;
 }
 
 extern int serialize_p_string_to_data(data_t **dest, const char *src,
 				      size_t length)
 {
-	json_object *jobj = NULL;
-	data_t *data = NULL;
-	struct json_tokener *tok = json_tokener_new();
-	int rc;
-
-	if (!tok)
-		return ENOMEM;
+	json_parser_t p = {
+		.src = src,
+		.pos = src,
+		.rc = SLURM_SUCCESS,
+	};
+	data_t *data;
 
 	if (!src)
 		return ESLURM_DATA_PTR_NULL;
 
-	/* json-c has hard limit of 32 bits */
-	if (length >= INT32_MAX) {
-		error("%s: unable to parse JSON: too large",
-		      __func__);
-		return ESLURM_DATA_TOO_LARGE;
-	}
+	/* stop at first \0 as json-c did */
+	if (!(p.end = memchr(src, '\0', length)))
+		p.end = src + length;
+
+	data = data_new();
 
-	jobj = _try_parse(src, length, tok);
-	if (jobj) {
-		data = _json_to_data(jobj, NULL);
-		json_object_put(jobj);
-		rc = SLURM_SUCCESS;
-	} else
-		rc = ESLURM_REST_FAIL_PARSING;
+	if (_parse_value(&p, data, 0)) {
+		_skip_whitespace(&p);
+
+		if (p.pos < p.end)
+			log_flag(DATA, "%s: Extra %zu characters after JSON string detected",
+				 __func__, (size_t) (p.end - p.pos));
+	} else {
+		FREE_NULL_DATA(data);
+	}
 
-	json_tokener_free(tok);
+	xfree(p.scratch.buf);
 
 	*dest = data;
-	return rc;
+	return p.rc;
 }
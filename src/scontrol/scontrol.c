@@ -289,6 +289,10 @@ int main(int argc, char **argv)
 		/* We are running interactively multiple commands */
 		int input_field_count = 0;
 		char **input_fields = xcalloc(MAX_INPUT_FIELDS, sizeof(char *));
+
+		/* Avoid a new connection to slurmctld for every command */
+		slurm_persist_controller_conn_init();
+
 		while (error_code == SLURM_SUCCESS) {
 			error_code = _get_command(
 				&input_field_count, input_fields);
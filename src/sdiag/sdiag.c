@@ -125,7 +125,15 @@ static int _print_stats(void)
 	printf("Agent queue size:     %d\n", buf->agent_queue_size);
 	printf("Agent count:          %d\n", buf->agent_count);
 	printf("Agent thread count:   %d\n", buf->agent_thread_count);
-	printf("DBD Agent queue size: %d\n\n", buf->dbd_agent_queue_size);
+	printf("DBD Agent queue size: %d\n", buf->dbd_agent_queue_size);
+	printf("DBD Agent batches:    %u\n", buf->dbd_agent_batch_cnt);
+	if (buf->dbd_agent_batch_cnt) {
+		printf("DBD Agent mean latency: %"PRIu64" us\n",
+		       buf->dbd_agent_latency_sum / buf->dbd_agent_batch_cnt);
+		printf("DBD Agent max latency:  %u us\n",
+		       buf->dbd_agent_latency_max);
+	}
+	printf("\n");
 
 	printf("Jobs submitted: %d\n", buf->jobs_submitted);
 	printf("Jobs started:   %d\n", buf->jobs_started);
@@ -41,6 +41,7 @@
 #include "slurm/slurmdb.h"
 #include "src/common/xstring.h"
 #include "src/common/macros.h"
+#include "src/common/slurm_protocol_api.h"
 #include "src/interfaces/select.h"
 #include "src/common/slurm_time.h"
 #include "src/sinfo/sinfo.h"
@@ -123,6 +124,10 @@ int main(int argc, char **argv)
 		log_alter(opts, SYSLOG_FACILITY_USER, NULL);
 	}
 
+	/* Avoid a new connection to slurmctld on every iteration */
+	if (params.iterate)
+		slurm_persist_controller_conn_init();
+
 	while (1) {
 		if (!params.no_header && !params.mimetype &&
 		    (params.iterate || params.verbose || params.long_output))
@@ -51,15 +51,18 @@
  *  be possible to execute the agent as an pthread, process, or even a daemon
  *  on some other computer.
  *
- *  The main agent thread creates a separate thread for each node to be
- *  communicated with up to AGENT_THREAD_COUNT. A special watchdog thread
- *  sends SIGLARM to any threads that have been active (in DSH_ACTIVE state)
- *  for more than MessageTimeout seconds.
+ *  Starting an agent issues all of its RPCs to agent_io without waiting for
+ *  them. agent_io multiplexes the connections of every agent on a single
+ *  polling thread, each with its own timeout, and processes the responses
+ *  on a pool of AGENT_THREAD_COUNT workers. No thread is dedicated to any
+ *  agent or node, so the number of agents in progress is only bounded by
+ *  MAX_AGENT_CNT rather than by MAX_SERVER_THREADS.
  *  The agent responds to slurmctld via a function call or an RPC as required.
  *  For example, informing slurmctld that some node is not responding.
  *
- *  All the state for each thread is maintained in thd_t struct, which is
- *  used by the watchdog thread as well as the communication threads.
+ *  All the state for each RPC is maintained in thd_t struct, which is
+ *  updated as the RPC completes. The last RPC to complete runs the agent's
+ *  final processing.
 \*****************************************************************************/
 
 #include "config.h"
@@ -89,7 +92,6 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_interface.h"
 #include "src/common/uid.h"
-#include "src/common/xsignal.h"
 #include "src/common/xassert.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
@@ -97,6 +99,7 @@
 #include "src/interfaces/select.h"
 
 #include "src/slurmctld/agent.h"
+#include "src/slurmctld/agent_io.h"
 #include "src/slurmctld/front_end.h"
 #include "src/slurmctld/job_scheduler.h"
 #include "src/slurmctld/locks.h"
@@ -125,17 +128,14 @@ typedef enum {
 } state_t;
 
 typedef struct {
-	bool work_done; 	/* assume all threads complete */
 	int fail_cnt;		/* assume no threads failures */
 	int no_resp_cnt;	/* assume all threads respond */
 	int retry_cnt;		/* assume no required retries */
 	int max_delay;
-	time_t now;
 } thd_complete_t;
 
 typedef struct {
-	pthread_t thread;		/* thread ID */
-	state_t state;			/* thread state */
+	state_t state;			/* RPC state */
 	time_t start_time;		/* start time */
 	time_t end_time;		/* end time or delta time
 					 * upon termination */
@@ -159,14 +159,14 @@ typedef struct {
 	void **msg_args_pptr;		/* RPC data to be used */
 	uint16_t msg_flags;		/* Flags to be added to msg*/
 	uint16_t protocol_version;	/* if set, use this version */
+	agent_arg_t *agent_arg_ptr;	/* request being processed */
+	time_t begin_time;		/* time agent started */
+	bool wait;			/* agent() waiting for completion */
+	bool done;			/* all RPCs completed */
 } agent_info_t;
 
 typedef struct {
-	pthread_mutex_t *thread_mutex_ptr; /* pointer to agent specific
-					    * mutex */
-	pthread_cond_t *thread_cond_ptr;/* pointer to agent specific
-					 * condition */
-	uint32_t *threads_active_ptr;	/* currently active thread ptr */
+	agent_info_t *agent_info_ptr;	/* agent this RPC belongs to */
 	thd_t *thread_struct_ptr;	/* thread structures ptr */
 	bool get_reply;			/* flag if reply expected */
 	uid_t r_uid;			/* receiver UID */
@@ -190,7 +190,9 @@ typedef struct {
 } mail_info_t;
 
 static void _agent_defer(void);
+static void _agent_done(agent_info_t *agent_ptr);
 static void _agent_retry(int min_wait, bool wait_too);
+static agent_info_t *_agent_start(agent_arg_t *agent_arg_ptr, bool wait);
 static int  _batch_launch_defer(queued_request_t *queued_req_ptr);
 static void _reboot_from_ctld(agent_arg_t *agent_arg_ptr);
 static int  _signal_defer(queued_request_t *queued_req_ptr);
@@ -205,12 +207,14 @@ static void _purge_agent_args(agent_arg_t *agent_arg_ptr);
 static void _queue_agent_retry(agent_info_t * agent_info_ptr, int count);
 static void _queue_update_node(char *node_name);
 static void _queue_update_srun(slurm_step_id_t *step_id);
+static void _rpc_complete(task_info_t *task_ptr, List ret_list,
+			  state_t thread_state);
+static void _rpc_reply(list_t *ret_list, void *args);
+static void _rpc_sent(list_t *ret_list, void *args);
 static int  _setup_requeue(agent_arg_t *agent_arg_ptr, thd_t *thread_ptr,
 			   int *count, int *spot);
-static void _sig_handler(int dummy);
-static void *_thread_per_group_rpc(void *args);
+static void _start_rpc(agent_info_t *agent_info_ptr, int inx);
 static int   _valid_agent_arg(agent_arg_t *agent_arg_ptr);
-static void *_wdog(void *args);
 
 static mail_info_t *_mail_alloc(void);
 static void  _mail_free(void *arg);
@@ -239,7 +243,6 @@ static pthread_cond_t  agent_cnt_cond  = PTHREAD_COND_INITIALIZER;
 static int agent_cnt = 0;
 static int agent_thread_cnt = 0;
 static int mail_thread_cnt = 0;
-static uint16_t message_timeout = NO_VAL16;
 
 static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  pending_cond = PTHREAD_COND_INITIALIZER;
@@ -266,20 +269,11 @@ static time_t cache_build_time = 0;
  * IN pointer to agent_arg_t, which is xfree'd (including hostlist,
  *	and msg_args) upon completion
  * RET always NULL (function format just for use as pthread)
+ * NOTE: Blocks until every RPC completes, agent_queue_request() does not.
  */
 void *agent(void *args)
 {
-	int i, delay;
-	pthread_t thread_wdog = 0;
-	agent_arg_t *agent_arg_ptr = args;
-	agent_info_t *agent_info_ptr = NULL;
-	thd_t *thread_ptr;
-	task_info_t *task_specific_ptr;
-	time_t begin_time;
-	bool spawn_retry_agent = false;
-	int rpc_thread_cnt;
-	static time_t sched_update = 0;
-	static bool reboot_from_ctld = false;
+	agent_info_t *agent_info_ptr;
 
 #if HAVE_SYS_PRCTL_H
 	if (prctl(PR_SET_NAME, "agent", NULL, NULL, NULL) < 0) {
@@ -287,6 +281,90 @@ void *agent(void *args)
 	}
 #endif
 
+	if (!(agent_info_ptr = _agent_start(args, true)))
+		return NULL;
+
+	slurm_mutex_lock(&agent_info_ptr->thread_mutex);
+	while (!agent_info_ptr->done)
+		slurm_cond_wait(&agent_info_ptr->thread_cond,
+				&agent_info_ptr->thread_mutex);
+	slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
+
+	slurm_mutex_destroy(&agent_info_ptr->thread_mutex);
+	slurm_cond_destroy(&agent_info_ptr->thread_cond);
+	xfree(agent_info_ptr->thread_struct);
+	xfree(agent_info_ptr);
+
+	return NULL;
+}
+
+/*
+ * Purge the agent's request and release its slot. If agent_info_ptr is set,
+ * it is freed unless agent() is waiting on it.
+ */
+static void _agent_cleanup(agent_info_t *agent_info_ptr,
+			   agent_arg_t *agent_arg_ptr)
+{
+	_purge_agent_args(agent_arg_ptr);
+
+	slurm_mutex_lock(&agent_cnt_mutex);
+	if (agent_cnt > 0) {
+		agent_cnt--;
+	} else {
+		error("agent_cnt underflow");
+		agent_cnt = 0;
+	}
+	slurm_cond_broadcast(&agent_cnt_cond);
+	slurm_mutex_unlock(&agent_cnt_mutex);
+
+	if (agent_info_ptr) {
+		slurm_mutex_lock(&agent_info_ptr->thread_mutex);
+		if (agent_info_ptr->wait) {
+			agent_info_ptr->done = true;
+			slurm_cond_broadcast(&agent_info_ptr->thread_cond);
+			slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
+		} else {
+			slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
+			slurm_mutex_destroy(&agent_info_ptr->thread_mutex);
+			slurm_cond_destroy(&agent_info_ptr->thread_cond);
+			xfree(agent_info_ptr->thread_struct);
+			xfree(agent_info_ptr);
+		}
+	}
+
+	agent_trigger(RPC_RETRY_INTERVAL, true, false);
+}
+
+/*
+ * Note completion of one of the agent's RPCs (or of starting them all), and
+ * run the agent's final processing once nothing is left outstanding.
+ */
+static void _agent_rpc_complete(agent_info_t *agent_info_ptr)
+{
+	bool finished;
+
+	slurm_mutex_lock(&agent_info_ptr->thread_mutex);
+	finished = !--agent_info_ptr->threads_active;
+	slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
+
+	if (finished)
+		_agent_done(agent_info_ptr);
+}
+
+/*
+ * Start issuing an agent's RPCs.
+ * IN agent_arg_ptr - request, xfree'd upon completion
+ * IN wait - caller will wait for completion, otherwise return as soon as the
+ *	RPCs are issued
+ * RET agent record to wait on, or NULL if the agent is already complete
+ */
+static agent_info_t *_agent_start(agent_arg_t *agent_arg_ptr, bool wait)
+{
+	agent_info_t *agent_info_ptr = NULL;
+	bool reboot;
+	static time_t sched_update = 0;
+	static bool reboot_from_ctld = false;
+
 	log_flag(AGENT, "%s: Agent_cnt=%d agent_thread_cnt=%d with msg_type=%s retry_list_size=%d",
 		 __func__, agent_cnt, agent_thread_cnt,
 		 rpc_num2string(agent_arg_ptr->msg_type),
@@ -301,128 +379,66 @@ void *agent(void *args)
 			reboot_from_ctld = true;
 		sched_update = slurm_conf.last_update;
 	}
+	reboot = (reboot_from_ctld &&
+		  (agent_arg_ptr->msg_type == REQUEST_REBOOT_NODES));
+
+	if (reboot && !wait) {
+		/* RebootProgram can run for a while, do not hold the caller */
+		slurm_mutex_unlock(&agent_cnt_mutex);
+		slurm_thread_create_detached(agent, agent_arg_ptr);
+		return NULL;
+	}
 
-	rpc_thread_cnt = 2 + MIN(agent_arg_ptr->node_count, AGENT_THREAD_COUNT);
 	while (1) {
 		if (slurmctld_config.shutdown_time ||
-		    ((agent_thread_cnt+rpc_thread_cnt) <= MAX_SERVER_THREADS)) {
+		    (agent_cnt < MAX_AGENT_CNT)) {
 			agent_cnt++;
-			agent_thread_cnt += rpc_thread_cnt;
 			break;
 		} else {	/* wait for state change and retry */
 			slurm_cond_wait(&agent_cnt_cond, &agent_cnt_mutex);
 		}
 	}
 	slurm_mutex_unlock(&agent_cnt_mutex);
-	if (slurmctld_config.shutdown_time)
-		goto cleanup;
 
 	/* basic argument value tests */
-	begin_time = time(NULL);
-	if (_valid_agent_arg(agent_arg_ptr))
-		goto cleanup;
+	if (slurmctld_config.shutdown_time ||
+	    _valid_agent_arg(agent_arg_ptr)) {
+		_agent_cleanup(NULL, agent_arg_ptr);
+		return NULL;
+	}
 
-	if (reboot_from_ctld &&
-	    (agent_arg_ptr->msg_type == REQUEST_REBOOT_NODES)) {
+	if (reboot) {
 		_reboot_from_ctld(agent_arg_ptr);
-		goto cleanup;
+		_agent_cleanup(NULL, agent_arg_ptr);
+		return NULL;
 	}
 
 	/* initialize the agent data structures */
 	agent_info_ptr = _make_agent_info(agent_arg_ptr);
-	thread_ptr = agent_info_ptr->thread_struct;
+	agent_info_ptr->agent_arg_ptr = agent_arg_ptr;
+	agent_info_ptr->begin_time = time(NULL);
+	agent_info_ptr->wait = wait;
 
-	/* start the watchdog thread */
-	slurm_thread_create(&thread_wdog, _wdog, agent_info_ptr);
-
-	log_flag(AGENT, "%s: New agent thread_count:%d threads_active:%d retry:%c get_reply:%c r_uid:%u msg_type:%s protocol_version:%hu",
+	log_flag(AGENT, "%s: New agent thread_count:%d retry:%c get_reply:%c r_uid:%u msg_type:%s protocol_version:%hu",
 		 __func__, agent_info_ptr->thread_count,
-		 agent_info_ptr->threads_active,
 		 agent_info_ptr->retry ? 'T' : 'F',
 		 agent_info_ptr->get_reply ? 'T' : 'F',
 		 agent_info_ptr->r_uid,
 		 rpc_num2string(agent_arg_ptr->msg_type),
 		 agent_info_ptr->protocol_version);
 
-	/* start all the other threads (up to AGENT_THREAD_COUNT active) */
-	for (i = 0; i < agent_info_ptr->thread_count; i++) {
-		/* wait until "room" for another thread */
-		slurm_mutex_lock(&agent_info_ptr->thread_mutex);
-		while (agent_info_ptr->threads_active >=
-		       AGENT_THREAD_COUNT) {
-			slurm_cond_wait(&agent_info_ptr->thread_cond,
-					&agent_info_ptr->thread_mutex);
-		}
-
-		/*
-		 * create thread specific data,
-		 * NOTE: freed from _thread_per_group_rpc()
-		 */
-		task_specific_ptr = _make_task_data(agent_info_ptr, i);
-
-		slurm_thread_create(&thread_ptr[i].thread,
-				    _thread_per_group_rpc,
-				    task_specific_ptr);
-		agent_info_ptr->threads_active++;
-		slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
-	}
-
-	/* Wait for termination of remaining threads */
-	slurm_thread_join(thread_wdog);
-	delay = (int) difftime(time(NULL), begin_time);
-	if (delay > (slurm_conf.msg_timeout * 2)) {
-		info("agent msg_type=%s ran for %d seconds",
-		     rpc_num2string(agent_arg_ptr->msg_type),  delay);
-	}
-	slurm_mutex_lock(&agent_info_ptr->thread_mutex);
-	while (agent_info_ptr->threads_active != 0) {
-		slurm_cond_wait(&agent_info_ptr->thread_cond,
-				&agent_info_ptr->thread_mutex);
-	}
-	for (i = 0; i < agent_info_ptr->thread_count; i++)
-		slurm_thread_join(thread_ptr[i].thread);
-	slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
-
-	log_flag(AGENT, "%s: end agent thread_count:%d threads_active:%d retry:%c get_reply:%c msg_type:%s protocol_version:%hu",
-		 __func__, agent_info_ptr->thread_count,
-		 agent_info_ptr->threads_active,
-		 agent_info_ptr->retry ? 'T' : 'F',
-		 agent_info_ptr->get_reply ? 'T' : 'F',
-		 rpc_num2string(agent_arg_ptr->msg_type),
-		 agent_info_ptr->protocol_version);
-
-cleanup:
-	_purge_agent_args(agent_arg_ptr);
-
-	if (agent_info_ptr) {
-		xfree(agent_info_ptr->thread_struct);
-		xfree(agent_info_ptr);
-	}
-	slurm_mutex_lock(&agent_cnt_mutex);
-
-	if (agent_cnt > 0) {
-		agent_cnt--;
-	} else {
-		error("agent_cnt underflow");
-		agent_cnt = 0;
-	}
-	if (agent_thread_cnt >= rpc_thread_cnt) {
-		agent_thread_cnt -= rpc_thread_cnt;
-	} else {
-		error("agent_thread_cnt underflow");
-		agent_thread_cnt = 0;
-	}
-
-	if ((agent_thread_cnt + AGENT_THREAD_COUNT + 2) < MAX_SERVER_THREADS)
-		spawn_retry_agent = true;
-
-	slurm_cond_broadcast(&agent_cnt_cond);
-	slurm_mutex_unlock(&agent_cnt_mutex);
+	/*
+	 * Issue all the RPCs at once, holding one extra count so the agent
+	 * can not complete before all have been started.
+	 */
+	agent_info_ptr->threads_active = agent_info_ptr->thread_count + 1;
+	for (int i = 0; i < agent_info_ptr->thread_count; i++)
+		_start_rpc(agent_info_ptr, i);
 
-	if (spawn_retry_agent)
-		agent_trigger(RPC_RETRY_INTERVAL, true, false);
+	/* agent_info_ptr may be freed once released unless waiting */
+	_agent_rpc_complete(agent_info_ptr);
 
-	return NULL;
+	return wait ? agent_info_ptr : NULL;
 }
 
 /* Basic validity test of agent argument */
@@ -562,9 +578,7 @@ static task_info_t *_make_task_data(agent_info_t *agent_info_ptr, int inx)
 	task_info_t *task_info_ptr;
 	task_info_ptr = xmalloc(sizeof(task_info_t));
 
-	task_info_ptr->thread_mutex_ptr  = &agent_info_ptr->thread_mutex;
-	task_info_ptr->thread_cond_ptr   = &agent_info_ptr->thread_cond;
-	task_info_ptr->threads_active_ptr= &agent_info_ptr->threads_active;
+	task_info_ptr->agent_info_ptr    = agent_info_ptr;
 	task_info_ptr->thread_struct_ptr = &agent_info_ptr->thread_struct[inx];
 	task_info_ptr->get_reply         = agent_info_ptr->get_reply;
 	task_info_ptr->r_uid = agent_info_ptr->r_uid;
@@ -576,22 +590,14 @@ static task_info_t *_make_task_data(agent_info_t *agent_info_ptr, int inx)
 	return task_info_ptr;
 }
 
-static void _update_wdog_state(thd_t *thread_ptr,
-			       state_t *state,
+static void _update_comp_state(thd_t *thread_ptr, state_t state,
 			       thd_complete_t *thd_comp)
 {
-	switch (*state) {
+	switch (state) {
 	case DSH_ACTIVE:
-		thd_comp->work_done = false;
-		if (thread_ptr->end_time <= thd_comp->now) {
-			log_flag(AGENT, "%s: agent thread %lu timed out",
-				 __func__, (unsigned long) thread_ptr->thread);
-			(void) pthread_kill(thread_ptr->thread, SIGUSR1);
-			thread_ptr->end_time += message_timeout;
-		}
-		break;
 	case DSH_NEW:
-		thd_comp->work_done = false;
+		error("%s: RPC still in progress at agent completion",
+		      __func__);
 		break;
 	case DSH_DONE:
 		if (thd_comp->max_delay < (int)thread_ptr->end_time)
@@ -609,20 +615,17 @@ static void _update_wdog_state(thd_t *thread_ptr,
 }
 
 /*
- * _wdog - Watchdog thread. Send SIGUSR1 to threads which have been active
- *	for too long.
- * IN args - pointer to agent_info_t with info on threads to watch
- * Sleep between polls with exponential times (from 0.005 to 1.0 second)
+ * _agent_done - Final processing once all of the agent's RPCs completed.
+ *	Notify slurmctld of the results, queue retries and free the agent.
+ * IN agent_ptr - pointer to agent_info_t with info on completed RPCs
  */
-static void *_wdog(void *args)
+static void _agent_done(agent_info_t *agent_ptr)
 {
 	bool srun_agent = false, sack_agent = false;
-	int i;
-	agent_info_t *agent_ptr = (agent_info_t *) args;
+	int i, delay;
 	thd_t *thread_ptr = agent_ptr->thread_struct;
-	unsigned long usec = 5000;
 	list_itr_t *itr;
-	thd_complete_t thd_comp;
+	thd_complete_t thd_comp = { 0 };
 	ret_data_info_t *ret_data_info = NULL;
 
 	if ( (agent_ptr->msg_type == SRUN_JOB_COMPLETE)			||
@@ -639,40 +642,19 @@ static void *_wdog(void *args)
 	if (agent_ptr->msg_type == REQUEST_RECONFIGURE_SACKD)
 		sack_agent = true;
 
-	thd_comp.max_delay = 0;
-
-	while (1) {
-		thd_comp.work_done   = true;/* assume all threads complete */
-		thd_comp.fail_cnt    = 0;   /* assume no threads failures */
-		thd_comp.no_resp_cnt = 0;   /* assume all threads respond */
-		thd_comp.retry_cnt   = 0;   /* assume no required retries */
-		thd_comp.now         = time(NULL);
-
-		usleep(usec);
-		usec = MIN((usec * 2), 1000000);
-
-		slurm_mutex_lock(&agent_ptr->thread_mutex);
-		for (i = 0; i < agent_ptr->thread_count; i++) {
-			//info("thread name %s",thread_ptr[i].node_name);
-			if (!thread_ptr[i].ret_list) {
-				_update_wdog_state(&thread_ptr[i],
-						   &thread_ptr[i].state,
+	for (i = 0; i < agent_ptr->thread_count; i++) {
+		if (!thread_ptr[i].ret_list) {
+			_update_comp_state(&thread_ptr[i], thread_ptr[i].state,
+					   &thd_comp);
+		} else {
+			itr = list_iterator_create(thread_ptr[i].ret_list);
+			while ((ret_data_info = list_next(itr))) {
+				_update_comp_state(&thread_ptr[i],
+						   ret_data_info->err,
 						   &thd_comp);
-			} else {
-				itr = list_iterator_create(
-					thread_ptr[i].ret_list);
-				while ((ret_data_info = list_next(itr))) {
-					_update_wdog_state(&thread_ptr[i],
-							   &ret_data_info->err,
-							   &thd_comp);
-				}
-				list_iterator_destroy(itr);
 			}
+			list_iterator_destroy(itr);
 		}
-		if (thd_comp.work_done)
-			break;
-
-		slurm_mutex_unlock(&agent_ptr->thread_mutex);
 	}
 
 	if (sack_agent) {
@@ -695,8 +677,20 @@ static void *_wdog(void *args)
 		log_flag(AGENT, "%s: agent maximum delay %d seconds",
 			 __func__, thd_comp.max_delay);
 
-	slurm_mutex_unlock(&agent_ptr->thread_mutex);
-	return NULL;
+	delay = (int) difftime(time(NULL), agent_ptr->begin_time);
+	if (delay > (slurm_conf.msg_timeout * 2)) {
+		info("agent msg_type=%s ran for %d seconds",
+		     rpc_num2string(agent_ptr->msg_type),  delay);
+	}
+
+	log_flag(AGENT, "%s: end agent thread_count:%d retry:%c get_reply:%c msg_type:%s protocol_version:%hu",
+		 __func__, agent_ptr->thread_count,
+		 agent_ptr->retry ? 'T' : 'F',
+		 agent_ptr->get_reply ? 'T' : 'F',
+		 rpc_num2string(agent_ptr->msg_type),
+		 agent_ptr->protocol_version);
+
+	_agent_cleanup(agent_ptr, agent_ptr->agent_arg_ptr);
 }
 
 static void _notify_slurmctld_jobs(agent_info_t *agent_ptr)
@@ -915,66 +909,36 @@ static int _wif_status(void)
 	return rc;
 }
 
+static bool _is_srun_agent(slurm_msg_type_t msg_type)
+{
+	return ((msg_type == SRUN_PING)			||
+		(msg_type == SRUN_JOB_COMPLETE)		||
+		(msg_type == SRUN_STEP_MISSING)		||
+		(msg_type == SRUN_STEP_SIGNAL)		||
+		(msg_type == SRUN_TIMEOUT)		||
+		(msg_type == SRUN_USER_MSG)		||
+		(msg_type == RESPONSE_RESOURCE_ALLOCATION) ||
+		(msg_type == SRUN_NODE_FAIL));
+}
+
 /*
- * _thread_per_group_rpc - thread to issue an RPC for a group of nodes
- *                         sending message out to one and forwarding it to
- *                         others if necessary.
- * IN/OUT args - pointer to task_info_t, xfree'd on completion
+ * _start_rpc - issue an RPC for a group of nodes, sending message out to one
+ *	and forwarding it to others if necessary. Completion is handled by
+ *	_rpc_reply() or _rpc_sent().
+ * IN agent_info_ptr - agent issuing the RPC
+ * IN inx - index of thread_struct record describing the RPC
  */
-static void *_thread_per_group_rpc(void *args)
+static void _start_rpc(agent_info_t *agent_info_ptr, int inx)
 {
-	int rc = SLURM_SUCCESS;
 	slurm_msg_t msg;
-	task_info_t *task_ptr = (task_info_t *) args;
-	/* we cache some pointers from task_info_t because we need
-	 * to xfree args before being finished with their use. xfree
-	 * is required for timely termination of this pthread because
-	 * xfree could lock it at the end, preventing a timely
-	 * thread_exit */
-	pthread_mutex_t *thread_mutex_ptr   = task_ptr->thread_mutex_ptr;
-	pthread_cond_t  *thread_cond_ptr    = task_ptr->thread_cond_ptr;
-	uint32_t        *threads_active_ptr = task_ptr->threads_active_ptr;
-	thd_t           *thread_ptr         = task_ptr->thread_struct_ptr;
-	state_t thread_state = DSH_NO_RESP;
+	task_info_t *task_ptr = _make_task_data(agent_info_ptr, inx);
+	thd_t *thread_ptr = task_ptr->thread_struct_ptr;
 	slurm_msg_type_t msg_type = task_ptr->msg_type;
-	bool is_kill_msg, srun_agent, sack_agent;
-	List ret_list = NULL;
-	list_itr_t *itr;
-	ret_data_info_t *ret_data_info = NULL;
-	int sig_array[2] = {SIGUSR1, 0};
-	/* Locks: Write job, write node */
-	slurmctld_lock_t job_write_lock = {
-		NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK, READ_LOCK };
-	/* Lock: Read node */
-	slurmctld_lock_t node_read_lock = {
-		NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
-	/* Lock: Write node */
-	slurmctld_lock_t node_write_lock = {
-		NO_LOCK, NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
-	uint32_t job_id;
-
-	xassert(args != NULL);
-	xsignal(SIGUSR1, _sig_handler);
-	xsignal_unblock(sig_array);
-	is_kill_msg = (	(msg_type == REQUEST_KILL_TIMELIMIT)	||
-			(msg_type == REQUEST_KILL_PREEMPTED)	||
-			(msg_type == REQUEST_TERMINATE_JOB) );
-	srun_agent = (	(msg_type == SRUN_PING)			||
-			(msg_type == SRUN_JOB_COMPLETE)		||
-			(msg_type == SRUN_STEP_MISSING)		||
-			(msg_type == SRUN_STEP_SIGNAL)		||
-			(msg_type == SRUN_TIMEOUT)		||
-			(msg_type == SRUN_USER_MSG)		||
-			(msg_type == RESPONSE_RESOURCE_ALLOCATION) ||
-			(msg_type == SRUN_NODE_FAIL) );
-	sack_agent = (msg_type == REQUEST_RECONFIGURE_SACKD);
 
+	slurm_mutex_lock(&agent_info_ptr->thread_mutex);
 	thread_ptr->start_time = time(NULL);
-
-	slurm_mutex_lock(thread_mutex_ptr);
 	thread_ptr->state = DSH_ACTIVE;
-	thread_ptr->end_time = thread_ptr->start_time + message_timeout;
-	slurm_mutex_unlock(thread_mutex_ptr);
+	slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
 
 	/* send request message */
 	slurm_msg_t_init(&msg);
@@ -1001,67 +965,143 @@ static void *_thread_per_group_rpc(void *args)
 	if (task_ptr->get_reply) {
 		if (thread_ptr->addr) {
 			msg.address = *thread_ptr->addr;
-
-			if (!(ret_list = slurm_send_addr_recv_msgs(
-				     &msg, thread_ptr->nodename, 0))) {
-				error("%s: no ret_list given", __func__);
-				goto cleanup;
-			}
+			agent_io_send_addr(&msg, thread_ptr->nodename, true,
+					   false, _rpc_reply, task_ptr);
 		} else if (thread_ptr->nodelist) {
-			if (!(ret_list = start_msg_tree(thread_ptr->nodelist,
-							&msg, 0))) {
-				error("%s: no ret_list given", __func__);
-				goto cleanup;
-			}
+			agent_io_send_tree(hostlist_copy(thread_ptr->nodelist),
+					   &msg, 0, _rpc_reply, task_ptr);
 		} else {
-			if (!(ret_list = slurm_send_recv_msgs(
-				thread_ptr->nodename, &msg, 0))) {
-				error("%s: no ret_list given", __func__);
-				goto cleanup;
-			}
+			agent_io_send_tree(
+				hostlist_create(thread_ptr->nodename), &msg, 0,
+				_rpc_reply, task_ptr);
 		}
+		return;
+	}
+
+	if (thread_ptr->addr) {
+		msg.address = *thread_ptr->addr;
 	} else {
-		if (thread_ptr->addr) {
-			//info("got the address");
-			msg.address = *thread_ptr->addr;
-		} else {
-			//info("no address given");
-			xassert(thread_ptr->nodename);
-			if (slurm_conf_get_addr(thread_ptr->nodename,
-					        &msg.address, msg.flags)
-			    == SLURM_ERROR) {
-				error("%s: can't find address for host %s, check slurm.conf",
-				      __func__, thread_ptr->nodename);
-				goto cleanup;
-			}
+		xassert(thread_ptr->nodename);
+		if (slurm_conf_get_addr(thread_ptr->nodename, &msg.address,
+					msg.flags) == SLURM_ERROR) {
+			error("%s: can't find address for host %s, check slurm.conf",
+			      __func__, thread_ptr->nodename);
+			_rpc_complete(task_ptr, NULL, DSH_NO_RESP);
+			return;
 		}
-		//info("sending %u to %s", msg_type, thread_ptr->nodename);
-		if (msg_type == SRUN_JOB_COMPLETE) {
-			/*
-			 * The srun runs as a single thread, while the kernel
-			 * listen() may be queuing messages for further
-			 * processing. If we get our SYN in the listen queue
-			 * at the same time the last MESSAGE_TASK_EXIT is being
-			 * processed, srun may exit meaning this message is
-			 * never received, leading to a series of error
-			 * messages from slurm_send_only_node_msg().
-			 * So, we use this different function that blindly
-			 * flings the message out and disregards any
-			 * communication problems that may arise.
-			 */
-			slurm_send_msg_maybe(&msg);
-			thread_state = DSH_DONE;
-		} else if (slurm_send_only_node_msg(&msg) == SLURM_SUCCESS) {
-			thread_state = DSH_DONE;
-		} else {
-			if (!sack_agent && !srun_agent) {
-				lock_slurmctld(node_read_lock);
-				_comm_err(thread_ptr->nodename, msg_type);
-				unlock_slurmctld(node_read_lock);
-			}
+	}
+
+	/*
+	 * The srun runs as a single thread, while the kernel listen() may be
+	 * queuing messages for further processing. If we get our SYN in the
+	 * listen queue at the same time the last MESSAGE_TASK_EXIT is being
+	 * processed, srun may exit meaning this message is never received,
+	 * leading to a series of errors confirming its delivery.
+	 * So, SRUN_JOB_COMPLETE is blindly flung out disregarding any
+	 * communication problems that may arise.
+	 */
+	agent_io_send_addr(&msg, thread_ptr->nodename, false,
+			   (msg_type == SRUN_JOB_COMPLETE), _rpc_sent,
+			   task_ptr);
+}
+
+/*
+ * _rpc_complete - record the outcome of an RPC and complete the agent if it
+ *	was the last one outstanding
+ * IN task_ptr - RPC that completed, xfree'd
+ * IN ret_list - responses, owned by the agent from now on
+ * IN thread_state - overall state of the RPC
+ */
+static void _rpc_complete(task_info_t *task_ptr, List ret_list,
+			  state_t thread_state)
+{
+	agent_info_t *agent_info_ptr = task_ptr->agent_info_ptr;
+	thd_t *thread_ptr = task_ptr->thread_struct_ptr;
+	/* Locks: Write job, write node */
+	slurmctld_lock_t job_write_lock = {
+		NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK, READ_LOCK };
+
+	if (!ret_list && (task_ptr->msg_type == REQUEST_SIGNAL_TASKS)) {
+		job_record_t *job_ptr;
+		signal_tasks_msg_t *msg_ptr =
+			task_ptr->msg_args_ptr;
+		if ((msg_ptr->signal == SIGCONT) ||
+		    (msg_ptr->signal == SIGSTOP)) {
+			lock_slurmctld(job_write_lock);
+			job_ptr = find_job_record(msg_ptr->step_id.job_id);
+			if (job_ptr)
+				job_state_unset_flag(job_ptr, JOB_SIGNALING);
+			unlock_slurmctld(job_write_lock);
 		}
-		goto cleanup;
 	}
+	xfree(task_ptr);
+
+	slurm_mutex_lock(&agent_info_ptr->thread_mutex);
+	thread_ptr->ret_list = ret_list;
+	thread_ptr->state = thread_state;
+	thread_ptr->end_time = (time_t) difftime(time(NULL),
+						 thread_ptr->start_time);
+	slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
+
+	_agent_rpc_complete(agent_info_ptr);
+}
+
+/* _rpc_sent - agent_io callback once a message not needing a reply is sent */
+static void _rpc_sent(list_t *ret_list, void *args)
+{
+	task_info_t *task_ptr = args;
+	thd_t *thread_ptr = task_ptr->thread_struct_ptr;
+	slurm_msg_type_t msg_type = task_ptr->msg_type;
+	ret_data_info_t *ret_data_info = list_peek(ret_list);
+	state_t thread_state = DSH_NO_RESP;
+	/* Lock: Read node */
+	slurmctld_lock_t node_read_lock = {
+		NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
+
+	if ((msg_type == SRUN_JOB_COMPLETE) || !ret_data_info->err) {
+		thread_state = DSH_DONE;
+	} else if (!_is_srun_agent(msg_type) &&
+		   (msg_type != REQUEST_RECONFIGURE_SACKD)) {
+		errno = ret_data_info->err;
+		lock_slurmctld(node_read_lock);
+		_comm_err(thread_ptr->nodename, msg_type);
+		unlock_slurmctld(node_read_lock);
+	}
+	FREE_NULL_LIST(ret_list);
+
+	_rpc_complete(task_ptr, NULL, thread_state);
+}
+
+/*
+ * _rpc_reply - agent_io callback processing the responses from the group of
+ *	nodes an RPC was sent to
+ */
+static void _rpc_reply(list_t *ret_list, void *args)
+{
+	int rc = SLURM_SUCCESS;
+	task_info_t *task_ptr = args;
+	state_t thread_state = DSH_NO_RESP;
+	slurm_msg_type_t msg_type = task_ptr->msg_type;
+	bool is_kill_msg, srun_agent, sack_agent;
+	list_itr_t *itr;
+	ret_data_info_t *ret_data_info = NULL;
+	/* Locks: Write job, write node */
+	slurmctld_lock_t job_write_lock = {
+		NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK, READ_LOCK };
+	/* Lock: Read node */
+	slurmctld_lock_t node_read_lock = {
+		NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
+	/* Lock: Write node */
+	slurmctld_lock_t node_write_lock = {
+		NO_LOCK, NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
+	uint32_t job_id;
+
+	xassert(args != NULL);
+	is_kill_msg = (	(msg_type == REQUEST_KILL_TIMELIMIT)	||
+			(msg_type == REQUEST_KILL_PREEMPTED)	||
+			(msg_type == REQUEST_TERMINATE_JOB) );
+	srun_agent = _is_srun_agent(msg_type);
+	sack_agent = (msg_type == REQUEST_RECONFIGURE_SACKD);
 
 	//info("got %d messages back", list_count(ret_list));
 	itr = list_iterator_create(ret_list);
@@ -1259,42 +1299,7 @@ static void *_thread_per_group_rpc(void *args)
 	}
 	list_iterator_destroy(itr);
 
-cleanup:
-	if (!ret_list && (msg_type == REQUEST_SIGNAL_TASKS)) {
-		job_record_t *job_ptr;
-		signal_tasks_msg_t *msg_ptr =
-			task_ptr->msg_args_ptr;
-		if ((msg_ptr->signal == SIGCONT) ||
-		    (msg_ptr->signal == SIGSTOP)) {
-			job_id = msg_ptr->step_id.job_id;
-			lock_slurmctld(job_write_lock);
-			job_ptr = find_job_record(job_id);
-			if (job_ptr)
-				job_state_unset_flag(job_ptr, JOB_SIGNALING);
-			unlock_slurmctld(job_write_lock);
-		}
-	}
-	xfree(args);
-	/* handled at end of thread just in case resend is needed */
-	destroy_forward(&msg.forward);
-	slurm_mutex_lock(thread_mutex_ptr);
-	thread_ptr->ret_list = ret_list;
-	thread_ptr->state = thread_state;
-	thread_ptr->end_time = (time_t) difftime(time(NULL),
-						 thread_ptr->start_time);
-	/* Signal completion so another thread can replace us */
-	(*threads_active_ptr)--;
-	slurm_cond_signal(thread_cond_ptr);
-	slurm_mutex_unlock(thread_mutex_ptr);
-	return NULL;
-}
-
-/*
- * Signal handler.  We are really interested in interrupting hung communictions
- * and causing them to return EINTR. Multiple interrupts might be required.
- */
-static void _sig_handler(int dummy)
-{
+	_rpc_complete(task_ptr, ret_list, thread_state);
 }
 
 static int _setup_requeue(agent_arg_t *agent_arg_ptr, thd_t *thread_ptr,
@@ -1622,12 +1627,12 @@ extern void agent_fini(void)
 
 	slurm_mutex_lock(&agent_cnt_mutex);
 	slurm_cond_broadcast(&agent_cnt_cond);
-	while (agent_thread_cnt) {
+	while (agent_cnt || agent_thread_cnt) {
                 rc = pthread_cond_timedwait(&agent_cnt_cond, &agent_cnt_mutex,
 					    &ts);
 		if (rc == ETIMEDOUT) {
-			error("%s: left %d agent threads active", __func__,
-			      agent_thread_cnt);
+			error("%s: left %d agents and %d agent threads active",
+			      __func__, agent_cnt, agent_thread_cnt);
 			break;
 		}
 	}
@@ -1845,8 +1850,7 @@ next:
 		}
 	}
 
-	if (get_agent_thread_count() + AGENT_THREAD_COUNT + 2 >
-	    MAX_SERVER_THREADS) {
+	if (get_agent_count() >= MAX_AGENT_CNT) {
 		/* too much work already */
 		slurm_mutex_unlock(&retry_mutex);
 		return;
@@ -1874,9 +1878,9 @@ next:
 		agent_arg_ptr = queued_req_ptr->agent_arg_ptr;
 		xfree(queued_req_ptr);
 		if (agent_arg_ptr) {
-			debug2("Spawning RPC agent for msg_type %s",
+			debug2("Starting RPC agent for msg_type %s",
 			       rpc_num2string(agent_arg_ptr->msg_type));
-			slurm_thread_create_detached(agent, agent_arg_ptr);
+			(void) _agent_start(agent_arg_ptr, false);
 			agent_started++;
 		} else
 			error("agent_retry found record with no agent_args");
@@ -1913,13 +1917,6 @@ void agent_queue_request(agent_arg_t *agent_arg_ptr)
 {
 	queued_request_t *queued_req_ptr = NULL;
 
-	if ((AGENT_THREAD_COUNT + 2) >= MAX_SERVER_THREADS)
-		fatal("AGENT_THREAD_COUNT value is too high relative to MAX_SERVER_THREADS");
-
-	if (message_timeout == NO_VAL16) {
-		message_timeout = MAX(slurm_conf.msg_timeout, 30);
-	}
-
 	if (agent_arg_ptr->msg_type == REQUEST_SHUTDOWN) {
 		pthread_t agent_thread = 0;
 		slurm_thread_create(&agent_thread, agent, agent_arg_ptr);
@@ -1957,6 +1954,8 @@ extern void agent_purge(void)
 {
 	int i;
 
+	agent_io_fini();
+
 	if (retry_list) {
 		slurm_mutex_lock(&retry_mutex);
 		FREE_NULL_LIST(retry_list);
@@ -2005,7 +2004,8 @@ extern int get_agent_thread_count(void)
 	cnt = agent_thread_cnt;
 	slurm_mutex_unlock(&agent_cnt_mutex);
 
-	return cnt;
+	/* RPCs no longer get a thread each, count their connections instead */
+	return cnt + agent_io_get_conn_count();
 }
 
 static void _purge_agent_args(agent_arg_t *agent_arg_ptr)
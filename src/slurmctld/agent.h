@@ -44,7 +44,8 @@
 
 #include "src/slurmctld/slurmctld.h"
 
-#define AGENT_THREAD_COUNT	10	/* maximum active threads per agent */
+#define AGENT_THREAD_COUNT	10	/* threads processing agent responses */
+#define MAX_AGENT_CNT		1024	/* maximum agents in progress */
 
 #define LOTS_OF_AGENTS_CNT 50
 #define LOTS_OF_AGENTS ((get_agent_count() <= LOTS_OF_AGENTS_CNT) ? 0 : 1)
@@ -75,8 +76,9 @@ extern void agent_fini(void);
  *	across a set of nodes. agent_queue_request() if immediate
  *	execution is not essential.
  * IN pointer to agent_arg_t, which is xfree'd (including addr,
- *	hostlist and msg_args) upon completion if AGENT_IS_THREAD is set
+ *	hostlist and msg_args) upon completion
  * RET always NULL (function format just for use as pthread)
+ * NOTE: Blocks until every RPC completes.
  */
 extern void *agent(void *args);
 
@@ -103,7 +105,10 @@ extern void agent_purge(void);
 /* get_agent_count - find out how many active agents we have */
 extern int get_agent_count(void);
 
-/* get_agent_thread_count - get count of threads spawned by agents */
+/*
+ * get_agent_thread_count - get count of threads spawned by agents for MailProg
+ *	plus count of agent RPC connections open or waiting to be opened
+ */
 extern int get_agent_thread_count(void);
 
 /* agent_pack_pending_rpc_stats - pack counts of pending RPCs into a buffer */
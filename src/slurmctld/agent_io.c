@@ -0,0 +1,1081 @@
+/*****************************************************************************\
+ *  agent_io.c - non-blocking communications engine for the RPC agent
+ *****************************************************************************
+ *  Copyright (C) SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+ *****************************************************************************
+ *  Theory of operation:
+ *
+ *  Every request is packed (body and auth credential) once, then split into
+ *  branches exactly like start_msg_tree() does. Each branch head gets its own
+ *  non-blocking connection carrying a per-branch header with the rest of the
+ *  branch to forward to. A single thread polls all connections of all
+ *  requests, driving each through connect, write and read with its own
+ *  deadline. Completed connections are handed to a small workq which unpacks
+ *  the responses, re-issues the undelivered part of a broken branch one node
+ *  at a time, and calls the request's completion callback once every node is
+ *  accounted for.
+\*****************************************************************************/
+
+#include "config.h"
+
+#if HAVE_SYS_PRCTL_H
+#include <sys/prctl.h>
+#endif
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "src/common/fd.h"
+#include "src/common/forward.h"
+#include "src/common/macros.h"
+#include "src/common/pack.h"
+#include "src/common/read_config.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/slurm_protocol_pack.h"
+#include "src/common/slurm_protocol_util.h"
+#include "src/common/workq.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "src/slurmctld/agent.h"
+#include "src/slurmctld/agent_io.h"
+
+#define RETRY_DELAY	1000	/* msec between refused connection attempts */
+
+typedef enum {
+	CONN_CONNECT,		/* non-blocking connect() in progress */
+	CONN_RETRY,		/* waiting to retry a refused connect() */
+	CONN_WRITE,		/* sending request */
+	CONN_READ,		/* receiving response */
+	CONN_DRAIN,		/* waiting for peer to close after sending */
+} conn_state_t;
+
+/* Packed body and auth credential, shared by all connections of a request */
+typedef struct {
+	int refcnt;		/* protected by the request mutex */
+	buf_t *auth;
+	buf_t *body;
+} packed_t;
+
+typedef struct {
+	pthread_mutex_t mutex;
+	slurm_msg_t msg;	/* copy of request, data owned by caller */
+	bool get_reply;
+	bool maybe;
+	bool tree;		/* sent to slurmd nodes, forwarding allowed */
+	int timeout;		/* msec each node has to respond */
+	uint16_t tree_width;
+	packed_t *packed;
+	list_t *ret_list;
+	int conn_cnt;		/* outstanding connections */
+	agent_io_done_t done;
+	void *arg;
+} io_req_t;
+
+typedef struct {
+	io_req_t *req;
+	char *name;		/* node name of branch head */
+	hostlist_t *fwd_hl;	/* nodes the branch head forwards to */
+	int fwd_cnt;
+	slurm_addr_t addr;
+	int fd;
+	conn_state_t state;
+	int64_t start;		/* msec of first connect attempt */
+	int64_t deadline;	/* msec when current state times out */
+	int retries;
+	packed_t *packed;
+	buf_t *header;
+	uint32_t out_size;	/* network order size of request */
+	size_t out_off;
+	size_t out_len;
+	uint32_t in_size;	/* size of response */
+	size_t in_off;
+	char *in_buf;
+	int rc;			/* error if connection failed */
+} io_conn_t;
+
+static pthread_mutex_t mgr_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t io_thread = 0;
+static workq_t *workq = NULL;
+static list_t *pending_conns = NULL;	/* io_conn_t not yet started */
+static int wake_fd[2] = { -1, -1 };
+static bool shutdown_io = false;
+static int conn_cnt = 0;		/* started or pending connections */
+static int max_conns = 0;
+
+static void *_io_engine(void *arg);
+
+static int64_t _now_ms(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		fatal("%s: clock_gettime() failed: %m", __func__);
+
+	return ((int64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/* Start the engine if not running. Caller must hold mgr_mutex. */
+static void _init_engine(void)
+{
+	struct rlimit rlim;
+
+	if (io_thread)
+		return;
+
+	/* Leave half of the descriptors for everything else in slurmctld */
+	if (!getrlimit(RLIMIT_NOFILE, &rlim) && (rlim.rlim_cur != RLIM_INFINITY))
+		max_conns = MAX(64, rlim.rlim_cur / 2);
+	else
+		max_conns = 4096;
+
+	if (pipe(wake_fd))
+		fatal("%s: pipe() failed: %m", __func__);
+	for (int i = 0; i < 2; i++) {
+		fd_set_close_on_exec(wake_fd[i]);
+		fd_set_nonblocking(wake_fd[i]);
+	}
+
+	if (!pending_conns)
+		pending_conns = list_create(NULL);
+	shutdown_io = false;
+	workq = new_workq(AGENT_THREAD_COUNT);
+	slurm_thread_create(&io_thread, _io_engine, NULL);
+
+	log_flag(AGENT, "%s: started with %d workers and up to %d connections",
+		 __func__, AGENT_THREAD_COUNT, max_conns);
+}
+
+static void _wake_engine(void)
+{
+	char c = 0;
+
+	if ((write(wake_fd[1], &c, 1) < 0) && (errno != EAGAIN) &&
+	    (errno != EWOULDBLOCK))
+		error("%s: write() failed: %m", __func__);
+}
+
+static void _packed_free(packed_t *packed)
+{
+	if (!packed)
+		return;
+
+	FREE_NULL_BUFFER(packed->auth);
+	FREE_NULL_BUFFER(packed->body);
+	xfree(packed);
+}
+
+/* Pack body and auth credential of request. Caller must hold req->mutex. */
+static int _req_pack(io_req_t *req)
+{
+	msg_bufs_t bufs = { 0 };
+	packed_t *packed;
+
+	if (slurm_buffers_pack_msg(&req->msg, &bufs, false))
+		return errno;
+	FREE_NULL_BUFFER(bufs.header);
+
+	packed = xmalloc(sizeof(*packed));
+	packed->refcnt = 1;
+	packed->auth = bufs.auth;
+	packed->body = bufs.body;
+
+	if (req->packed && !--req->packed->refcnt)
+		_packed_free(req->packed);
+	req->packed = packed;
+
+	return SLURM_SUCCESS;
+}
+
+/* Drop reference to packed request. Caller must hold req->mutex. */
+static void _packed_release(packed_t *packed)
+{
+	if (packed && !--packed->refcnt)
+		_packed_free(packed);
+}
+
+static io_req_t *_req_create(slurm_msg_t *msg, bool get_reply, bool maybe,
+			     int timeout, agent_io_done_t done, void *arg)
+{
+	io_req_t *req = xmalloc(sizeof(*req));
+
+	slurm_mutex_init(&req->mutex);
+	slurm_msg_t_init(&req->msg);
+	req->msg.msg_type = msg->msg_type;
+	req->msg.flags = msg->flags;
+	req->msg.data = msg->data;
+	req->msg.protocol_version = msg->protocol_version;
+	req->msg.address = msg->address;
+	if (msg->restrict_uid_set)
+		slurm_msg_set_r_uid(&req->msg, msg->restrict_uid);
+	req->tree_width = msg->forward.tree_width;
+	req->msg.forward.tree_width = req->tree_width;
+
+	req->get_reply = get_reply;
+	req->maybe = maybe;
+	req->timeout = (timeout > 0) ? timeout : (slurm_conf.msg_timeout * 1000);
+	req->ret_list = list_create(destroy_data_info);
+	req->done = done;
+	req->arg = arg;
+
+	return req;
+}
+
+static void _req_free(io_req_t *req)
+{
+	_packed_release(req->packed);
+	FREE_NULL_LIST(req->ret_list);
+	destroy_forward(&req->msg.forward);
+	slurm_mutex_destroy(&req->mutex);
+	xfree(req);
+}
+
+/* Hand the collected responses to the caller, from a workq thread */
+static void _req_finish(void *arg)
+{
+	io_req_t *req = arg;
+	list_t *ret_list = req->ret_list;
+
+	req->ret_list = NULL;
+	req->done(ret_list, req->arg);
+	_req_free(req);
+}
+
+/* Build the header telling the branch head whom to forward to */
+static buf_t *_pack_conn_header(io_conn_t *conn)
+{
+	io_req_t *req = conn->req;
+	slurm_msg_t msg = req->msg;
+	header_t header;
+	buf_t *buffer;
+
+	msg.ret_list = NULL;
+	msg.forward.cnt = conn->fwd_cnt;
+	msg.forward.timeout = req->timeout;
+	msg.forward.tree_width = req->tree_width ? req->tree_width :
+		slurm_conf.tree_width;
+	if (conn->fwd_cnt) {
+		msg.forward.nodelist =
+			hostlist_ranged_string_xmalloc(conn->fwd_hl);
+	} else {
+		msg.forward.nodelist = NULL;
+		memset(&msg.forward.alias_addrs, 0,
+		       sizeof(msg.forward.alias_addrs));
+	}
+
+	init_header(&header, &msg, msg.flags);
+	update_header(&header, get_buf_offset(conn->packed->body));
+	buffer = init_buf(BUF_SIZE);
+	pack_header(&header, buffer);
+	xfree(msg.forward.nodelist);
+
+	return buffer;
+}
+
+/*
+ * Get the address of node name, using the addresses packed with the request
+ * when there are any.
+ */
+static int _get_addr(io_req_t *req, char *name, slurm_addr_t *addr)
+{
+	slurm_node_alias_addrs_t *alias_addrs = &req->msg.forward.alias_addrs;
+
+	if ((req->msg.flags & SLURM_PACK_ADDRS) && alias_addrs->node_addrs) {
+		hostlist_t *hl = hostlist_create(alias_addrs->node_list);
+		int n = hostlist_find(hl, name);
+
+		hostlist_destroy(hl);
+		if (n < 0)
+			return SLURM_ERROR;
+		*addr = alias_addrs->node_addrs[n];
+	} else if (slurm_conf_get_addr(name, addr, req->msg.flags)) {
+		error("%s: can't find address for host %s, check slurm.conf",
+		      __func__, name);
+		return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Create connection to name, forwarding to fwd_hl.
+ * IN repack - pack a new auth credential, as the nodes may already have seen
+ *	the one of the request when re-issuing part of a broken branch
+ */
+static io_conn_t *_conn_create(io_req_t *req, char *name, slurm_addr_t *addr,
+			       hostlist_t *fwd_hl, bool repack)
+{
+	io_conn_t *conn = xmalloc(sizeof(*conn));
+
+	conn->req = req;
+	conn->name = xstrdup(name);
+	conn->addr = *addr;
+	conn->fd = -1;
+	conn->fwd_hl = fwd_hl;
+	if (fwd_hl)
+		conn->fwd_cnt = hostlist_count(fwd_hl);
+
+	slurm_mutex_lock(&req->mutex);
+	if (repack && _req_pack(req))
+		error("%s: unable to refresh %s for %s, reusing old credential",
+		      __func__, rpc_num2string(req->msg.msg_type), name);
+	conn->packed = req->packed;
+	conn->packed->refcnt++;
+	conn->header = _pack_conn_header(conn);
+	slurm_mutex_unlock(&req->mutex);
+
+	conn->out_len = sizeof(conn->out_size) + get_buf_offset(conn->header) +
+		get_buf_offset(conn->packed->body);
+	if (conn->packed->auth)
+		conn->out_len += get_buf_offset(conn->packed->auth);
+	conn->out_size = htonl(conn->out_len - sizeof(conn->out_size));
+
+	return conn;
+}
+
+static void _conn_free(io_conn_t *conn)
+{
+	io_req_t *req = conn->req;
+
+	if (conn->fd >= 0)
+		(void) close(conn->fd);
+	slurm_mutex_lock(&req->mutex);
+	_packed_release(conn->packed);
+	slurm_mutex_unlock(&req->mutex);
+	FREE_NULL_BUFFER(conn->header);
+	FREE_NULL_HOSTLIST(conn->fwd_hl);
+	xfree(conn->in_buf);
+	xfree(conn->name);
+	xfree(conn);
+}
+
+/*
+ * Create connection to the first resolvable node of hl, forwarding to the
+ * rest of hl. Nodes that cannot be resolved are recorded as failed.
+ * RET connection or NULL if no node of hl could be resolved, hl is consumed
+ */
+static io_conn_t *_conn_create_branch(io_req_t *req, hostlist_t *hl,
+				      list_t *ret_list, bool repack)
+{
+	io_conn_t *conn = NULL;
+	slurm_addr_t addr;
+	char *name;
+
+	while ((name = hostlist_shift(hl))) {
+		if (!_get_addr(req, name, &addr)) {
+			if (!hostlist_count(hl))
+				FREE_NULL_HOSTLIST(hl);
+			conn = _conn_create(req, name, &addr, hl, repack);
+			free(name);
+			return conn;
+		}
+		mark_as_failed_forward(&ret_list, name,
+				       SLURM_UNKNOWN_FORWARD_ADDR);
+		free(name);
+	}
+
+	hostlist_destroy(hl);
+	return NULL;
+}
+
+static int _conn_finish(io_conn_t *conn, int rc);
+
+static void _submit_conns(list_t *conns)
+{
+	io_conn_t *conn;
+	int cnt = list_count(conns);
+
+	if (!cnt)
+		return;
+
+	slurm_mutex_lock(&mgr_mutex);
+	_init_engine();
+	conn_cnt += cnt;
+	if (!shutdown_io) {
+		list_transfer(pending_conns, conns);
+		_wake_engine();
+	}
+	slurm_mutex_unlock(&mgr_mutex);
+
+	/* Engine is stopping, fail connections added by completions */
+	while ((conn = list_pop(conns)))
+		(void) _conn_finish(conn, SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+}
+
+/* Run func on a worker, or right here if the workq is being shut down */
+static void _queue_work(work_func_t func, void *arg, const char *tag)
+{
+	int rc;
+
+	slurm_mutex_lock(&mgr_mutex);
+	_init_engine();
+	rc = workq_add_work(workq, func, arg, tag);
+	slurm_mutex_unlock(&mgr_mutex);
+
+	if (rc)
+		func(arg);
+}
+
+/*
+ * Unpack response of a finished connection, re-issue whatever the branch head
+ * failed to forward and complete the request if this was its last connection.
+ * Runs on a workq thread.
+ */
+static void _conn_complete(void *arg)
+{
+	io_conn_t *conn = arg;
+	io_req_t *req = conn->req;
+	list_t *ret_list = NULL, *conns = list_create(NULL);
+	ret_data_info_t *ret_data_info;
+	list_itr_t *itr;
+	bool responded = false, finished;
+	int rc = conn->rc;
+
+	if (conn->in_buf) {
+		buf_t *buffer = create_buf(conn->in_buf, conn->in_size);
+
+		conn->in_buf = NULL;
+		if ((ret_list = slurm_unpack_received_msgs(buffer, conn->fd))) {
+			responded = true;
+			itr = list_iterator_create(ret_list);
+			while ((ret_data_info = list_next(itr)))
+				if (!ret_data_info->node_name)
+					ret_data_info->node_name =
+						xstrdup(conn->name);
+			list_iterator_destroy(itr);
+		} else {
+			rc = errno;
+		}
+	} else if (!req->get_reply) {
+		ret_data_info = xmalloc(sizeof(*ret_data_info));
+		ret_data_info->node_name = xstrdup(conn->name);
+		ret_data_info->type = rc ? RESPONSE_FORWARD_FAILED :
+			RESPONSE_SLURM_RC;
+		ret_data_info->err = rc;
+		ret_list = list_create(destroy_data_info);
+		list_append(ret_list, ret_data_info);
+	}
+
+	if (!ret_list)
+		mark_as_failed_forward(&ret_list, conn->name, rc);
+
+	if (req->tree) {
+		/* Only a node that did not forward can be timed on its own */
+		if (responded && !conn->fwd_cnt)
+			fwd_node_record(conn->name, SLURM_SUCCESS,
+					(_now_ms() - conn->start) * 1000);
+		fwd_node_record_ret_list(ret_list);
+	}
+
+	if (conn->fwd_cnt && (list_count(ret_list) <= conn->fwd_cnt)) {
+		int ret_cnt = list_count(ret_list);
+		char *name;
+
+		/*
+		 * This is most common if a slurmd is running an older version
+		 * of Slurm than the originator of the message.
+		 */
+		if (responded) {
+			error("%s: %s failed to forward the message, expecting %d ret got only %d",
+			      __func__, conn->name, conn->fwd_cnt + 1,
+			      ret_cnt);
+			if (ret_cnt > 1) {
+				itr = list_iterator_create(ret_list);
+				while ((ret_data_info = list_next(itr)))
+					if (xstrcmp(ret_data_info->node_name,
+						    conn->name))
+						hostlist_delete_host(
+							conn->fwd_hl,
+							ret_data_info->
+							node_name);
+				list_iterator_destroy(itr);
+			}
+		}
+
+		/*
+		 * Abandon tree and contact the rest of the branch directly.
+		 * This way if all the nodes in the branch are down we don't
+		 * have to time out for each node serially.
+		 */
+		while ((name = hostlist_shift(conn->fwd_hl))) {
+			hostlist_t *hl = hostlist_create(name);
+			io_conn_t *new_conn;
+
+			if ((new_conn = _conn_create_branch(req, hl, ret_list,
+							    true)))
+				list_append(conns, new_conn);
+			free(name);
+		}
+	}
+
+	slurm_mutex_lock(&req->mutex);
+	list_transfer(req->ret_list, ret_list);
+	req->conn_cnt += list_count(conns) - 1;
+	finished = !req->conn_cnt;
+	slurm_mutex_unlock(&req->mutex);
+	FREE_NULL_LIST(ret_list);
+
+	_submit_conns(conns);
+	FREE_NULL_LIST(conns);
+	_conn_free(conn);
+
+	if (finished)
+		_req_finish(req);
+}
+
+/*
+ * Connection is done, successfully or not. Hand it off to a worker.
+ * RET 1 as conn must no longer be referenced by the engine
+ */
+static int _conn_finish(io_conn_t *conn, int rc)
+{
+	if (conn->fd >= 0) {
+		/* descriptor is still needed to resolve peer when unpacking */
+		if (!conn->in_buf) {
+			(void) close(conn->fd);
+			conn->fd = -1;
+		}
+	}
+	conn->rc = rc;
+
+	slurm_mutex_lock(&mgr_mutex);
+	conn_cnt--;
+	slurm_mutex_unlock(&mgr_mutex);
+
+	_queue_work(_conn_complete, conn, "_conn_complete");
+
+	return 1;
+}
+
+static int _conn_connect(io_conn_t *conn, int64_t now);
+static int _conn_write(io_conn_t *conn, int64_t now);
+
+static int _conn_connect_failed(io_conn_t *conn, int err, int64_t now)
+{
+	int conn_timeout = MIN(slurm_conf.msg_timeout, 10) * 1000;
+
+	(void) close(conn->fd);
+	conn->fd = -1;
+
+	/*
+	 * This connect retry logic permits Slurm hierarchical communications
+	 * to better survive slurmd restarts
+	 */
+	if (conn->req->get_reply &&
+	    ((err == ECONNREFUSED) || (err == ETIMEDOUT)) &&
+	    ((now - conn->start) < conn_timeout)) {
+		if (!conn->retries++)
+			log_flag(NET, "%s %pA, retrying...",
+				 (err == ETIMEDOUT) ? "Timed out connecting to" :
+				 "Connection refused by", &conn->addr);
+		conn->state = CONN_RETRY;
+		conn->deadline = now + ((err == ECONNREFUSED) ? RETRY_DELAY : 0);
+		return 0;
+	}
+
+	log_flag(NET, "Failed to connect to %pA, %s",
+		 &conn->addr, slurm_strerror(err));
+	return _conn_finish(conn, SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+}
+
+static int _conn_connected(io_conn_t *conn, int64_t now)
+{
+	conn->state = CONN_WRITE;
+	conn->deadline = now + (slurm_conf.msg_timeout * 1000);
+
+	return _conn_write(conn, now);
+}
+
+static int _conn_connect(io_conn_t *conn, int64_t now)
+{
+	if (!conn->start)
+		conn->start = now;
+
+	if (slurm_addr_is_unspec(&conn->addr) || !slurm_get_port(&conn->addr)) {
+		error("Error connecting, bad data: family = %u, port = %u",
+		      conn->addr.ss_family, slurm_get_port(&conn->addr));
+		return _conn_finish(conn, SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+	}
+
+	if ((conn->fd = socket(conn->addr.ss_family,
+			       SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+			       IPPROTO_TCP)) < 0) {
+		error("Error creating slurm stream socket: %m");
+		return _conn_finish(conn, SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+	}
+
+	if (!connect(conn->fd, (struct sockaddr *) &conn->addr,
+		     sizeof(conn->addr)))
+		return _conn_connected(conn, now);
+
+	if (errno != EINPROGRESS)
+		return _conn_connect_failed(conn, errno, now);
+
+	conn->state = CONN_CONNECT;
+	conn->deadline = now + (slurm_conf.tcp_timeout * 1000);
+
+	return 0;
+}
+
+static int _conn_write(io_conn_t *conn, int64_t now)
+{
+	void *base[4] = {
+		&conn->out_size,
+		get_buf_data(conn->header),
+		conn->packed->auth ? get_buf_data(conn->packed->auth) : NULL,
+		get_buf_data(conn->packed->body),
+	};
+	size_t len[4] = {
+		sizeof(conn->out_size),
+		get_buf_offset(conn->header),
+		conn->packed->auth ? get_buf_offset(conn->packed->auth) : 0,
+		get_buf_offset(conn->packed->body),
+	};
+	struct iovec iov[4];
+	struct msghdr mh = { .msg_iov = iov };
+	size_t skip = conn->out_off;
+	ssize_t wrote;
+
+	for (int i = 0; i < ARRAY_SIZE(iov); i++) {
+		if (skip >= len[i]) {
+			skip -= len[i];
+			continue;
+		}
+		iov[mh.msg_iovlen].iov_base = ((char *) base[i]) + skip;
+		iov[mh.msg_iovlen].iov_len = len[i] - skip;
+		mh.msg_iovlen++;
+		skip = 0;
+	}
+
+	if ((wrote = sendmsg(conn->fd, &mh, MSG_NOSIGNAL)) < 0) {
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+		    (errno == EINTR))
+			return 0;
+		log_flag(NET, "%s: [%s] sendmsg() failed: %m",
+			 __func__, conn->name);
+		return _conn_finish(conn, SLURM_COMMUNICATIONS_SEND_ERROR);
+	}
+
+	if ((conn->out_off += wrote) < conn->out_len)
+		return 0;
+
+	if (conn->req->get_reply) {
+		int timeout = conn->req->timeout;
+
+		if (conn->fwd_cnt) {
+			/*
+			 * Wait for the whole branch, giving each step of the
+			 * tree MessageTimeout to let the child time out, as
+			 * _send_and_recv_msgs() does.
+			 */
+			uint16_t width = conn->req->tree_width ?
+				conn->req->tree_width : slurm_conf.tree_width;
+			int steps = (conn->fwd_cnt + 1) / MAX(width, 1);
+
+			timeout = (slurm_conf.msg_timeout * 1000) * steps;
+			timeout += conn->req->timeout * (steps + 1);
+		}
+		conn->state = CONN_READ;
+		conn->deadline = now + timeout;
+		return 0;
+	}
+
+	if (conn->req->maybe)
+		return _conn_finish(conn, SLURM_SUCCESS);
+
+	/* Make sure message was received by remote, see slurm_send_only_node_msg() */
+	if (shutdown(conn->fd, SHUT_WR))
+		log_flag(NET, "%s: shutdown call failed: %m", __func__);
+	conn->state = CONN_DRAIN;
+	conn->deadline = now + (slurm_conf.msg_timeout * 1000);
+
+	return 0;
+}
+
+static int _conn_read(io_conn_t *conn)
+{
+	ssize_t got;
+
+	while (true) {
+		if (conn->in_off < sizeof(conn->in_size)) {
+			got = read(conn->fd,
+				   ((char *) &conn->in_size) + conn->in_off,
+				   sizeof(conn->in_size) - conn->in_off);
+		} else {
+			size_t off = conn->in_off - sizeof(conn->in_size);
+
+			got = read(conn->fd, conn->in_buf + off,
+				   conn->in_size - off);
+		}
+
+		if (got < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+			    (errno == EINTR))
+				return 0;
+			log_flag(NET, "%s: [%s] read() failed: %m",
+				 __func__, conn->name);
+			xfree(conn->in_buf);
+			return _conn_finish(conn,
+					    SLURM_COMMUNICATIONS_RECEIVE_ERROR);
+		} else if (!got) {
+			log_flag(NET, "%s: [%s] connection closed before full response",
+				 __func__, conn->name);
+			xfree(conn->in_buf);
+			return _conn_finish(conn,
+					    SLURM_COMMUNICATIONS_RECEIVE_ERROR);
+		}
+
+		conn->in_off += got;
+
+		if (conn->in_off == sizeof(conn->in_size)) {
+			conn->in_size = ntohl(conn->in_size);
+			if (conn->in_size > MAX_MSG_SIZE)
+				return _conn_finish(
+					conn, SLURM_PROTOCOL_INSANE_MSG_LENGTH);
+			conn->in_buf = xmalloc_nz(MAX(conn->in_size, 1));
+		}
+
+		if ((conn->in_off > sizeof(conn->in_size)) &&
+		    (conn->in_off == (conn->in_size + sizeof(conn->in_size))))
+			return _conn_finish(conn, SLURM_SUCCESS);
+		else if (!conn->in_size &&
+			 (conn->in_off == sizeof(conn->in_size)))
+			return _conn_finish(conn, SLURM_SUCCESS);
+	}
+}
+
+/* Process events on connection. RET 1 if connection was handed off */
+static int _conn_handle(io_conn_t *conn, short revents, int64_t now)
+{
+	int err = 0;
+
+	switch (conn->state) {
+	case CONN_CONNECT:
+		if (fd_get_socket_error(conn->fd, &err))
+			err = errno;
+		if (err && (err != SLURM_COMMUNICATIONS_MISSING_SOCKET_ERROR))
+			return _conn_connect_failed(conn, err, now);
+		return _conn_connected(conn, now);
+	case CONN_WRITE:
+		return _conn_write(conn, now);
+	case CONN_READ:
+		return _conn_read(conn);
+	case CONN_DRAIN:
+		if (revents & POLLERR) {
+			(void) fd_get_socket_error(conn->fd, &err);
+			log_flag(NET, "%s: [%s] poll error: %s",
+				 __func__, conn->name, slurm_strerror(err));
+			return _conn_finish(conn,
+					    SLURM_COMMUNICATIONS_SEND_ERROR);
+		}
+		return _conn_finish(conn, SLURM_SUCCESS);
+	case CONN_RETRY:
+		break;
+	}
+
+	return 0;
+}
+
+/* Deadline of connection passed. RET 1 if connection was handed off */
+static int _conn_expired(io_conn_t *conn, int64_t now)
+{
+	switch (conn->state) {
+	case CONN_RETRY:
+		return _conn_connect(conn, now);
+	case CONN_CONNECT:
+		return _conn_connect_failed(conn, ETIMEDOUT, now);
+	case CONN_WRITE:
+	case CONN_READ:
+	case CONN_DRAIN:
+		log_flag(NET, "%s: [%s] timed out after %"PRId64" msec",
+			 __func__, conn->name, (now - conn->start));
+		xfree(conn->in_buf);
+		return _conn_finish(conn, SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT);
+	}
+
+	return 0;
+}
+
+static short _conn_events(io_conn_t *conn)
+{
+	switch (conn->state) {
+	case CONN_CONNECT:
+	case CONN_WRITE:
+		return POLLOUT;
+	case CONN_READ:
+	case CONN_DRAIN:
+		return POLLIN;
+	case CONN_RETRY:
+		break;
+	}
+
+	return 0;
+}
+
+static void *_io_engine(void *arg)
+{
+	int active_cnt = 0, active_size = 64;
+	io_conn_t **active = xcalloc(active_size, sizeof(*active));
+	struct pollfd *pfds = xcalloc(active_size + 1, sizeof(*pfds));
+	int *pfd_conn = xcalloc(active_size + 1, sizeof(*pfd_conn));
+
+#if HAVE_SYS_PRCTL_H
+	if (prctl(PR_SET_NAME, "agent_io", NULL, NULL, NULL) < 0)
+		error("%s: cannot set my name to %s %m", __func__, "agent_io");
+#endif
+
+	while (true) {
+		int64_t now, next;
+		int nfds = 1, timeout, cnt = 0;
+		io_conn_t *conn;
+
+		/* Pick up new connections as descriptors allow */
+		slurm_mutex_lock(&mgr_mutex);
+		if (shutdown_io) {
+			slurm_mutex_unlock(&mgr_mutex);
+			break;
+		}
+		now = _now_ms();
+		while ((active_cnt < max_conns) &&
+		       (conn = list_dequeue(pending_conns))) {
+			if (active_cnt >= active_size) {
+				active_size *= 2;
+				xrecalloc(active, active_size, sizeof(*active));
+				xrecalloc(pfds, active_size + 1,
+					  sizeof(*pfds));
+				xrecalloc(pfd_conn, active_size + 1,
+					  sizeof(*pfd_conn));
+			}
+			active[active_cnt++] = conn;
+			conn->deadline = now;
+			conn->state = CONN_RETRY;
+		}
+		slurm_mutex_unlock(&mgr_mutex);
+
+		/* Handle expired deadlines and gather descriptors to watch */
+		next = now + 1000;
+		pfds[0].fd = wake_fd[0];
+		pfds[0].events = POLLIN;
+		for (int i = 0; i < active_cnt; i++) {
+			conn = active[i];
+			if ((conn->deadline <= now) && _conn_expired(conn, now))
+				continue;
+			active[cnt++] = conn;
+			if (conn->deadline < next)
+				next = conn->deadline;
+			if (conn->fd < 0)
+				continue;
+			pfds[nfds].fd = conn->fd;
+			pfds[nfds].events = _conn_events(conn);
+			pfds[nfds].revents = 0;
+			pfd_conn[nfds] = cnt - 1;
+			nfds++;
+		}
+		active_cnt = cnt;
+
+		timeout = MAX(0, next - now);
+		if (poll(pfds, nfds, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			fatal("%s: poll() failed: %m", __func__);
+		}
+
+		if (pfds[0].revents) {
+			char buf[64];
+
+			while (read(wake_fd[0], buf, sizeof(buf)) > 0)
+				;
+		}
+
+		now = _now_ms();
+		for (int i = 1; i < nfds; i++) {
+			if (!pfds[i].revents)
+				continue;
+			if (_conn_handle(active[pfd_conn[i]], pfds[i].revents,
+					 now))
+				active[pfd_conn[i]] = NULL;
+		}
+
+		cnt = 0;
+		for (int i = 0; i < active_cnt; i++)
+			if (active[i])
+				active[cnt++] = active[i];
+		active_cnt = cnt;
+	}
+
+	/* Fail anything left so every request still completes */
+	for (int i = 0; i < active_cnt; i++)
+		(void) _conn_finish(active[i], SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+	xfree(active);
+	xfree(pfds);
+	xfree(pfd_conn);
+
+	return NULL;
+}
+
+extern void agent_io_send_tree(hostlist_t *hl, slurm_msg_t *msg, int timeout,
+			       agent_io_done_t done, void *arg)
+{
+	io_req_t *req = _req_create(msg, true, false, timeout, done, arg);
+	list_t *conns = list_create(NULL);
+	hostlist_t **sp_hl = NULL;
+	int hl_count = 0, rc;
+
+	req->tree = true;
+	(void) fwd_prepare_msg_tree(hl, &req->msg);
+
+	slurm_mutex_lock(&req->mutex);
+	rc = _req_pack(req);
+	slurm_mutex_unlock(&req->mutex);
+
+	if (rc || fwd_split_hostlist(hl, &sp_hl, &hl_count,
+				     req->tree_width)) {
+		char *name;
+
+		if (!rc)
+			rc = SLURM_COMMUNICATIONS_CONNECTION_ERROR;
+		error("%s: unable to send %s: %s",
+		      __func__, rpc_num2string(req->msg.msg_type),
+		      slurm_strerror(rc));
+		while ((name = hostlist_shift(hl))) {
+			mark_as_failed_forward(&req->ret_list, name, rc);
+			free(name);
+		}
+	} else {
+		for (int i = 0; i < hl_count; i++) {
+			io_conn_t *conn;
+
+			if ((conn = _conn_create_branch(req, sp_hl[i],
+							req->ret_list, false)))
+				list_append(conns, conn);
+		}
+	}
+	xfree(sp_hl);
+	hostlist_destroy(hl);
+
+	if (!(req->conn_cnt = list_count(conns)))
+		_queue_work(_req_finish, req, "_req_finish");
+	else
+		_submit_conns(conns);
+	FREE_NULL_LIST(conns);
+}
+
+extern void agent_io_send_addr(slurm_msg_t *msg, char *name, bool get_reply,
+			       bool maybe, agent_io_done_t done, void *arg)
+{
+	io_req_t *req = _req_create(msg, get_reply, maybe, 0, done, arg);
+	list_t *conns;
+	int rc;
+
+	slurm_mutex_lock(&req->mutex);
+	rc = _req_pack(req);
+	slurm_mutex_unlock(&req->mutex);
+
+	if (rc) {
+		ret_data_info_t *ret_data_info = xmalloc(sizeof(*ret_data_info));
+
+		error("%s: unable to send %s to %s: %s",
+		      __func__, rpc_num2string(req->msg.msg_type), name,
+		      slurm_strerror(rc));
+		ret_data_info->node_name = xstrdup(name);
+		ret_data_info->type = RESPONSE_FORWARD_FAILED;
+		ret_data_info->err = rc;
+		list_append(req->ret_list, ret_data_info);
+		_queue_work(_req_finish, req, "_req_finish");
+		return;
+	}
+
+	conns = list_create(NULL);
+	list_append(conns, _conn_create(req, name, &req->msg.address, NULL,
+					false));
+	req->conn_cnt = 1;
+	_submit_conns(conns);
+	FREE_NULL_LIST(conns);
+}
+
+extern int agent_io_get_conn_count(void)
+{
+	int cnt;
+
+	slurm_mutex_lock(&mgr_mutex);
+	cnt = conn_cnt;
+	slurm_mutex_unlock(&mgr_mutex);
+
+	return cnt;
+}
+
+extern void agent_io_fini(void)
+{
+	io_conn_t *conn;
+	list_t *conns;
+	pthread_t tid;
+
+	slurm_mutex_lock(&mgr_mutex);
+	if (!(tid = io_thread)) {
+		slurm_mutex_unlock(&mgr_mutex);
+		return;
+	}
+	shutdown_io = true;
+	_wake_engine();
+	slurm_mutex_unlock(&mgr_mutex);
+
+	slurm_thread_join(tid);
+
+	slurm_mutex_lock(&mgr_mutex);
+	conns = pending_conns;
+	pending_conns = list_create(NULL);
+	slurm_mutex_unlock(&mgr_mutex);
+
+	while ((conn = list_pop(conns)))
+		(void) _conn_finish(conn, SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+	FREE_NULL_LIST(conns);
+
+	/* Wait for the callbacks, which may queue more work of their own */
+	quiesce_workq(workq);
+
+	slurm_mutex_lock(&mgr_mutex);
+	FREE_NULL_WORKQ(workq);
+	FREE_NULL_LIST(pending_conns);
+	(void) close(wake_fd[0]);
+	(void) close(wake_fd[1]);
+	wake_fd[0] = wake_fd[1] = -1;
+	io_thread = 0;
+	slurm_mutex_unlock(&mgr_mutex);
+}
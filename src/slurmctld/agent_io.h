@@ -0,0 +1,87 @@
+/*****************************************************************************\
+ *  agent_io.h - non-blocking communications engine for the RPC agent
+ *****************************************************************************
+ *  Copyright (C) SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _AGENT_IO_H
+#define _AGENT_IO_H
+
+#include "src/common/hostlist.h"
+#include "src/common/list.h"
+#include "src/common/slurm_protocol_defs.h"
+
+/*
+ * Called once every node of a request has answered, failed or timed out.
+ * Runs on one of the agent_io worker threads, which may take slurmctld locks.
+ * IN ret_list - ret_data_info_t for every node, owned by the callee
+ * IN arg - arg given when the request was submitted
+ */
+typedef void (*agent_io_done_t) (list_t *ret_list, void *arg);
+
+/*
+ * Send msg to every node in hl using the same forwarding tree as
+ * start_msg_tree(), but without blocking the caller or dedicating a thread to
+ * each branch of the tree.
+ * IN hl - nodes to send to, consumed
+ * IN msg - message to send, msg->data must stay valid until done is called
+ * IN timeout - how long each node has to respond in milliseconds, 0 for
+ *	MessageTimeout
+ * IN done - completion callback, always called exactly once
+ * IN arg - passed to done
+ */
+extern void agent_io_send_tree(hostlist_t *hl, slurm_msg_t *msg, int timeout,
+			       agent_io_done_t done, void *arg);
+
+/*
+ * Send msg to msg->address without forwarding.
+ * IN msg - message to send, msg->data must stay valid until done is called
+ * IN name - node name to record in the ret_list
+ * IN get_reply - wait for and unpack a response, as
+ *	slurm_send_addr_recv_msgs() does. Otherwise only confirm delivery, as
+ *	slurm_send_only_node_msg() does, with the result in the err field of the
+ *	single ret_list record.
+ * IN maybe - when not getting a reply, do not wait for delivery at all, as
+ *	slurm_send_msg_maybe() does
+ * IN done - completion callback, always called exactly once
+ * IN arg - passed to done
+ */
+extern void agent_io_send_addr(slurm_msg_t *msg, char *name, bool get_reply,
+			       bool maybe, agent_io_done_t done, void *arg);
+
+/* Get count of connections currently open or waiting to be opened */
+extern int agent_io_get_conn_count(void);
+
+/* Stop the engine, failing anything still outstanding */
+extern void agent_io_fini(void);
+
+#endif
@@ -98,6 +98,7 @@
 #include "src/slurmctld/node_scheduler.h"
 #include "src/slurmctld/power_save.h"
 #include "src/slurmctld/proc_req.h"
+#include "src/slurmctld/rate_limit.h"
 #include "src/slurmctld/read_config.h"
 #include "src/slurmctld/reservation.h"
 #include "src/slurmctld/sackd_mgr.h"
@@ -119,6 +120,11 @@ static uint64_t rpc_user_time[RPC_USER_SIZE] = { 0 };
 
 static bool do_post_rpc_node_registration = false;
 
+/* Leave room in the persist_conn thread pool for federation connections */
+#define MAX_PERSIST_CLIENT_CNT 50
+static pthread_mutex_t persist_client_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int persist_client_cnt = 0;
+
 bool running_configless = false;
 static pthread_rwlock_t configless_lock = PTHREAD_RWLOCK_INITIALIZER;
 static config_response_msg_t *config_for_slurmd = NULL;
@@ -1859,6 +1865,8 @@ static void _slurm_rpc_epilog_complete(slurm_msg_t *msg)
 	epilog_complete_msg_t *epilog_msg = msg->data;
 	job_record_t *job_ptr;
 	bool run_scheduler = false;
+	hostlist_t *hl;
+	char *node_name;
 
 	START_TIMER;
 	if (!validate_slurm_user(msg->auth_uid)) {
@@ -1883,9 +1891,19 @@ static void _slurm_rpc_epilog_complete(slurm_msg_t *msg)
 	log_flag(ROUTE, "%s: node_name = %s, JobId=%u",
 		 __func__, epilog_msg->node_name, epilog_msg->job_id);
 
-	if (job_epilog_complete(epilog_msg->job_id, epilog_msg->node_name,
-				epilog_msg->return_code))
-		run_scheduler = true;
+	/*
+	 * slurmd collects epilog completions along the job's reverse tree,
+	 * so node_name may hold many nodes.
+	 */
+	if ((hl = hostlist_create(epilog_msg->node_name))) {
+		while ((node_name = hostlist_shift(hl))) {
+			if (job_epilog_complete(epilog_msg->job_id, node_name,
+						epilog_msg->return_code))
+				run_scheduler = true;
+			free(node_name);
+		}
+		hostlist_destroy(hl);
+	}
 
 	job_ptr = find_job_record(epilog_msg->job_id);
 
@@ -5964,12 +5982,59 @@ static int _process_persist_conn(void *arg, persist_msg_t *persist_msg,
 		} else {
 			slurm_send_rc_msg(&msg, EINVAL);
 		}
+	} else if (persist_conn->persist_type == PERSIST_TYPE_CLIENT) {
+		msg.protocol_version = persist_conn->version;
+
+		if (rate_limit_exceeded(&msg))
+			slurm_send_rc_msg(&msg,
+					  SLURMCTLD_COMMUNICATIONS_BACKOFF);
+		else
+			slurmctld_req(&msg);
 	} else
 		slurmctld_req(&msg);
 
 	return SLURM_SUCCESS;
 }
 
+/* Release slot reserved by _persist_client_add() */
+static void _persist_client_del(void)
+{
+	slurm_mutex_lock(&persist_client_mutex);
+	persist_client_cnt--;
+	slurm_mutex_unlock(&persist_client_mutex);
+}
+
+static void _persist_client_fini(void *arg)
+{
+	slurm_persist_conn_t *persist_conn = arg;
+
+	log_flag(NET, "%s: persistent client connection from %s uid %u closed",
+		 __func__, persist_conn->rem_host, persist_conn->auth_uid);
+
+	_persist_client_del();
+}
+
+/*
+ * Reserve a persistent client connection slot
+ * RET SLURM_SUCCESS or error if client connections are disabled or all used
+ */
+static int _persist_client_add(void)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!xstrcasestr(slurm_conf.slurmctld_params, "enable_persist_clients"))
+		return ESLURM_NOT_SUPPORTED;
+
+	slurm_mutex_lock(&persist_client_mutex);
+	if (persist_client_cnt >= MAX_PERSIST_CLIENT_CNT)
+		rc = EAGAIN;
+	else
+		persist_client_cnt++;
+	slurm_mutex_unlock(&persist_client_mutex);
+
+	return rc;
+}
+
 static void _slurm_rpc_persist_init(slurm_msg_t *msg)
 {
 	DEF_TIMERS;
@@ -5988,16 +6053,23 @@ static void _slurm_rpc_persist_init(slurm_msg_t *msg)
 	if (persist_init->version > SLURM_PROTOCOL_VERSION)
 		persist_init->version = SLURM_PROTOCOL_VERSION;
 
-	if (!validate_slurm_user(msg->auth_uid)) {
+	if (persist_init->persist_type == PERSIST_TYPE_CLIENT) {
+		/* any user may connect, RPCs are checked as that user */
+		if ((rc = _persist_client_add()))
+			debug("%s: rejecting persistent client connection from uid=%u: %s",
+			      __func__, msg->auth_uid, slurm_strerror(rc));
+	} else if (!validate_slurm_user(msg->auth_uid)) {
+		rc = ESLURM_USER_ID_MISSING;
+		error("Security violation, REQUEST_PERSIST_INIT RPC from uid=%u",
+		      msg->auth_uid);
+	}
+
+	if (rc) {
 		memset(&p_tmp, 0, sizeof(p_tmp));
 		p_tmp.fd = msg->conn_fd;
 		p_tmp.cluster_name = persist_init->cluster_name;
 		p_tmp.version = persist_init->version;
 		p_tmp.shutdown = &slurmctld_config.shutdown_time;
-
-		rc = ESLURM_USER_ID_MISSING;
-		error("Security violation, REQUEST_PERSIST_INIT RPC from uid=%u",
-		      msg->auth_uid);
 		goto end_it;
 	}
 
@@ -6040,6 +6112,23 @@ static void _slurm_rpc_persist_init(slurm_msg_t *msg)
 		persist_conn->flags |= PERSIST_FLAG_ALREADY_INITED;
 		slurm_persist_conn_recv_thread_init(
 			persist_conn, -1, persist_conn);
+	} else if (persist_init->persist_type == PERSIST_TYPE_CLIENT) {
+		int thread_loc = slurm_persist_conn_wait_for_thread_loc();
+
+		if (thread_loc < 0) {
+			/* Shutting down, no thread will release the slot */
+			_persist_client_del();
+			rc = ESLURM_NOT_SUPPORTED;
+		} else {
+			/* Do not let idle clients hold slots forever */
+			persist_conn->flags |= PERSIST_FLAG_ALREADY_INITED |
+					       PERSIST_FLAG_IDLE_TIMEOUT;
+			persist_conn->timeout =
+				PERSIST_CLIENT_IDLE_TIMEOUT * MSEC_IN_SEC;
+			persist_conn->callback_fini = _persist_client_fini;
+			slurm_persist_conn_recv_thread_init(
+				persist_conn, thread_loc, persist_conn);
+		}
 	} else
 		rc = SLURM_ERROR;
 end_it:
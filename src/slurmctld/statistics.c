@@ -53,11 +53,15 @@ extern buf_t *pack_all_stat(uint16_t protocol_version)
 	int agent_count;
 	int agent_thread_count;
 	int slurmdbd_queue_size = 0;
+	acct_storage_agent_stats_t slurmdbd_agent_stats = { 0 };
 	time_t now = time(NULL);
 
 	if (acct_storage_g_get_data(acct_db_conn, ACCT_STORAGE_INFO_AGENT_COUNT,
 				    &slurmdbd_queue_size) != SLURM_SUCCESS)
 		slurmdbd_queue_size = 0;
+	if (acct_storage_g_get_data(acct_db_conn, ACCT_STORAGE_INFO_AGENT_STATS,
+				    &slurmdbd_agent_stats) != SLURM_SUCCESS)
+		memset(&slurmdbd_agent_stats, 0, sizeof(slurmdbd_agent_stats));
 
 	buffer = init_buf(BUF_SIZE);
 	if (protocol_version >= SLURM_23_11_PROTOCOL_VERSION) {
@@ -122,6 +126,12 @@ extern buf_t *pack_all_stat(uint16_t protocol_version)
 		pack32(slurmctld_diag_stats.backfilled_het_jobs, buffer);
 		pack32_array(slurmctld_diag_stats.bf_exit, BF_EXIT_COUNT,
 			     buffer);
+
+		if (protocol_version >= SLURM_24_05_PROTOCOL_VERSION) {
+			pack32(slurmdbd_agent_stats.batch_cnt, buffer);
+			pack32(slurmdbd_agent_stats.latency_max, buffer);
+			pack64(slurmdbd_agent_stats.latency_sum, buffer);
+		}
 	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		pack32(1, buffer);
 
@@ -0,0 +1,387 @@
+/*****************************************************************************\
+ *  bcast_cache.c - content addressed cache of sbcast blocks
+ *****************************************************************************
+ *  Copyright (C) SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "src/common/fd.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/proc_args.h"
+#include "src/common/read_config.h"
+#include "src/common/xhash.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "src/interfaces/hash.h"
+
+#include "src/slurmd/slurmd/bcast_cache.h"
+#include "src/slurmd/slurmd/slurmd.h"
+
+/*
+ * Blocks are kept as one file each in SlurmdSpoolDir/bcast_cache, named
+ * "<uid>_<hex digest>". The uid is part of the name so that a user can only
+ * be served blocks they broadcast themselves, and cannot probe for the
+ * contents of files broadcast by others. Files being written have a ".XXXXXX"
+ * suffix until they are complete.
+ */
+#define CACHE_DIR "bcast_cache"
+#define KEY_LEN (11 + 1 + (sizeof(((slurm_hash_t *) 0)->hash) * 2) + 1)
+
+typedef struct cache_ent {
+	char *key;		/* file name */
+	struct cache_ent *next;	/* more recently used */
+	struct cache_ent *prev;	/* less recently used */
+	uint64_t size;		/* bytes of block data */
+	time_t mtime;		/* only used to order entries found at init */
+} cache_ent_t;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char *cache_dir = NULL;
+static xhash_t *cache_hash = NULL;
+static uint64_t cache_max = 0;		/* bytes, zero if cache is disabled */
+static uint64_t cache_used = 0;		/* bytes in all entries */
+static cache_ent_t *lru_head = NULL;	/* next entry to be evicted */
+static cache_ent_t *lru_tail = NULL;	/* most recently used entry */
+
+static void _ent_id(void *item, const char **key, uint32_t *key_len)
+{
+	cache_ent_t *ent = item;
+
+	*key = ent->key;
+	*key_len = strlen(ent->key);
+}
+
+static void _ent_free(void *x)
+{
+	cache_ent_t *ent = x;
+
+	if (!ent)
+		return;
+
+	xfree(ent->key);
+	xfree(ent);
+}
+
+static void _make_key(uid_t uid, slurm_hash_t *digest, char *key)
+{
+	int len = snprintf(key, KEY_LEN, "%u_", uid);
+
+	for (int i = 0; i < sizeof(digest->hash); i++)
+		len += snprintf(key + len, KEY_LEN - len, "%02x",
+				digest->hash[i]);
+}
+
+static void _lru_unlink(cache_ent_t *ent)
+{
+	if (ent->prev)
+		ent->prev->next = ent->next;
+	else
+		lru_head = ent->next;
+	if (ent->next)
+		ent->next->prev = ent->prev;
+	else
+		lru_tail = ent->prev;
+	ent->next = ent->prev = NULL;
+}
+
+static void _lru_append(cache_ent_t *ent)
+{
+	ent->prev = lru_tail;
+	ent->next = NULL;
+	if (lru_tail)
+		lru_tail->next = ent;
+	else
+		lru_head = ent;
+	lru_tail = ent;
+}
+
+/* Add a complete cache file. Caller must hold cache_mutex. */
+static void _ent_add(cache_ent_t *ent)
+{
+	xhash_add(cache_hash, ent);
+	_lru_append(ent);
+	cache_used += ent->size;
+}
+
+/* Drop least recently used entries. Caller must hold cache_mutex. */
+static void _evict(void)
+{
+	while ((cache_used > cache_max) && lru_head) {
+		cache_ent_t *ent = lru_head;
+		char *path = xstrdup_printf("%s/%s", cache_dir, ent->key);
+
+		if (unlink(path) && (errno != ENOENT))
+			error("%s: unlink(%s): %m", __func__, path);
+		xfree(path);
+
+		_lru_unlink(ent);
+		(void) xhash_pop(cache_hash, ent->key, strlen(ent->key));
+		cache_used -= ent->size;
+		_ent_free(ent);
+	}
+}
+
+static int _sort_by_mtime(void *x, void *y)
+{
+	cache_ent_t *ent1 = *(cache_ent_t **) x;
+	cache_ent_t *ent2 = *(cache_ent_t **) y;
+
+	if (ent1->mtime < ent2->mtime)
+		return -1;
+	return (ent1->mtime > ent2->mtime);
+}
+
+/* Index blocks left by a previous slurmd, oldest first */
+static void _load_dir(void)
+{
+	list_t *ents = list_create(NULL);
+	struct dirent *de;
+	cache_ent_t *ent;
+	DIR *dp;
+
+	if (!(dp = opendir(cache_dir))) {
+		error("%s: opendir(%s): %m", __func__, cache_dir);
+		FREE_NULL_LIST(ents);
+		return;
+	}
+
+	while ((de = readdir(dp))) {
+		char *path;
+		struct stat st;
+
+		if (de->d_name[0] == '.')
+			continue;
+
+		path = xstrdup_printf("%s/%s", cache_dir, de->d_name);
+		if ((strlen(de->d_name) >= KEY_LEN) ||
+		    xstrchr(de->d_name, '.') ||
+		    stat(path, &st) || !S_ISREG(st.st_mode)) {
+			/* incomplete block or something we did not write */
+			(void) unlink(path);
+			xfree(path);
+			continue;
+		}
+		xfree(path);
+
+		ent = xmalloc(sizeof(*ent));
+		ent->key = xstrdup(de->d_name);
+		ent->size = st.st_size;
+		ent->mtime = st.st_mtime;
+		list_append(ents, ent);
+	}
+	closedir(dp);
+
+	list_sort(ents, _sort_by_mtime);
+	while ((ent = list_pop(ents)))
+		_ent_add(ent);
+	FREE_NULL_LIST(ents);
+}
+
+extern void bcast_cache_init(void)
+{
+	char *tmp;
+
+	slurm_mutex_lock(&cache_mutex);
+
+	cache_dir = xstrdup_printf("%s/%s", conf->spooldir, CACHE_DIR);
+	if ((tmp = conf_get_opt_str(slurm_conf.bcast_parameters,
+				    "CacheSize="))) {
+		uint64_t mbytes = str_to_mbytes(tmp);
+
+		if (mbytes == NO_VAL64)
+			error("Invalid BcastParameters CacheSize=%s, file broadcast cache disabled",
+			      tmp);
+		else
+			cache_max = mbytes * 1024 * 1024;
+		xfree(tmp);
+	}
+
+	if (!cache_max) {
+		/* Reclaim space used while the cache was enabled */
+		(void) rmdir_recursive(cache_dir, true);
+		goto fini;
+	}
+
+	if ((mkdir(cache_dir, 0700) < 0) && (errno != EEXIST)) {
+		error("%s: mkdir(%s): %m, file broadcast cache disabled",
+		      __func__, cache_dir);
+		cache_max = 0;
+		goto fini;
+	}
+
+	cache_hash = xhash_init(_ent_id, NULL);
+	_load_dir();
+	_evict();
+
+	debug("%s: %"PRIu64" of %"PRIu64" bytes of file broadcast cache in use",
+	      __func__, cache_used, cache_max);
+
+fini:
+	slurm_mutex_unlock(&cache_mutex);
+}
+
+extern void bcast_cache_fini(void)
+{
+	slurm_mutex_lock(&cache_mutex);
+	while (lru_head) {
+		cache_ent_t *ent = lru_head;
+
+		_lru_unlink(ent);
+		_ent_free(ent);
+	}
+	xhash_free(cache_hash);
+	cache_used = cache_max = 0;
+	xfree(cache_dir);
+	slurm_mutex_unlock(&cache_mutex);
+}
+
+extern int bcast_cache_load(uid_t uid, file_bcast_msg_t *req)
+{
+	char key[KEY_LEN], *path = NULL, *data = NULL;
+	cache_ent_t *ent;
+	int fd;
+
+	if (!cache_max || (req->digest.type != HASH_PLUGIN_K12) ||
+	    !req->uncomp_len)
+		return ESLURMD_BCAST_BLOCK_NOT_CACHED;
+
+	_make_key(uid, &req->digest, key);
+
+	slurm_mutex_lock(&cache_mutex);
+	if (cache_hash && (ent = xhash_get_str(cache_hash, key)) &&
+	    (ent->size == req->uncomp_len)) {
+		_lru_unlink(ent);
+		_lru_append(ent);
+		path = xstrdup_printf("%s/%s", cache_dir, key);
+	}
+	slurm_mutex_unlock(&cache_mutex);
+
+	if (!path)
+		return ESLURMD_BCAST_BLOCK_NOT_CACHED;
+
+	/* an open file survives being evicted while it is read */
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		debug("%s: open(%s): %m", __func__, path);
+		xfree(path);
+		return ESLURMD_BCAST_BLOCK_NOT_CACHED;
+	}
+
+	data = xmalloc_nz(req->uncomp_len);
+	safe_read(fd, data, req->uncomp_len);
+	(void) close(fd);
+	xfree(path);
+
+	xfree(req->block);
+	req->block = data;
+	req->block_len = req->uncomp_len;
+	req->compress = COMPRESS_OFF;
+
+	return SLURM_SUCCESS;
+
+rwfail:
+	error("%s: unable to read %s: %m", __func__, path);
+	(void) close(fd);
+	xfree(path);
+	xfree(data);
+	return ESLURMD_BCAST_BLOCK_NOT_CACHED;
+}
+
+extern void bcast_cache_save(uid_t uid, file_bcast_msg_t *req)
+{
+	slurm_hash_t digest = { .type = HASH_PLUGIN_K12 };
+	char key[KEY_LEN], *path = NULL, *tmp = NULL;
+	cache_ent_t *ent;
+	int fd = -1;
+
+	if (!cache_max || !req->block_len || (req->block_len > cache_max))
+		return;
+
+	if (hash_g_compute(req->block, req->block_len, NULL, 0, &digest) <= 0)
+		return;
+	_make_key(uid, &digest, key);
+
+	slurm_mutex_lock(&cache_mutex);
+	if ((ent = xhash_get_str(cache_hash, key))) {
+		_lru_unlink(ent);
+		_lru_append(ent);
+	}
+	slurm_mutex_unlock(&cache_mutex);
+	if (ent)
+		return;
+
+	/* write under a temporary name so readers never see part of a block */
+	path = xstrdup_printf("%s/%s", cache_dir, key);
+	tmp = xstrdup_printf("%s.XXXXXX", path);
+	if ((fd = mkstemp(tmp)) < 0) {
+		error("%s: mkstemp(%s): %m", __func__, tmp);
+		goto fini;
+	}
+	safe_write(fd, req->block, req->block_len);
+	if (close(fd)) {
+		fd = -1;
+		goto rwfail;
+	}
+	fd = -1;
+	if (rename(tmp, path)) {
+		error("%s: rename(%s): %m", __func__, tmp);
+		goto rwfail;
+	}
+
+	slurm_mutex_lock(&cache_mutex);
+	/* another thread may have cached the same block meanwhile */
+	if (!xhash_get_str(cache_hash, key)) {
+		ent = xmalloc(sizeof(*ent));
+		ent->key = xstrdup(key);
+		ent->size = req->block_len;
+		_ent_add(ent);
+		_evict();
+	}
+	slurm_mutex_unlock(&cache_mutex);
+	goto fini;
+
+rwfail:
+	error("%s: unable to cache block of %s: %m", __func__, req->fname);
+	if (fd >= 0)
+		(void) close(fd);
+	(void) unlink(tmp);
+fini:
+	xfree(path);
+	xfree(tmp);
+}
@@ -0,0 +1,64 @@
+/*****************************************************************************\
+ *  bcast_cache.h - content addressed cache of sbcast blocks
+ *****************************************************************************
+ *  Copyright (C) SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _BCAST_CACHE_H
+#define _BCAST_CACHE_H
+
+#include "src/common/slurm_protocol_defs.h"
+
+/*
+ * Set up the cache in SlurmdSpoolDir, sized by BcastParameters=CacheSize.
+ * Blocks cached by a previous slurmd are kept, up to the new size.
+ */
+extern void bcast_cache_init(void);
+
+extern void bcast_cache_fini(void);
+
+/*
+ * Fill in the data of a FILE_BCAST_DIGEST request from the cache.
+ * IN uid - user that broadcast the block
+ * IN/OUT req - request with digest and uncomp_len set, on success block is
+ *	set to the uncompressed data
+ * RET SLURM_SUCCESS or ESLURMD_BCAST_BLOCK_NOT_CACHED
+ */
+extern int bcast_cache_load(uid_t uid, file_bcast_msg_t *req);
+
+/*
+ * Add the uncompressed data of a request to the cache.
+ * The digest is computed here, the one sent with the request is not trusted.
+ */
+extern void bcast_cache_save(uid_t uid, file_bcast_msg_t *req);
+
+#endif
@@ -0,0 +1,331 @@
+/*****************************************************************************\
+ *  epilog_aggr.c - collect epilog completions of a job along its reverse tree
+ *****************************************************************************
+ *  Copyright (C) SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "src/common/hostlist.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/read_config.h"
+#include "src/common/reverse_tree.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "src/slurmd/slurmd/epilog_aggr.h"
+#include "src/slurmd/slurmd/slurmd.h"
+
+/*
+ * Every node of a job computes its place in the job's reverse tree from the
+ * job's node list, as slurmstepd does for step completion. Leaves report their
+ * epilog completion to their parent. A node with children collects the
+ * completions of its subtree and reports them to its own parent in one
+ * message, once the whole subtree reported or nothing arrived for AGGR_WINDOW
+ * (and at most AGGR_MAX_WAIT after the first completion arrived). Rank 0
+ * reports to slurmctld, with node_name set to the list of all nodes reported.
+ * Whenever a parent cannot be reached, completions go to slurmctld directly.
+ */
+#define AGGR_WINDOW	100	/* msec to wait for more of the subtree */
+#define AGGR_MAX_WAIT	1000	/* msec to hold any completion */
+
+typedef struct {
+	uint32_t job_id;
+	char *nodes;		/* all nodes of the job */
+	char *parent;		/* node to report to, NULL for slurmctld */
+	int expect;		/* nodes of our subtree, including us */
+	hostlist_t *hl;		/* nodes whose epilog completed */
+	int64_t start;		/* msec when first completion arrived */
+	int64_t deadline;	/* msec when to send what was collected */
+} aggr_rec_t;
+
+static pthread_mutex_t aggr_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t aggr_cond = PTHREAD_COND_INITIALIZER;
+static list_t *aggr_list = NULL;
+static int aggr_thread_cnt = 0;
+static bool aggr_shutdown = false;
+
+/*
+ * Find this node's place in the reverse tree of nodes
+ * OUT parent - name of parent node, NULL for rank 0, xfree() when done
+ * OUT children - number of nodes below this one in the tree
+ * RET false if nodes are too few to build a tree
+ */
+static bool _tree_info(char *nodes, char **parent, int *children)
+{
+	hostlist_t *hl;
+	int rank, parent_rank, num_children, depth, max_depth;
+	char *name;
+
+	if (!nodes || !slurm_conf.tree_width)
+		return false;
+
+	hl = hostlist_create(nodes);
+	if ((rank = hostlist_find(hl, conf->node_name)) < 0) {
+		hostlist_destroy(hl);
+		return false;
+	}
+	reverse_tree_info(rank, hostlist_count(hl), slurm_conf.tree_width,
+			  &parent_rank, &num_children, &depth, &max_depth);
+	if ((parent_rank < 0) && (num_children <= 0)) {
+		hostlist_destroy(hl);
+		return false;
+	}
+
+	if (parent) {
+		*parent = NULL;
+		if ((parent_rank >= 0) &&
+		    (name = hostlist_nth(hl, parent_rank))) {
+			*parent = xstrdup(name);
+			free(name);
+		}
+	}
+	if (children)
+		*children = num_children;
+	hostlist_destroy(hl);
+
+	return true;
+}
+
+static int _send_ctld(uint32_t job_id, char *node_name, int rc)
+{
+	slurm_msg_t msg;
+	epilog_complete_msg_t req = {
+		.job_id = job_id,
+		.return_code = rc,
+		.node_name = node_name,
+	};
+
+	slurm_msg_t_init(&msg);
+	msg.msg_type = MESSAGE_EPILOG_COMPLETE;
+	msg.data = &req;
+
+	/*
+	 * Note: No return code from message, slurmctld will resend
+	 * TERMINATE_JOB request if message send fails.
+	 */
+	if (slurm_send_only_controller_msg(&msg, working_cluster_rec) < 0) {
+		error("Unable to send epilog complete message: %m");
+		return SLURM_ERROR;
+	}
+
+	debug("JobId=%u: sent epilog complete msg for %s: rc = %d",
+	      job_id, node_name, rc);
+
+	return SLURM_SUCCESS;
+}
+
+static int _send_parent(uint32_t job_id, char *nodes, char *parent,
+			char *node_name)
+{
+	slurm_msg_t msg;
+	epilog_complete_msg_t req = {
+		.job_id = job_id,
+		.node_name = node_name,
+		.nodes = nodes,
+	};
+	int rc;
+
+	slurm_msg_t_init(&msg);
+	slurm_msg_set_r_uid(&msg, slurm_conf.slurmd_user_id);
+	msg.msg_type = MESSAGE_EPILOG_COMPLETE;
+	msg.data = &req;
+
+	if (slurm_conf_get_addr(parent, &msg.address, msg.flags)) {
+		error("%s: can't find address for host %s, check slurm.conf",
+		      __func__, parent);
+	} else if (slurm_send_recv_rc_msg_only_one(&msg, &rc, 0)) {
+		debug("%s: JobId=%u: unable to send epilog complete to %s: %m",
+		      __func__, job_id, parent);
+	} else if (rc) {
+		debug("%s: JobId=%u: %s refused epilog complete: %s",
+		      __func__, job_id, parent, slurm_strerror(rc));
+	} else {
+		debug("JobId=%u: sent epilog complete msg for %s to %s",
+		      job_id, node_name, parent);
+		return SLURM_SUCCESS;
+	}
+
+	return _send_ctld(job_id, node_name, SLURM_SUCCESS);
+}
+
+/* Wall clock in msec, as used by pthread_cond_timedwait() */
+static int64_t _now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ((int64_t) ts.tv_sec * 1000) + (ts.tv_nsec / NSEC_IN_MSEC);
+}
+
+static void _rec_free(aggr_rec_t *rec)
+{
+	FREE_NULL_HOSTLIST(rec->hl);
+	xfree(rec->nodes);
+	xfree(rec->parent);
+	xfree(rec);
+}
+
+static void *_flush_thread(void *arg)
+{
+	aggr_rec_t *rec = arg;
+	char *node_name;
+
+	slurm_mutex_lock(&aggr_mutex);
+	while (!aggr_shutdown && (hostlist_count(rec->hl) < rec->expect) &&
+	       (_now_ms() < rec->deadline)) {
+		struct timespec ts = {
+			.tv_sec = rec->deadline / 1000,
+			.tv_nsec = (rec->deadline % 1000) * NSEC_IN_MSEC,
+		};
+
+		slurm_cond_timedwait(&aggr_cond, &aggr_mutex, &ts);
+	}
+	list_delete_ptr(aggr_list, rec);
+	slurm_mutex_unlock(&aggr_mutex);
+
+	node_name = hostlist_ranged_string_xmalloc(rec->hl);
+	debug2("JobId=%u: collected epilog complete of %d of %d nodes",
+	       rec->job_id, hostlist_count(rec->hl), rec->expect);
+	if (rec->parent)
+		(void) _send_parent(rec->job_id, rec->nodes, rec->parent,
+				    node_name);
+	else
+		(void) _send_ctld(rec->job_id, node_name, SLURM_SUCCESS);
+	xfree(node_name);
+	_rec_free(rec);
+
+	slurm_mutex_lock(&aggr_mutex);
+	aggr_thread_cnt--;
+	slurm_cond_broadcast(&aggr_cond);
+	slurm_mutex_unlock(&aggr_mutex);
+
+	return NULL;
+}
+
+static int _find_rec(void *x, void *key)
+{
+	aggr_rec_t *rec = x;
+
+	return (rec->job_id == *(uint32_t *) key);
+}
+
+/* Add node_name to the completions collected for job_id */
+static int _collect(uint32_t job_id, char *nodes, char *node_name)
+{
+	aggr_rec_t *rec;
+	int children;
+	char *parent = NULL;
+
+	slurm_mutex_lock(&aggr_mutex);
+	if (aggr_shutdown) {
+		slurm_mutex_unlock(&aggr_mutex);
+		return SLURM_COMMUNICATIONS_SHUTDOWN_ERROR;
+	}
+	if (!aggr_list)
+		aggr_list = list_create(NULL);
+
+	if (!(rec = list_find_first(aggr_list, _find_rec, &job_id))) {
+		if (!_tree_info(nodes, &parent, &children) || !children) {
+			slurm_mutex_unlock(&aggr_mutex);
+			xfree(parent);
+			return ESLURM_INVALID_NODE_NAME;
+		}
+		rec = xmalloc(sizeof(*rec));
+		rec->job_id = job_id;
+		rec->nodes = xstrdup(nodes);
+		rec->parent = parent;
+		rec->expect = children + 1;
+		rec->hl = hostlist_create(NULL);
+		rec->start = _now_ms();
+		list_append(aggr_list, rec);
+		aggr_thread_cnt++;
+		slurm_thread_create_detached(_flush_thread, rec);
+	}
+	hostlist_push(rec->hl, node_name);
+	hostlist_uniq(rec->hl);
+	rec->deadline = MIN(_now_ms() + AGGR_WINDOW,
+			    rec->start + AGGR_MAX_WAIT);
+	slurm_cond_broadcast(&aggr_cond);
+	slurm_mutex_unlock(&aggr_mutex);
+
+	return SLURM_SUCCESS;
+}
+
+extern bool epilog_aggr_enabled(char *nodes)
+{
+	return _tree_info(nodes, NULL, NULL);
+}
+
+extern int epilog_aggr_send(uint32_t job_id, char *nodes, int rc)
+{
+	char *parent = NULL;
+	int children = 0;
+
+	if (rc || !_tree_info(nodes, &parent, &children))
+		return _send_ctld(job_id, conf->node_name, rc);
+
+	if (children && !_collect(job_id, nodes, conf->node_name)) {
+		xfree(parent);
+		return SLURM_SUCCESS;
+	}
+
+	if (parent)
+		rc = _send_parent(job_id, nodes, parent, conf->node_name);
+	else
+		rc = _send_ctld(job_id, conf->node_name, SLURM_SUCCESS);
+	xfree(parent);
+
+	return rc;
+}
+
+extern int epilog_aggr_recv(epilog_complete_msg_t *req)
+{
+	return _collect(req->job_id, req->nodes, req->node_name);
+}
+
+extern void epilog_aggr_fini(void)
+{
+	slurm_mutex_lock(&aggr_mutex);
+	aggr_shutdown = true;
+	slurm_cond_broadcast(&aggr_cond);
+	while (aggr_thread_cnt)
+		slurm_cond_wait(&aggr_cond, &aggr_mutex);
+	FREE_NULL_LIST(aggr_list);
+	slurm_mutex_unlock(&aggr_mutex);
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************\
+ *  epilog_aggr.h - collect epilog completions of a job along its reverse tree
+ *****************************************************************************
+ *  Copyright (C) SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _EPILOG_AGGR_H
+#define _EPILOG_AGGR_H
+
+#include "src/common/slurm_protocol_defs.h"
+
+/*
+ * Return true if epilog completions of a job running on nodes are collected
+ * through the job's reverse tree instead of being sent by each node.
+ */
+extern bool epilog_aggr_enabled(char *nodes);
+
+/*
+ * Report that the epilog of job_id completed on this node.
+ * Failures are sent straight to slurmctld. Successes are sent to this node's
+ * parent in the reverse tree of nodes, or collected here first if this node
+ * has children of its own.
+ * RET SLURM_SUCCESS or SLURM_ERROR if the message could not be sent
+ */
+extern int epilog_aggr_send(uint32_t job_id, char *nodes, int rc);
+
+/*
+ * Handle MESSAGE_EPILOG_COMPLETE sent by a child in the reverse tree.
+ * RET SLURM_SUCCESS or error if the completions were not accepted
+ */
+extern int epilog_aggr_recv(epilog_complete_msg_t *req);
+
+/* Send all completions collected so far, called at slurmd shutdown */
+extern void epilog_aggr_fini(void);
+
+#endif
@@ -103,6 +103,8 @@
 
 #include "src/bcast/file_bcast.h"
 
+#include "src/slurmd/slurmd/bcast_cache.h"
+#include "src/slurmd/slurmd/epilog_aggr.h"
 #include "src/slurmd/slurmd/cred_context.h"
 #include "src/slurmd/slurmd/get_mach_stat.h"
 #include "src/slurmd/slurmd/slurmd.h"
@@ -202,6 +204,7 @@ static void _rpc_health_check(slurm_msg_t *);
 static void _rpc_acct_gather_update(slurm_msg_t *);
 static void _rpc_acct_gather_energy(slurm_msg_t *);
 static void _rpc_step_complete(slurm_msg_t *msg);
+static void _rpc_epilog_complete(slurm_msg_t *msg);
 static void _rpc_stat_jobacct(slurm_msg_t *msg);
 static void _rpc_list_pids(slurm_msg_t *msg);
 static void _rpc_daemon_status(slurm_msg_t *msg);
@@ -228,6 +231,8 @@ static uid_t _get_job_uid(uint32_t jobid);
 
 static int  _add_starting_step(uint16_t type, void *req);
 static int  _remove_starting_step(uint16_t type, void *req);
+static int  _start_slurmstepd(uint16_t type, void *req, int *to_stepd_fd,
+			      int *to_slurmd_fd);
 static int  _compare_starting_steps(void *s0, void *s1);
 static int  _wait_for_starting_step(slurm_step_id_t *step_id);
 static bool _step_is_starting(slurm_step_id_t *step_id);
@@ -400,6 +405,9 @@ slurmd_req(slurm_msg_t *msg)
 	case REQUEST_STEP_COMPLETE:
 		_rpc_step_complete(msg);
 		break;
+	case MESSAGE_EPILOG_COMPLETE:
+		_rpc_epilog_complete(msg);
+		break;
 	case REQUEST_JOB_STEP_STAT:
 		_rpc_stat_jobacct(msg);
 		break;
@@ -472,6 +480,28 @@ rwfail:
 	return (-1);
 }
 
+/*
+ * Send the part of the slurmstepd initialization data which is the same for
+ * every step. The slurmstepd loads its plugins once it has received this.
+ */
+static int _send_slurmstepd_conf(int fd)
+{
+	/* send conf over to slurmstepd */
+	if (send_slurmd_conf_lite(fd, conf)) {
+		error("%s: send_slurmd_conf_lite(%d) failed: %m", __func__, fd);
+		return errno;
+	}
+
+	/* send conf_hashtbl */
+	if (read_conf_send_stepd(fd)) {
+		error("%s: read_conf_send_stepd(%d) failed: %m", __func__, fd);
+		return errno;
+	}
+
+	return 0;
+}
+
+/* Send the rest of the initialization data, specific to this step */
 static int
 _send_slurmstepd_init(int fd, int type, void *req, slurm_addr_t *cli,
 		      hostlist_t *step_hset, uint16_t protocol_version)
@@ -486,18 +516,6 @@ _send_slurmstepd_init(int fd, int type, void *req, slurm_addr_t *cli,
 
 	slurm_msg_t_init(&msg);
 
-	/* send conf over to slurmstepd */
-	if (send_slurmd_conf_lite(fd, conf)) {
-		error("%s: send_slurmd_conf_lite(%d) failed: %m", __func__, fd);
-		goto fail;
-	}
-
-	/* send conf_hashtbl */
-	if (read_conf_send_stepd(fd)) {
-		error("%s: read_conf_send_stepd(%d) failed: %m", __func__, fd);
-		goto fail;
-	}
-
 	/* send type over to slurmstepd */
 	safe_write(fd, &type, sizeof(int));
 
@@ -668,108 +686,298 @@ fail:
 
 
 /*
- * Fork and exec the slurmstepd, then send the slurmstepd its
- * initialization data.  Then wait for slurmstepd to send an "ok"
- * message before returning.  When the "ok" message is received,
+ * Pool of slurmstepds started ahead of launch requests, see
+ * LaunchParameters=slurmstepd_pool. A pooled slurmstepd has been sent
+ * _send_slurmstepd_conf() and has loaded its plugins, it waits for the rest of
+ * its initialization data. Closing its pipes makes it exit.
+ */
+typedef struct {
+	int to_stepd;		/* write end of the slurmstepd's stdin */
+	int to_slurmd;		/* read end of the slurmstepd's stdout */
+} stepd_pool_ent_t;
+
+static pthread_mutex_t stepd_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static list_t *stepd_pool = NULL;
+static int stepd_pool_size = -1;
+static uint32_t stepd_pool_gen = 0;	/* incremented by every purge */
+static bool stepd_pool_filling = false;
+
+static void _stepd_pool_ent_free(void *x)
+{
+	stepd_pool_ent_t *ent = x;
+
+	if (!ent)
+		return;
+	(void) close(ent->to_stepd);
+	(void) close(ent->to_slurmd);
+	xfree(ent);
+}
+
+static void *_stepd_pool_fill_thread(void *arg)
+{
+	stepd_pool_ent_t *ent;
+	int to_stepd, to_slurmd;
+	uint32_t gen;
+
+	while (true) {
+		slurm_mutex_lock(&stepd_pool_mutex);
+		if (list_count(stepd_pool) >= stepd_pool_size) {
+			stepd_pool_filling = false;
+			slurm_mutex_unlock(&stepd_pool_mutex);
+			return NULL;
+		}
+		gen = stepd_pool_gen;
+		slurm_mutex_unlock(&stepd_pool_mutex);
+
+		if (_start_slurmstepd(0, NULL, &to_stepd, &to_slurmd))
+			break;
+		if (_send_slurmstepd_conf(to_stepd)) {
+			(void) close(to_stepd);
+			(void) close(to_slurmd);
+			break;
+		}
+
+		ent = xmalloc(sizeof(*ent));
+		ent->to_stepd = to_stepd;
+		ent->to_slurmd = to_slurmd;
+
+		slurm_mutex_lock(&stepd_pool_mutex);
+		if (gen == stepd_pool_gen) {
+			list_append(stepd_pool, ent);
+			ent = NULL;
+		}
+		slurm_mutex_unlock(&stepd_pool_mutex);
+
+		/* The pool was purged while this slurmstepd was starting */
+		_stepd_pool_ent_free(ent);
+	}
+
+	error("%s: unable to start a pooled slurmstepd", __func__);
+	slurm_mutex_lock(&stepd_pool_mutex);
+	stepd_pool_filling = false;
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	return NULL;
+}
+
+/* Start slurmstepds in the background until the pool is full */
+static void _stepd_pool_fill(void)
+{
+	slurm_mutex_lock(&stepd_pool_mutex);
+	if (stepd_pool_size < 0) {
+		stepd_pool_size = 0;
+		/* Under valgrind every slurmstepd is started for its step */
+#if (SLURMSTEPD_MEMCHECK == 0)
+		char *tmp = conf_get_opt_str(slurm_conf.launch_params,
+					     "slurmstepd_pool=");
+
+		if (tmp && ((stepd_pool_size = atoi(tmp)) < 0)) {
+			error("Invalid LaunchParameters slurmstepd_pool=%s",
+			      tmp);
+			stepd_pool_size = 0;
+		}
+		xfree(tmp);
+#endif
+		if (stepd_pool_size)
+			debug("%s: keeping %d slurmstepds ready for launch",
+			      __func__, stepd_pool_size);
+		stepd_pool = list_create(_stepd_pool_ent_free);
+	}
+
+	if (!stepd_pool_filling &&
+	    (list_count(stepd_pool) < stepd_pool_size)) {
+		stepd_pool_filling = true;
+		slurm_thread_create_detached(_stepd_pool_fill_thread, NULL);
+	}
+	slurm_mutex_unlock(&stepd_pool_mutex);
+}
+
+/* Take a slurmstepd from the pool, RET false if the pool is empty */
+static bool _stepd_pool_get(int *to_stepd, int *to_slurmd)
+{
+	stepd_pool_ent_t *ent = NULL;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	if (stepd_pool)
+		ent = list_pop(stepd_pool);
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	if (!ent)
+		return false;
+
+	*to_stepd = ent->to_stepd;
+	*to_slurmd = ent->to_slurmd;
+	xfree(ent);
+
+	return true;
+}
+
+extern void slurmstepd_pool_purge(void)
+{
+	bool refill;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	stepd_pool_gen++;
+	if ((refill = (stepd_pool && list_count(stepd_pool)))) {
+		debug("%s: stopping %d pooled slurmstepds",
+		      __func__, list_count(stepd_pool));
+		list_flush(stepd_pool);
+	}
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	if (refill)
+		_stepd_pool_fill();
+}
+
+/*
+ * Get a slurmstepd from the pool or fork and exec a new one, then send the
+ * slurmstepd its initialization data.  Then wait for slurmstepd to send an
+ * "ok" message before returning.  When the "ok" message is received,
  * the slurmstepd has created and begun listening on its unix
  * domain socket.
+ */
+static int
+_forkexec_slurmstepd(uint16_t type, void *req, slurm_addr_t *cli,
+		      hostlist_t *step_hset, uint16_t protocol_version)
+{
+	int to_stepd = -1, to_slurmd = -1;
+	int rc = SLURM_SUCCESS;
+	bool pooled;
+#if (SLURMSTEPD_MEMCHECK == 0)
+	int i;
+	time_t start_time = time(NULL);
+#endif
+
+	if (_add_starting_step(type, req)) {
+		error("%s: failed in _add_starting_step: %m", __func__);
+		return SLURM_ERROR;
+	}
+
+	/*
+	 * A pooled slurmstepd may have died since it was started, which
+	 * makes the first write to it fail. Start a new one in that case.
+	 */
+	if ((pooled = _stepd_pool_get(&to_stepd, &to_slurmd)) &&
+	    _send_slurmstepd_init(to_stepd, type, req, cli, step_hset,
+				  protocol_version)) {
+		info("%s: pooled slurmstepd is gone, starting a new one",
+		     __func__);
+		(void) close(to_stepd);
+		(void) close(to_slurmd);
+		pooled = false;
+	}
+
+	if (!pooled) {
+		if (_start_slurmstepd(type, req, &to_stepd, &to_slurmd)) {
+			_remove_starting_step(type, req);
+			return SLURM_ERROR;
+		}
+
+		/*
+		 * Send initialization data to the slurmstepd over the
+		 * to_stepd pipe, and wait for the return code reply on the
+		 * to_slurmd pipe.
+		 */
+		if ((rc = _send_slurmstepd_conf(to_stepd)) ||
+		    (rc = _send_slurmstepd_init(to_stepd, type, req, cli,
+						step_hset,
+						protocol_version))) {
+			error("Unable to init slurmstepd");
+			goto done;
+		}
+	}
+
+	/* If running under valgrind/memcheck, this pipe doesn't work
+	 * correctly so just skip it. */
+#if (SLURMSTEPD_MEMCHECK == 0)
+	i = read(to_slurmd, &rc, sizeof(int));
+	if (i < 0) {
+		error("%s: Can not read return code from slurmstepd "
+		      "got %d: %m", __func__, i);
+		rc = SLURM_ERROR;
+	} else if (i != sizeof(int)) {
+		error("%s: slurmstepd failed to send return code "
+		      "got %d: %m", __func__, i);
+		rc = SLURM_ERROR;
+	} else {
+		int delta_time = time(NULL) - start_time;
+		int cc;
+		if (delta_time > 5) {
+			warning("slurmstepd startup took %d sec, possible file system problem or full memory",
+				delta_time);
+		}
+		if (rc != SLURM_SUCCESS)
+			error("slurmstepd return code %d: %s",
+			      rc, slurm_strerror(rc));
+
+		cc = SLURM_SUCCESS;
+		cc = write(to_stepd, &cc, sizeof(int));
+		if (cc != sizeof(int)) {
+			error("%s: failed to send ack to stepd %d: %m",
+			      __func__, cc);
+		}
+	}
+#endif
+done:
+	if (_remove_starting_step(type, req))
+		error("Error cleaning up starting_step list");
+
+	if (close(to_stepd) < 0)
+		error("close write to_stepd in parent: %m");
+	if (close(to_slurmd) < 0)
+		error("close read to_slurmd in parent: %m");
+
+	/* Replace the slurmstepd taken from the pool, or fill it up */
+	_stepd_pool_fill();
+
+	return rc;
+}
+
+/*
+ * Fork and exec a slurmstepd, return the write end of a pipe to its stdin
+ * in to_stepd_fd and the read end of a pipe from its stdout in to_slurmd_fd.
  *
  * Note that this code forks twice and it is the grandchild that
  * becomes the slurmstepd process, so the slurmstepd's parent process
  * will be init, not slurmd.
  */
-static int
-_forkexec_slurmstepd(uint16_t type, void *req, slurm_addr_t *cli,
-		      hostlist_t *step_hset, uint16_t protocol_version)
+static int _start_slurmstepd(uint16_t type, void *req, int *to_stepd_fd,
+			     int *to_slurmd_fd)
 {
 	pid_t pid;
 	int to_stepd[2] = {-1, -1};
 	int to_slurmd[2] = {-1, -1};
 
-	if (pipe(to_stepd) < 0 || pipe(to_slurmd) < 0) {
+	/*
+	 * Keep our ends from leaking into other children, a pooled
+	 * slurmstepd must see EOF once slurmd closes them.
+	 */
+	if (pipe2(to_stepd, O_CLOEXEC) < 0 ||
+	    pipe2(to_slurmd, O_CLOEXEC) < 0) {
 		error("%s: pipe failed: %m", __func__);
 		return SLURM_ERROR;
 	}
 
-	if (_add_starting_step(type, req)) {
-		error("%s: failed in _add_starting_step: %m", __func__);
-		return SLURM_ERROR;
-	}
-
 	if ((pid = fork()) < 0) {
 		error("%s: fork: %m", __func__);
 		close(to_stepd[0]);
 		close(to_stepd[1]);
 		close(to_slurmd[0]);
 		close(to_slurmd[1]);
-		_remove_starting_step(type, req);
 		return SLURM_ERROR;
 	} else if (pid > 0) {
-		int rc = SLURM_SUCCESS;
-#if (SLURMSTEPD_MEMCHECK == 0)
-		int i;
-		time_t start_time = time(NULL);
-#endif
-		/*
-		 * Parent sends initialization data to the slurmstepd
-		 * over the to_stepd pipe, and waits for the return code
-		 * reply on the to_slurmd pipe.
-		 */
 		if (close(to_stepd[0]) < 0)
 			error("Unable to close read to_stepd in parent: %m");
 		if (close(to_slurmd[1]) < 0)
 			error("Unable to close write to_slurmd in parent: %m");
 
-		if ((rc = _send_slurmstepd_init(to_stepd[1], type,
-						req, cli, step_hset,
-						protocol_version)) != 0) {
-			error("Unable to init slurmstepd");
-			goto done;
-		}
-
-		/* If running under valgrind/memcheck, this pipe doesn't work
-		 * correctly so just skip it. */
-#if (SLURMSTEPD_MEMCHECK == 0)
-		i = read(to_slurmd[0], &rc, sizeof(int));
-		if (i < 0) {
-			error("%s: Can not read return code from slurmstepd "
-			      "got %d: %m", __func__, i);
-			rc = SLURM_ERROR;
-		} else if (i != sizeof(int)) {
-			error("%s: slurmstepd failed to send return code "
-			      "got %d: %m", __func__, i);
-			rc = SLURM_ERROR;
-		} else {
-			int delta_time = time(NULL) - start_time;
-			int cc;
-			if (delta_time > 5) {
-				warning("slurmstepd startup took %d sec, possible file system problem or full memory",
-					delta_time);
-			}
-			if (rc != SLURM_SUCCESS)
-				error("slurmstepd return code %d: %s",
-				      rc, slurm_strerror(rc));
-
-			cc = SLURM_SUCCESS;
-			cc = write(to_stepd[1], &cc, sizeof(int));
-			if (cc != sizeof(int)) {
-				error("%s: failed to send ack to stepd %d: %m",
-				      __func__, cc);
-			}
-		}
-#endif
-	done:
-		if (_remove_starting_step(type, req))
-			error("Error cleaning up starting_step list");
-
 		/* Reap child */
 		if (waitpid(pid, NULL, 0) < 0)
 			error("Unable to reap slurmd child process");
-		if (close(to_stepd[1]) < 0)
-			error("close write to_stepd in parent: %m");
-		if (close(to_slurmd[0]) < 0)
-			error("close read to_slurmd in parent: %m");
-		return rc;
+
+		*to_stepd_fd = to_stepd[1];
+		*to_slurmd_fd = to_slurmd[0];
+		return SLURM_SUCCESS;
 	} else {
 #if (SLURMSTEPD_MEMCHECK == 1)
 		/* memcheck test of slurmstepd, option #1 */
@@ -3532,6 +3740,23 @@ done:
 	slurm_send_rc_msg(msg, rc);
 }
 
+static void _rpc_epilog_complete(slurm_msg_t *msg)
+{
+	int rc;
+
+	/* only sent by the slurmd of other nodes of the job */
+	if (!_slurm_authorized_user(msg->auth_uid) &&
+	    (msg->auth_uid != slurm_conf.slurmd_user_id)) {
+		error("Security violation: epilog complete from uid %u",
+		      msg->auth_uid);
+		rc = ESLURM_USER_ID_MISSING;
+	} else {
+		rc = epilog_aggr_recv(msg->data);
+	}
+
+	slurm_send_rc_msg(msg, rc);
+}
+
 /* Get list of active jobs and steps, xfree returned value */
 static char *
 _get_step_list(void)
@@ -4133,7 +4358,7 @@ void file_bcast_init(void)
 	/* skip locks during slurmd init */
 	file_bcast_list = list_create(_free_file_bcast_info_t);
 	bcast_libdir_list = list_create(_free_libdir_rec_t);
-
+	bcast_cache_init();
 }
 
 void file_bcast_purge(void)
@@ -4141,6 +4366,7 @@ void file_bcast_purge(void)
 	slurm_rwlock_wrlock(&file_bcast_lock);
 	FREE_NULL_LIST(file_bcast_list);
 	FREE_NULL_LIST(bcast_libdir_list);
+	bcast_cache_fini();
 	/* destroying list before exit, no need to unlock */
 }
 
@@ -4226,6 +4452,11 @@ static void _rpc_file_bcast(slurm_msg_t *msg)
 		      key.uid, key.job_id, key.fname, req->block_no);
 	}
 
+	/* only the digest was sent, data must come from the local cache */
+	if ((req->flags & FILE_BCAST_DIGEST) &&
+	    (rc = bcast_cache_load(key.uid, req)))
+		goto done;
+
 	/* first block must register the file and open fd/mmap */
 	if (req->block_no == 1) {
 		if ((rc = _file_bcast_register_file(msg, cred_arg, &key))) {
@@ -4233,28 +4464,35 @@ static void _rpc_file_bcast(slurm_msg_t *msg)
 		}
 	}
 
-	slurm_rwlock_rdlock(&file_bcast_lock);
-	if (!(file_info = _bcast_lookup_file(&key))) {
-		error("No registered file transfer for uid %u file `%s`.",
+	/*
+	 * Decompress before taking the lock, blocks in flight at once are
+	 * decompressed in parallel by their RPC threads.
+	 */
+	if (bcast_decompress_data(req) < 0) {
+		error("sbcast: data decompression error for UID %u, file %s",
 		      key.uid, key.fname);
-		slurm_rwlock_unlock(&file_bcast_lock);
 		rc = SLURM_ERROR;
 		goto done;
 	}
 
-	/* now decompress file */
-	if (bcast_decompress_data(req) < 0) {
-		error("sbcast: data decompression error for UID %u, file %s",
+	slurm_rwlock_rdlock(&file_bcast_lock);
+	if (!(file_info = _bcast_lookup_file(&key))) {
+		error("No registered file transfer for uid %u file `%s`.",
 		      key.uid, key.fname);
 		slurm_rwlock_unlock(&file_bcast_lock);
 		rc = SLURM_ERROR;
 		goto done;
 	}
 
+	/*
+	 * Blocks between the first and the last may be in flight at once
+	 * and arrive in any order, so write each at its own offset.
+	 */
 	offset = 0;
 	while (req->block_len - offset) {
-		inx = write(file_info->fd, &req->block[offset],
-			    (req->block_len - offset));
+		inx = pwrite(file_info->fd, &req->block[offset],
+			     (req->block_len - offset),
+			     (req->block_offset + offset));
 		if (inx == -1) {
 			if ((errno == EINTR) || (errno == EAGAIN))
 				continue;
@@ -4293,6 +4531,9 @@ static void _rpc_file_bcast(slurm_msg_t *msg)
 
 	slurm_rwlock_unlock(&file_bcast_lock);
 
+	if (!(req->flags & FILE_BCAST_DIGEST))
+		bcast_cache_save(key.uid, req);
+
 	if (req->flags & FILE_BCAST_LAST_BLOCK) {
 		_file_bcast_close_file(&key);
 	}
@@ -4783,40 +5024,6 @@ _steps_completed_now(uint32_t jobid)
 	return rc;
 }
 
-/*
- *  Send epilog complete message to currently active controller.
- *   Returns SLURM_SUCCESS if message sent successfully,
- *           SLURM_ERROR if epilog complete message fails to be sent.
- */
-static int _epilog_complete(uint32_t jobid, int rc)
-{
-	slurm_msg_t msg;
-	epilog_complete_msg_t req;
-
-	slurm_msg_t_init(&msg);
-	memset(&req, 0, sizeof(req));
-
-	req.job_id = jobid;
-	req.return_code = rc;
-	req.node_name = conf->node_name;
-
-	msg.msg_type = MESSAGE_EPILOG_COMPLETE;
-	msg.data = &req;
-
-	/*
-	 * Note: No return code from message, slurmctld will resend
-	 * TERMINATE_JOB request if message send fails.
-	 */
-	if (slurm_send_only_controller_msg(&msg, working_cluster_rec) < 0) {
-		error("Unable to send epilog complete message: %m");
-		return SLURM_ERROR;
-	}
-
-	debug("JobId=%u: sent epilog complete msg: rc = %d", jobid, rc);
-
-	return SLURM_SUCCESS;
-}
-
 /* if a lock is granted to the job then return 1; else return 0 if
  * the lock for the job is already taken or there's no more locks */
 static int
@@ -5331,7 +5538,7 @@ _rpc_terminate_job(slurm_msg_t *msg)
 			/* The epilog complete message processing on
 			 * slurmctld is equivalent to that of a
 			 * ESLURMD_KILL_JOB_ALREADY_COMPLETE reply above */
-			_epilog_complete(req->step_id.job_id, rc);
+			epilog_aggr_send(req->step_id.job_id, req->nodes, rc);
 		}
 
 		_launch_complete_rm(req->step_id.job_id);
@@ -5416,7 +5623,7 @@ done:
 	_waiter_complete(req->step_id.job_id);
 	_sync_messages_kill(req);
 
-	_epilog_complete(req->step_id.job_id, rc);
+	epilog_aggr_send(req->step_id.job_id, req->nodes, rc);
 }
 
 /* On a parallel job, every slurmd may send the EPILOG_COMPLETE
@@ -5430,6 +5637,10 @@ static void _sync_messages_kill(kill_job_msg_t *req)
 	char *host;
 	hostset_t *hosts;
 
+	/* Only the root of the job's reverse tree messages slurmctld */
+	if (epilog_aggr_enabled(req->nodes))
+		return;
+
 	hosts = hostset_create(req->nodes);
 	host_cnt = hostset_count(hosts);
 	if (host_cnt <= 64)
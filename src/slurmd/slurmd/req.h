@@ -60,6 +60,13 @@ extern void record_launched_jobs(void);
 void file_bcast_init(void);
 void file_bcast_purge(void);
 
+/*
+ * Stop the slurmstepds started ahead of launch requests
+ * (LaunchParameters=slurmstepd_pool) and start new ones, called when the
+ * configuration or logging sent to slurmstepds changes.
+ */
+extern void slurmstepd_pool_purge(void);
+
 /*
  * ume_notify - Notify all jobs and steps on this node that a Uncorrectable
  *	Memory Error (UME) has occurred by sending SIG_UME (to log event in
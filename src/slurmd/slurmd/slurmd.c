@@ -122,6 +122,7 @@
 #include "src/slurmd/common/xcpuinfo.h"
 
 #include "src/slurmd/slurmd/cred_context.h"
+#include "src/slurmd/slurmd/epilog_aggr.h"
 #include "src/slurmd/slurmd/get_mach_stat.h"
 #include "src/slurmd/slurmd/req.h"
 #include "src/slurmd/slurmd/slurmd.h"
@@ -422,6 +423,7 @@ main (int argc, char **argv)
 	 * failure.
 	 */
 	run_command_shutdown();
+	epilog_aggr_fini();
 	_slurmd_fini();
 	_destroy_conf();
 	cred_g_fini();	/* must be after _destroy_conf() */
@@ -1250,6 +1252,9 @@ extern void build_conf_buf(void)
 		tres_packed = false;
 
 	slurm_mutex_unlock(&conf->config_mutex);
+
+	/* Pooled slurmstepds were sent the previous buffer */
+	slurmstepd_pool_purge();
 }
 
 static int _reconfig_stepd(void *x, void *y)
@@ -1281,6 +1286,9 @@ extern void update_stepd_logging(bool reconfig)
 	steps = stepd_available(conf->spooldir, conf->node_name);
 	list_for_each(steps, _reconfig_stepd, &reconfig);
 	FREE_NULL_LIST(steps);
+
+	/* Pooled slurmstepds opened the log before it changed */
+	slurmstepd_pool_purge();
 }
 
 static void _notify_parent_of_success(void)
@@ -56,6 +56,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -94,6 +95,7 @@ struct io_operations client_ops = {
 };
 
 #define CLIENT_IO_MAGIC 0x10102
+#define CLIENT_IO_MAX_IOV 64	/* queued messages written per syscall */
 struct client_io_info {
 	int                   magic;
 	stepd_step_rec_t *step; /* pointer back to step data */
@@ -425,14 +427,18 @@ _client_read(eio_obj_t *obj, List objs)
 }
 
 /*
- * Write outgoing packed messages to the client socket.
+ * Write outgoing packed messages to the client socket. Messages queued behind
+ * the current one are sent along with it in a single writev().
  */
 static int
 _client_write(eio_obj_t *obj, List objs)
 {
 	struct client_io_info *client = (struct client_io_info *) obj->arg;
-	void *buf;
-	int n;
+	struct iovec iov[CLIENT_IO_MAX_IOV];
+	struct io_buf *msg;
+	list_itr_t *itr;
+	int cnt = 1;
+	ssize_t n;
 
 	xassert(client->magic == CLIENT_IO_MAGIC);
 
@@ -455,13 +461,22 @@ _client_write(eio_obj_t *obj, List objs)
 
 	debug5("  client->out_remaining = %d", client->out_remaining);
 
+	iov[0].iov_base = client->out_msg->data +
+		(client->out_msg->length - client->out_remaining);
+	iov[0].iov_len = client->out_remaining;
+	itr = list_iterator_create(client->msg_queue);
+	while ((cnt < CLIENT_IO_MAX_IOV) && (msg = list_next(itr))) {
+		iov[cnt].iov_base = msg->data;
+		iov[cnt].iov_len = msg->length;
+		cnt++;
+	}
+	list_iterator_destroy(itr);
+
 	/*
-	 * Write message to socket.
+	 * Write messages to socket.
 	 */
-	buf = client->out_msg->data +
-		(client->out_msg->length - client->out_remaining);
 again:
-	if ((n = write(obj->fd, buf, client->out_remaining)) < 0) {
+	if ((n = writev(obj->fd, iov, cnt)) < 0) {
 		if (errno == EINTR) {
 			goto again;
 		} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
@@ -474,17 +489,17 @@ again:
 			return SLURM_SUCCESS;
 		}
 	}
-	if (n < client->out_remaining) {
-		error("Only wrote %d of %d bytes to socket",
-		      n, client->out_remaining);
-	} else
-		debug5("Wrote %d bytes to socket", n);
-	client->out_remaining -= n;
-	if (client->out_remaining > 0)
-		return SLURM_SUCCESS;
+	debug5("Wrote %zd bytes of %d messages to socket", n, cnt);
 
-	_free_outgoing_msg(client->out_msg, client->step);
-	client->out_msg = NULL;
+	/* Release the messages written completely */
+	while (n >= client->out_remaining) {
+		n -= client->out_remaining;
+		_free_outgoing_msg(client->out_msg, client->step);
+		if (!(client->out_msg = list_dequeue(client->msg_queue)))
+			return SLURM_SUCCESS;
+		client->out_remaining = client->out_msg->length;
+	}
+	client->out_remaining -= n;
 
 	return SLURM_SUCCESS;
 }
@@ -508,74 +523,54 @@ _local_file_writable(eio_obj_t *obj)
 
 
 /*
- * The slurmstepd writes I/O to a file, possibly adding a label.
+ * The slurmstepd writes I/O to a file, possibly adding a label. The output of
+ * the queued messages is gathered to write it with a single write().
  */
 static int
 _local_file_write(eio_obj_t *obj, List objs)
 {
 	struct client_io_info *client = (struct client_io_info *) obj->arg;
-	void *buf;
-	int n;
+	struct io_buf *msg;
 	io_hdr_t header;
-	buf_t *header_tmp_buf;
+	buf_t *header_tmp_buf, *out;
+	int cnt = 0;
 
 	xassert(client->magic == CLIENT_IO_MAGIC);
-	/*
-	 * If we aren't already in the middle of sending a message, get the
-	 * next message from the queue.
-	 */
-	if (client->out_msg == NULL) {
-		client->out_msg = list_dequeue(client->msg_queue);
-		if (client->out_msg == NULL) {
-			return SLURM_SUCCESS;
-		}
-		client->out_remaining = client->out_msg->length -
-					io_hdr_packed_size();
-	}
 
-	/*
-	 * This code to make a buffer, fill it, unpack its contents, and free
-	 * it is just used to read the header to get the global task id.
-	 */
-	header_tmp_buf = create_buf(client->out_msg->data,
-				    client->out_msg->length);
-	if (!header_tmp_buf) {
-		fatal("Failure to allocate memory for a message header");
-		return SLURM_ERROR;	/* Fix CLANG false positive error */
-	}
-	io_hdr_unpack(&header, header_tmp_buf);
-	header_tmp_buf->head = NULL;	/* CLANG false positive bug here */
-	FREE_NULL_BUFFER(header_tmp_buf);
-
-	/*
-	 * A zero-length message indicates the end of a stream from one
-	 * of the tasks.  Just free the message and return.
-	 */
-	if (header.length == 0) {
-		_free_outgoing_msg(client->out_msg, client->step);
-		client->out_msg = NULL;
-		return SLURM_SUCCESS;
+	out = init_buf(0);
+	while ((cnt++ < CLIENT_IO_MAX_IOV) &&
+	       (msg = list_dequeue(client->msg_queue))) {
+		/* Read the header to get the global task id */
+		header_tmp_buf = create_shadow_buf(msg->data, msg->length);
+		io_hdr_unpack(&header, header_tmp_buf);
+		FREE_NULL_BUFFER(header_tmp_buf);
+
+		/*
+		 * A zero-length message indicates the end of a stream from one
+		 * of the tasks, there is nothing to write for it.
+		 */
+		if (header.length)
+			append_labelled_message(
+				out, msg->data + io_hdr_packed_size(),
+				header.length, header.gtaskid,
+				client->step->het_job_offset,
+				client->step->het_job_task_offset,
+				client->labelio, client->taskid_width);
+		_free_outgoing_msg(msg, client->step);
 	}
 
-	/* Write the message to the file. */
-	buf = client->out_msg->data +
-		(client->out_msg->length - client->out_remaining);
-	n = write_labelled_message(obj->fd, buf, client->out_remaining,
-				   header.gtaskid, client->step->het_job_offset,
-				   client->step->het_job_task_offset,
-				   client->labelio, client->taskid_width);
-	if (n < 0) {
-		client->out_eof = true;
-		_free_all_outgoing_msgs(client->msg_queue, client->step);
-		return SLURM_ERROR;
-	}
+	/* Write the messages to the file. */
+	if (get_buf_offset(out))
+		safe_write(obj->fd, get_buf_data(out), get_buf_offset(out));
+	FREE_NULL_BUFFER(out);
 
-	client->out_remaining -= n;
-	if (client->out_remaining == 0) {
-		_free_outgoing_msg(client->out_msg, client->step);
-		client->out_msg = NULL;
-	}
 	return SLURM_SUCCESS;
+
+rwfail:
+	FREE_NULL_BUFFER(out);
+	client->out_eof = true;
+	_free_all_outgoing_msgs(client->msg_queue, client->step);
+	return SLURM_ERROR;
 }
 
 
@@ -697,6 +692,35 @@ again:
 /**********************************************************************
  * Task read functions
  **********************************************************************/
+/*
+ * Most of a task's stdout or stderr to hold, LaunchParameters=stdio_buf_size
+ * raises it so that more is read from the task at once.
+ */
+static int _task_out_buf_size(void)
+{
+	static int buf_size = 0;
+	char *tmp, *end = NULL;
+	long val;
+
+	if (buf_size)
+		return buf_size;
+
+	buf_size = MAX_MSG_LEN * 4;
+	if ((tmp = conf_get_opt_str(slurm_conf.launch_params,
+				    "stdio_buf_size="))) {
+		val = strtol(tmp, &end, 10);
+		if ((*end != '\0') || (val < buf_size) ||
+		    (val > STDIO_MAX_BUF_SIZE))
+			error("Invalid LaunchParameters stdio_buf_size=%s, using %d",
+			      tmp, buf_size);
+		else
+			buf_size = val;
+		xfree(tmp);
+	}
+
+	return buf_size;
+}
+
 /*
  * Create an eio_obj_t for handling a task's stdout or stderr traffic
  */
@@ -712,7 +736,7 @@ _create_task_out_eio(int fd, uint16_t type,
 	out->gtaskid = task->gtid;
 	out->ltaskid = task->id;
 	out->step = step;
-	out->buf = cbuf_create(MAX_MSG_LEN, MAX_MSG_LEN*4);
+	out->buf = cbuf_create(MAX_MSG_LEN, _task_out_buf_size());
 	out->eof = false;
 	out->eof_msg_sent = false;
 	if (cbuf_opt_set(out->buf, CBUF_OPT_OVERWRITE, CBUF_NO_DROP) == -1)
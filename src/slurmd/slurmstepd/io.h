@@ -50,6 +50,9 @@
 #define STDIO_MAX_FREE_BUF 1024
 #define STDIO_MAX_MSG_CACHE 128
 
+/* Largest LaunchParameters=stdio_buf_size accepted, per task and stream */
+#define STDIO_MAX_BUF_SIZE (16 * 1024 * 1024)
+
 struct io_buf {
 	int ref_count;
 	uint32_t length;
@@ -575,8 +575,43 @@ _init_from_slurmd(int sock, char **argv, slurm_addr_t **_cli,
 	/* receive conf_hashtbl from slurmd */
 	read_conf_recv_stepd(sock);
 
+	/* Init switch before unpack_msg to only init the default */
+	if (switch_init(1) != SLURM_SUCCESS)
+		fatal( "failed to initialize authentication plugin" );
+
+	if (cred_g_init() != SLURM_SUCCESS)
+		fatal("failed to initialize credential plugin");
+
+	if (gres_init() != SLURM_SUCCESS)
+		fatal("failed to initialize gres plugins");
+
+	/*
+	 * Init all plugins after receiving the slurm.conf from the slurmd.
+	 * Nothing here may depend on the step, as slurmd may start us ahead
+	 * of any launch request (LaunchParameters=slurmstepd_pool) and send
+	 * the rest only once a step is launched.
+	 */
+	if ((auth_g_init() != SLURM_SUCCESS) ||
+	    (cgroup_g_init() != SLURM_SUCCESS) ||
+	    (hash_g_init() != SLURM_SUCCESS) ||
+	    (acct_gather_conf_init() != SLURM_SUCCESS) ||
+	    (proctrack_g_init() != SLURM_SUCCESS) ||
+	    (slurmd_task_init() != SLURM_SUCCESS) ||
+	    (jobacct_gather_init() != SLURM_SUCCESS) ||
+	    (acct_gather_profile_init() != SLURM_SUCCESS) ||
+	    (job_container_init() != SLURM_SUCCESS) ||
+	    (topology_g_init() != SLURM_SUCCESS))
+		fatal("Couldn't load all plugins");
+
 	/* receive job type from slurmd */
-	safe_read(sock, &step_type, sizeof(int));
+	if (!(len = read(sock, &step_type, sizeof(int)))) {
+		/* slurmd dropped us from its pool of slurmstepds */
+		debug2("%s: slurmd closed the pipe before any launch",
+		       __func__);
+		exit(0);
+	} else if (len != sizeof(int)) {
+		goto rwfail;
+	}
 	debug3("step_type = %d", step_type);
 
 	/* receive reverse-tree info from slurmd */
@@ -642,16 +677,6 @@ _init_from_slurmd(int sock, char **argv, slurm_addr_t **_cli,
 		break;
 	}
 
-	/* Init switch before unpack_msg to only init the default */
-	if (switch_init(1) != SLURM_SUCCESS)
-		fatal( "failed to initialize authentication plugin" );
-
-	if (cred_g_init() != SLURM_SUCCESS)
-		fatal("failed to initialize credential plugin");
-
-	if (gres_init() != SLURM_SUCCESS)
-		fatal("failed to initialize gres plugins");
-
 	if (unpack_msg(msg, buffer) == SLURM_ERROR)
 		fatal("slurmstepd: we didn't unpack the request correctly");
 	FREE_NULL_BUFFER(buffer);
@@ -674,21 +699,6 @@ _init_from_slurmd(int sock, char **argv, slurm_addr_t **_cli,
 
 	_set_job_log_prefix(&step_id);
 
-	/*
-	 * Init all plugins after receiving the slurm.conf from the slurmd.
-	 */
-	if ((auth_g_init() != SLURM_SUCCESS) ||
-	    (cgroup_g_init() != SLURM_SUCCESS) ||
-	    (hash_g_init() != SLURM_SUCCESS) ||
-	    (acct_gather_conf_init() != SLURM_SUCCESS) ||
-	    (proctrack_g_init() != SLURM_SUCCESS) ||
-	    (slurmd_task_init() != SLURM_SUCCESS) ||
-	    (jobacct_gather_init() != SLURM_SUCCESS) ||
-	    (acct_gather_profile_init() != SLURM_SUCCESS) ||
-	    (job_container_init() != SLURM_SUCCESS) ||
-	    (topology_g_init() != SLURM_SUCCESS))
-		fatal("Couldn't load all plugins");
-
 	/*
 	 * Receive all secondary conf files from the slurmd.
 	 */
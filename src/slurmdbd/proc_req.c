@@ -3172,6 +3172,13 @@ static int _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 
 	list_msg.my_list = list_create(slurmdbd_free_buffer);
 	/* START_TIMER; */
+
+	/*
+	 * Run all of the messages in one transaction instead of committing
+	 * after every one of them.  proc_req() will do the commit once this
+	 * DBD_SEND_MULT_MSG is done.
+	 */
+	slurmdbd_conn->in_mult_msg = true;
 	itr = list_iterator_create(get_msg->my_list);
 	while ((req_buf = list_next(itr))) {
 		persist_msg_t sub_msg;
@@ -3194,6 +3201,7 @@ static int _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 			break;
 	}
 	list_iterator_destroy(itr);
+	slurmdbd_conn->in_mult_msg = false;
 	/* END_TIMER; */
 	/* info("%d multi took %s", list_count(get_msg->my_list), TIME_STR); */
 
@@ -3719,12 +3727,15 @@ extern int proc_req(void *conn, persist_msg_t *msg, buf_t **out_buffer)
 		      slurmdbd_conn->conn->fd,
 		      slurmdbd_msg_type_2_str(msg->msg_type, 1));
 	else if (slurmdbd_conn->conn->rem_port &&
+		 !slurmdbd_conn->in_mult_msg &&
 		 (!slurmdbd_conf->commit_delay ||
 		  (msg->msg_type == DBD_REGISTER_CTLD))) {
 		/* If we are dealing with the slurmctld do the
 		   commit (SUCCESS or NOT) afterwards since we
 		   do transactions for performance reasons.
 		   (don't ever use autocommit with innodb)
+		   Messages of a DBD_SEND_MULT_MSG are committed
+		   together once all of them have been processed.
 		*/
 		acct_storage_g_commit(slurmdbd_conn->db_conn, 1);
 	}
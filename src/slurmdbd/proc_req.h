@@ -47,6 +47,8 @@ typedef struct {
 	slurm_persist_conn_t *conn;
 	slurm_persist_conn_t *conn_send;
 	void *db_conn; /* database connection */
+	bool in_mult_msg; /* processing a DBD_SEND_MULT_MSG, which is
+			   * committed as a single transaction */
 	char *tres_str;
 } slurmdbd_conn_t;
 
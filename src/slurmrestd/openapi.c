@@ -33,10 +33,14 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <pthread.h>
+
 #include "src/common/data.h"
+#include "src/common/macros.h"
 #include "src/common/plugrack.h"
 #include "src/common/read_config.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -99,6 +103,32 @@ typedef struct {
 	int tag;
 } path_t;
 
+/*
+ * Routing tree of the registered paths. Each node is one directory of a path.
+ * Literal entries are hashed by string while all parameter entries at the same
+ * depth share a single child since their types are only checked on the
+ * candidates found at the end of the walk.
+ */
+#define MAGIC_PATH_NODE 0x1a0b39fe
+typedef struct path_node_s path_node_t;
+struct path_node_s {
+	int magic; /* MAGIC_PATH_NODE */
+	char *entry; /* literal entry or NULL for parameter */
+	xhash_t *children; /* path_node_t of literal entries */
+	path_node_t *param; /* child for any parameter entry */
+	list_t *routes; /* list of route_t ending at this node */
+};
+
+typedef struct {
+	path_t *path;
+	entry_method_t *method;
+} route_t;
+
+typedef struct {
+	http_request_method_t method;
+	list_t *found;
+} find_routes_t;
+
 typedef struct {
 	entry_method_t *method;
 	entry_t *entries;
@@ -171,6 +201,8 @@ typedef struct {
 } openapi_spec_t;
 
 static list_t *paths = NULL;
+static pthread_rwlock_t routes_lock = PTHREAD_RWLOCK_INITIALIZER;
+static path_node_t *routes = NULL;
 static int path_tag_counter = 0;
 static data_t **specs = NULL;
 static openapi_spec_flags_t *spec_flags = NULL;
@@ -850,6 +882,118 @@ static void _check_openapi_path_binding(const openapi_path_binding_t *op_path)
 #endif /* !NDEBUG */
 }
 
+static void _path_node_id(void *item, const char **key, uint32_t *key_len)
+{
+	path_node_t *node = item;
+
+	xassert(node->magic == MAGIC_PATH_NODE);
+
+	*key = node->entry;
+	*key_len = strlen(node->entry);
+}
+
+static path_node_t *_new_path_node(const char *entry)
+{
+	path_node_t *node = xmalloc(sizeof(*node));
+
+	node->magic = MAGIC_PATH_NODE;
+	node->entry = xstrdup(entry);
+
+	return node;
+}
+
+static void _free_path_node(void *x)
+{
+	path_node_t *node = x;
+
+	if (!node)
+		return;
+
+	xassert(node->magic == MAGIC_PATH_NODE);
+
+	if (node->children)
+		xhash_free(node->children);
+	_free_path_node(node->param);
+	FREE_NULL_LIST(node->routes);
+	xfree(node->entry);
+	node->magic = ~MAGIC_PATH_NODE;
+	xfree(node);
+}
+
+/* Add every method of path to the routing tree */
+static void _add_routes(path_t *path)
+{
+	slurm_rwlock_wrlock(&routes_lock);
+
+	if (!routes)
+		routes = _new_path_node(NULL);
+
+	for (entry_method_t *method = path->methods; method->entries;
+	     method++) {
+		path_node_t *node = routes;
+		route_t *route;
+
+		for (entry_t *e = method->entries; e->type; e++) {
+			path_node_t *child;
+
+			if (e->type == OPENAPI_PATH_ENTRY_MATCH_PARAMETER) {
+				if (!node->param)
+					node->param = _new_path_node(NULL);
+				node = node->param;
+				continue;
+			}
+
+			if (!node->children)
+				node->children = xhash_init(_path_node_id,
+							    _free_path_node);
+			if (!(child = xhash_get_str(node->children, e->entry))) {
+				child = _new_path_node(e->entry);
+				xhash_add(node->children, child);
+			}
+			node = child;
+		}
+
+		route = xmalloc(sizeof(*route));
+		route->path = path;
+		route->method = method;
+
+		if (!node->routes)
+			node->routes = list_create(xfree_ptr);
+		list_append(node->routes, route);
+	}
+
+	slurm_rwlock_unlock(&routes_lock);
+}
+
+static int _match_route_tag(void *x, void *arg)
+{
+	route_t *route = x;
+	const int tag = *(int *) arg;
+
+	return (route->path->tag == tag);
+}
+
+static void _remove_routes(path_node_t *node, int *tag_ptr);
+
+static void _remove_child_routes(void *item, void *arg)
+{
+	_remove_routes(item, arg);
+}
+
+static void _remove_routes(path_node_t *node, int *tag_ptr)
+{
+	if (!node)
+		return;
+
+	xassert(node->magic == MAGIC_PATH_NODE);
+
+	if (node->routes)
+		list_delete_all(node->routes, _match_route_tag, tag_ptr);
+	if (node->children)
+		xhash_walk(node->children, _remove_child_routes, tag_ptr);
+	_remove_routes(node->param, tag_ptr);
+}
+
 extern int register_path_binding(const char *in_path,
 				 const openapi_path_binding_t *op_path,
 				 const openapi_resp_meta_t *meta,
@@ -918,6 +1062,7 @@ extern int register_path_binding(const char *in_path,
 		}
 	}
 
+	_add_routes(p);
 	list_append(paths, p);
 	return tag;
 }
@@ -958,6 +1103,7 @@ extern int register_path_tag(const char *str_path)
 	if (data_dict_for_each_const(spec_entry, _populate_methods, &args) < 0)
 		fatal("%s: _populate_methods() failed", __func__);
 
+	_add_routes(path);
 	list_append(paths, path);
 
 	rc = path->tag;
@@ -986,6 +1132,10 @@ static int _rm_path_by_tag(void *x, void *tptr)
 
 extern void unregister_path_tag(int tag)
 {
+	slurm_rwlock_wrlock(&routes_lock);
+	_remove_routes(routes, &tag);
+	slurm_rwlock_unlock(&routes_lock);
+
 	list_delete_all(paths, _rm_path_by_tag, &tag);
 }
 
@@ -1116,68 +1266,35 @@ static char *_entry_to_string(entry_t *entry)
 	return path;
 }
 
-static int _match_path_from_data(void *x, void *key)
+static int _match_route(void *x, void *key)
 {
 	char *dst_path = NULL, *src_path = NULL;
 	match_path_from_data_t *args = key;
-	path_t *path = x;
-	entry_method_t *method;
+	route_t *route = x;
+	path_t *path = route->path;
 	bool matched = false;
 
 	xassert(path->magic == MAGIC_PATH);
+	xassert(route->method->method == args->method);
 
 	if (get_log_level() >= LOG_LEVEL_DEBUG5) {
 		serialize_g_data_to_string(&dst_path, NULL, args->dpath,
 					   MIME_TYPE_JSON, SER_FLAGS_COMPACT);
+		src_path = _entry_to_string(route->method->entries);
 	}
 
 	args->path = path;
-	for (method = path->methods; method->entries; method++) {
-		int entries = 0;
+	args->entry = route->method->entries;
 
-		if (get_log_level() >= LOG_LEVEL_DEBUG5) {
-			xfree(src_path);
-			src_path = _entry_to_string(method->entries);
-		}
-
-		if (args->method != method->method) {
-			debug5("%s: method skip for %s(%d, %s != %s) to %s(0x%"PRIXPTR")",
-			       __func__, src_path, args->path->tag,
-			       get_http_method_string(args->method),
-			       get_http_method_string(method->method),
-			       dst_path, (uintptr_t) args->dpath);
-			continue;
-		}
-
-		for (args->entry = method->entries; args->entry->type;
-		     entries++, args->entry++)
-			/* do nothing */;
-
-		if (data_get_list_length(args->dpath) != entries) {
-			debug5("%s: skip non-matching subdirectories: registered=%u requested=%zu ",
-			       __func__, entries,
-			       data_get_list_length(args->dpath));
-			continue;
-		}
-
-		args->entry = method->entries;
-		if (data_list_for_each_const(args->dpath, _match_path,
-					     args) < 0) {
-			debug5("%s: match failed %s",
-			       __func__, args->entry->entry);
-			continue;
-		}
-
-		/*
-		 * The list is NULL terminated, so if entry->type is not NULL
-		 * we didn't match the whole list, but we already don't have
-		 * anything to compare in request.
-		 */
-		if (!args->entry->type) {
-			args->tag = path->tag;
-			matched = true;
-			break;
-		}
+	/*
+	 * Routing tree already matched the literal entries and the number of
+	 * entries so this only checks parameter types and populates params.
+	 */
+	if (data_list_for_each_const(args->dpath, _match_path, args) < 0) {
+		debug5("%s: match failed %s", __func__, args->entry->entry);
+	} else if (!args->entry->type) {
+		args->tag = path->tag;
+		matched = true;
 	}
 
 	debug5("%s: match %s for %s(%d, %s) to %s(0x%"PRIXPTR")",
@@ -1195,6 +1312,61 @@ static int _match_path_from_data(void *x, void *key)
 	return matched;
 }
 
+static int _foreach_found_route(void *x, void *arg)
+{
+	route_t *route = x;
+	find_routes_t *args = arg;
+
+	if (route->method->method == args->method)
+		list_append(args->found, route);
+
+	return SLURM_SUCCESS;
+}
+
+/* Walk routing tree to find every route of method with a matching shape */
+static void _find_routes(const path_node_t *node, const data_t **dirs,
+			 size_t count, find_routes_t *args)
+{
+	xassert(node->magic == MAGIC_PATH_NODE);
+
+	if (!count) {
+		if (node->routes)
+			(void) list_for_each_ro(node->routes,
+						_foreach_found_route, args);
+		return;
+	}
+
+	if (node->children && (data_get_type(dirs[0]) == DATA_TYPE_STRING)) {
+		const path_node_t *child =
+			xhash_get_str(node->children,
+				      data_get_string_const(dirs[0]));
+
+		if (child)
+			_find_routes(child, (dirs + 1), (count - 1), args);
+	}
+
+	if (node->param)
+		_find_routes(node->param, (dirs + 1), (count - 1), args);
+}
+
+static data_for_each_cmd_t _foreach_collect_dir(const data_t *data, void *arg)
+{
+	const data_t ***dirs_ptr = arg;
+
+	**dirs_ptr = data;
+	(*dirs_ptr)++;
+
+	return DATA_FOR_EACH_CONT;
+}
+
+static int _sort_route_by_tag(void *x, void *y)
+{
+	const route_t *rx = *(route_t **) x;
+	const route_t *ry = *(route_t **) y;
+
+	return (rx->path->tag - ry->path->tag);
+}
+
 extern int find_path_tag(const data_t *dpath, data_t *params,
 			 http_request_method_t method)
 {
@@ -1204,11 +1376,32 @@ extern int find_path_tag(const data_t *dpath, data_t *params,
 		.method = method,
 		.tag = -1,
 	};
+	find_routes_t find_args = {
+		.method = method,
+	};
+	const size_t count = data_get_list_length(dpath);
+	const data_t **dirs = xcalloc((count + 1), sizeof(*dirs));
+	const data_t **itr = dirs;
 
 	xassert(data_get_type(params) == DATA_TYPE_DICT);
 
-	(void) list_find_first(paths, _match_path_from_data, &args);
+	(void) data_list_for_each_const(dpath, _foreach_collect_dir, &itr);
+	find_args.found = list_create(NULL);
 
+	slurm_rwlock_rdlock(&routes_lock);
+
+	if (routes)
+		_find_routes(routes, dirs, count, &find_args);
+
+	/* first registered path wins when multiple paths match */
+	if (list_count(find_args.found) > 1)
+		list_sort(find_args.found, _sort_route_by_tag);
+	(void) list_find_first(find_args.found, _match_route, &args);
+
+	slurm_rwlock_unlock(&routes_lock);
+
+	FREE_NULL_LIST(find_args.found);
+	xfree(dirs);
 	return args.tag;
 }
 
@@ -1348,6 +1541,12 @@ extern void destroy_openapi(void)
 	}
 
 	FREE_NULL_PLUGINS(plugins);
+
+	slurm_rwlock_wrlock(&routes_lock);
+	_free_path_node(routes);
+	routes = NULL;
+	slurm_rwlock_unlock(&routes_lock);
+
 	FREE_NULL_LIST(paths);
 	xfree(specs);
 	xfree(spec_flags);
@@ -2248,7 +2447,9 @@ extern int wrap_openapi_ctxt_callback(const char *context_id,
 				      int tag, data_t *resp, void *auth,
 				      data_parser_t *parser,
 				      const openapi_path_binding_t *op_path,
-				      const openapi_resp_meta_t *plugin_meta)
+				      const openapi_resp_meta_t *plugin_meta,
+				      time_t if_none_match,
+				      time_t *last_update_ptr)
 {
 	int rc;
 	openapi_ctxt_t ctxt = {
@@ -2258,6 +2459,7 @@ extern int wrap_openapi_ctxt_callback(const char *context_id,
 		.query = query,
 		.resp = resp,
 		.tag = tag,
+		.if_none_match = if_none_match,
 	};
 	openapi_resp_meta_t query_meta = {{0}};
 	openapi_ctxt_handler_t callback = op_path->callback;
@@ -2305,6 +2507,8 @@ extern int wrap_openapi_ctxt_callback(const char *context_id,
 	if (!rc)
 		rc = ctxt.rc;
 
+	*last_update_ptr = ctxt.last_update;
+
 	FREE_NULL_LIST(ctxt.errors);
 	FREE_NULL_LIST(ctxt.warnings);
 	FREE_NULL_DATA_PARSER(ctxt.parser);
@@ -62,6 +62,10 @@ typedef struct {
 	data_t *resp;
 	data_t *parent_path;
 	int tag;
+	/* last_update from client's If-None-Match ETag or 0 */
+	time_t if_none_match;
+	/* last_update of dumped data to send as ETag or 0 */
+	time_t last_update;
 } openapi_ctxt_t;
 
 /*
@@ -204,14 +208,20 @@ extern void destroy_openapi(void);
  */
 extern void *openapi_get_db_conn(void *ctxt);
 
-/* Wraps ctxt callback to apply standardised response schema */
+/*
+ * Wraps ctxt callback to apply standardised response schema
+ * IN if_none_match - last_update parsed from client's ETag or 0
+ * OUT last_update_ptr - populated with last_update of dumped data or 0
+ */
 extern int wrap_openapi_ctxt_callback(const char *context_id,
 				      http_request_method_t method,
 				      data_t *parameters, data_t *query,
 				      int tag, data_t *resp, void *auth,
 				      data_parser_t *parser,
 				      const openapi_path_binding_t *op_path,
-				      const openapi_resp_meta_t *plugin_meta);
+				      const openapi_resp_meta_t *plugin_meta,
+				      time_t if_none_match,
+				      time_t *last_update_ptr);
 
 /*
  * Macro to make a single response dumping easy
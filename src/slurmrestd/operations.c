@@ -42,6 +42,7 @@
 #include "src/common/list.h"
 #include "src/common/log.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 #include "src/interfaces/serializer.h"
@@ -51,12 +52,15 @@
 
 static pthread_rwlock_t paths_lock = PTHREAD_RWLOCK_INITIALIZER;
 static List paths = NULL;
+static xhash_t *path_tags = NULL; /* index of paths by tag */
 static data_parser_t **parsers; /* symlink to parser array */
 serializer_flags_t yaml_flags = SER_FLAGS_PRETTY;
 serializer_flags_t json_flags = SER_FLAGS_PRETTY;
 
 #define MAGIC 0xDFFEAAAE
 #define MAGIC_HEADER_ACCEPT 0xDF9EAABE
+#define HTTP_HEADER_ETAG "ETag"
+#define HTTP_HEADER_IF_NONE_MATCH "If-None-Match"
 
 typedef struct {
 	int magic;
@@ -94,6 +98,24 @@ static void _check_path_magic(const path_t *path)
 		(path->op_path && !!path->op_path->callback));
 }
 
+static void _path_tag_id(void *item, const char **key, uint32_t *key_len)
+{
+	path_t *path = item;
+
+	*key = (const char *) &path->tag;
+	*key_len = sizeof(path->tag);
+}
+
+static path_t *_find_path_tag(int tag)
+{
+	path_t *path = xhash_get(path_tags, (const char *) &tag, sizeof(tag));
+
+	if (path)
+		_check_path_magic(path);
+
+	return path;
+}
+
 static void _free_path(void *x)
 {
 	path_t *path = (path_t *) x;
@@ -115,6 +137,7 @@ extern int init_operations(data_parser_t **init_parsers)
 		fatal_abort("%s called twice", __func__);
 
 	paths = list_create(_free_path);
+	path_tags = xhash_init(_path_tag_id, NULL);
 	parsers = init_parsers;
 
 	slurm_rwlock_unlock(&paths_lock);
@@ -126,25 +149,14 @@ extern void destroy_operations(void)
 {
 	slurm_rwlock_wrlock(&paths_lock);
 
+	if (path_tags)
+		xhash_free(path_tags);
 	FREE_NULL_LIST(paths);
 	parsers = NULL;
 
 	slurm_rwlock_unlock(&paths_lock);
 }
 
-static int _match_path_key(void *x, void *ptr)
-{
-	path_t *path = (path_t *)x;
-	int tag = *(int *) ptr;
-
-	_check_path_magic(path);
-
-	if (path->tag == tag)
-		return 1;
-	else
-		return 0;
-}
-
 static int _bind(const char *str_path, openapi_handler_t callback,
 		 const openapi_path_binding_t *op_path, int callback_tag,
 		 data_parser_t *parser, const openapi_resp_meta_t *meta)
@@ -167,7 +179,7 @@ static int _bind(const char *str_path, openapi_handler_t callback,
 		return ESLURM_DATA_PATH_NOT_FOUND;
 	}
 
-	if ((path = list_find_first(paths, _match_path_key, &path_tag)))
+	if ((path = _find_path_tag(path_tag)))
 		goto exists;
 
 	/* add new path */
@@ -180,6 +192,7 @@ static int _bind(const char *str_path, openapi_handler_t callback,
 	path->tag = path_tag;
 	path->parser = parser;
 	list_append(paths, path);
+	xhash_add(path_tags, path);
 
 exists:
 	path->callback = callback;
@@ -235,7 +248,7 @@ static int _add_binded_path(const char *path_str,
 		return ESLURM_DATA_PATH_NOT_FOUND;
 
 	/* path should never be a duplicate */
-	xassert(!list_find_first(paths, _match_path_key, &tag));
+	xassert(!_find_path_tag(tag));
 
 	/* add new path */
 	debug4("%s: new bound path %s with path_tag %d",
@@ -250,6 +263,7 @@ static int _add_binded_path(const char *path_str,
 	path->meta = meta;
 
 	list_append(paths, path);
+	xhash_add(path_tags, path);
 
 	return SLURM_SUCCESS;
 }
@@ -333,6 +347,8 @@ static int _rm_path_callback(void *x, void *ptr)
 	debug5("%s: removing tag %d for callback=0x%"PRIxPTR,
 	       __func__, path->tag, (uintptr_t) ptr);
 	unregister_path_tag(path->tag);
+	(void) xhash_pop(path_tags, (const char *) &path->tag,
+			 sizeof(path->tag));
 
 	return 1;
 }
@@ -600,6 +616,34 @@ static int _resolve_mime(on_http_request_args_t *args, const char **read_mime,
 	return SLURM_SUCCESS;
 }
 
+/*
+ * Get last_update from client's If-None-Match.
+ * Only a single ETag in the format sent by _call_handler() is accepted.
+ * RET last_update or 0 if not present or not understood
+ */
+static time_t _parse_if_none_match(on_http_request_args_t *args)
+{
+	const char *etag;
+	long long last_update;
+	int len = 0;
+
+	if (args->method != HTTP_REQUEST_GET)
+		return 0;
+
+	if (!(etag = find_http_header(args->headers,
+				      HTTP_HEADER_IF_NONE_MATCH)))
+		return 0;
+
+	if ((sscanf(etag, "W/\"%lld\"%n", &last_update, &len) != 1) ||
+	    !len || etag[len] || (last_update <= 0)) {
+		debug3("%s: [%s] ignoring If-None-Match: %s",
+		       __func__, _name(args), etag);
+		return 0;
+	}
+
+	return last_update;
+}
+
 static int _call_handler(on_http_request_args_t *args, data_t *params,
 			 data_t *query, openapi_handler_t callback,
 			 const openapi_path_binding_t *op_path,
@@ -609,8 +653,13 @@ static int _call_handler(on_http_request_args_t *args, data_t *params,
 {
 	int rc;
 	data_t *resp = data_new();
-	char *body = NULL;
+	char *body = NULL, *etag = NULL;
 	http_status_code_t e;
+	time_t last_update = 0;
+	http_header_entry_t etag_header = {
+		.name = HTTP_HEADER_ETAG,
+	};
+	list_t *headers = list_create(NULL);
 
 	if (callback) {
 		xassert(!op_path);
@@ -629,7 +678,22 @@ static int _call_handler(on_http_request_args_t *args, data_t *params,
 		rc = wrap_openapi_ctxt_callback(_name(args), args->method,
 						params, query, callback_tag,
 						resp, args->context->auth,
-						parser, op_path, meta);
+						parser, op_path, meta,
+						_parse_if_none_match(args),
+						&last_update);
+	}
+
+	/*
+	 * RFC#7232 Section:2.3
+	 *
+	 * ETag is weak as it only tracks when slurmctld last changed the
+	 * data and not the exact bytes of the response.
+	 */
+	if (last_update) {
+		etag = xstrdup_printf("W/\"%"PRId64"\"",
+				      (int64_t) last_update);
+		etag_header.value = etag;
+		list_append(headers, &etag_header);
 	}
 
 	/*
@@ -638,7 +702,9 @@ static int _call_handler(on_http_request_args_t *args, data_t *params,
 	 */
 	FREE_NULL_REST_AUTH(args->context->auth);
 
-	if (data_get_type(resp) != DATA_TYPE_NULL) {
+	/* nothing will be sent if client's copy is still current */
+	if ((rc != SLURM_NO_CHANGE_IN_DATA) &&
+	    (data_get_type(resp) != DATA_TYPE_NULL)) {
 		int rc2;
 		serializer_flags_t sflags = SER_FLAGS_PRETTY;
 
@@ -666,6 +732,7 @@ static int _call_handler(on_http_request_args_t *args, data_t *params,
 			.http_major = args->http_major,
 			.http_minor = args->http_minor,
 			.status_code = HTTP_STATUS_CODE_REDIRECT_NOT_MODIFIED,
+			.headers = headers,
 		};
 		e = send_args.status_code;
 		rc = send_http_response(&send_args);
@@ -690,6 +757,7 @@ static int _call_handler(on_http_request_args_t *args, data_t *params,
 			.http_major = args->http_major,
 			.http_minor = args->http_minor,
 			.status_code = HTTP_STATUS_CODE_SUCCESS_OK,
+			.headers = headers,
 			.body = NULL,
 			.body_length = 0,
 		};
@@ -710,6 +778,8 @@ static int _call_handler(on_http_request_args_t *args, data_t *params,
 	       get_http_status_code_string(e));
 
 	xfree(body);
+	xfree(etag);
+	FREE_NULL_LIST(headers);
 	FREE_NULL_DATA(resp);
 
 	return rc;
@@ -750,7 +820,7 @@ extern int operations_router(on_http_request_args_t *args)
 	 */
 	slurm_rwlock_rdlock(&paths_lock);
 
-	if (!(path = list_find_first(paths, _match_path_key, &path_tag)))
+	if (!(path = _find_path_tag(path_tag)))
 		fatal_abort("%s: found tag but missing path handler", __func__);
 	_check_path_magic(path);
 
@@ -70,6 +70,7 @@ extern int op_handler_jobs(openapi_ctxt_t *ctxt)
 	openapi_job_info_query_t query = {0};
 	job_info_msg_t *job_info_ptr = NULL;
 	openapi_resp_job_info_msg_t resp = {0};
+	bool etag_check = false;
 	int rc;
 
 	if (ctxt->method != HTTP_REQUEST_GET) {
@@ -88,10 +89,20 @@ extern int op_handler_jobs(openapi_ctxt_t *ctxt)
 	if (!query.show_flags)
 		query.show_flags = SHOW_ALL | SHOW_DETAIL;
 
+	if (!query.update_time && ctxt->if_none_match) {
+		/* let slurmctld tell us if client's copy is still current */
+		query.update_time = ctxt->if_none_match;
+		etag_check = true;
+	}
+
 	rc = slurm_load_jobs(query.update_time, &job_info_ptr,
 			     query.show_flags);
 
-	if (rc == SLURM_NO_CHANGE_IN_DATA) {
+	if ((rc == SLURM_NO_CHANGE_IN_DATA) && etag_check) {
+		/* respond with 304 Not Modified */
+		ctxt->last_update = query.update_time;
+		return rc;
+	} else if (rc == SLURM_NO_CHANGE_IN_DATA) {
 		char ts[32] = {0};
 		slurm_make_time_str(&query.update_time, ts, sizeof(ts));
 		rc = SLURM_SUCCESS;
@@ -105,6 +116,7 @@ extern int op_handler_jobs(openapi_ctxt_t *ctxt)
 		resp.last_backfill = job_info_ptr->last_backfill;
 		resp.last_update = job_info_ptr->last_update;
 		resp.jobs = job_info_ptr;
+		ctxt->last_update = job_info_ptr->last_update;
 	}
 
 	DATA_DUMP(ctxt->parser, OPENAPI_JOB_INFO_RESP, resp, ctxt->resp);
@@ -75,11 +75,41 @@ cleanup:
 	FREE_NULL_DATA(ppath);
 }
 
-static void _dump_nodes(ctxt_t *ctxt, char *name)
+/*
+ * Load nodes and partitions only if either changed since client's ETag
+ * IN ctxt - request context with if_none_match set
+ * IN show_flags - flags to query nodes and partitions with
+ * OUT node_info_pptr - ptr to nodes if changed
+ * OUT part_info_pptr - ptr to partitions if changed
+ * RET SLURM_NO_CHANGE_IN_DATA if neither changed or SLURM_SUCCESS
+ */
+static int _load_if_changed(ctxt_t *ctxt, uint16_t show_flags,
+			    node_info_msg_t **node_info_pptr,
+			    partition_info_msg_t **part_info_pptr)
+{
+	const time_t update_time = ctxt->if_none_match;
+
+	errno = 0;
+	if (!slurm_load_node(update_time, node_info_pptr, show_flags) ||
+	    (errno != SLURM_NO_CHANGE_IN_DATA))
+		return SLURM_SUCCESS;
+
+	/* nodes are unchanged but they also include partition info */
+	errno = 0;
+	if (!slurm_load_partitions(update_time, part_info_pptr, show_flags) ||
+	    (errno != SLURM_NO_CHANGE_IN_DATA))
+		return SLURM_SUCCESS;
+
+	return SLURM_NO_CHANGE_IN_DATA;
+}
+
+static int _dump_nodes(ctxt_t *ctxt, char *name)
 {
 	openapi_nodes_query_t query = {0};
 	node_info_msg_t *node_info_ptr = NULL;
+	partition_info_msg_t *part_info_ptr = NULL;
 	openapi_resp_node_info_msg_t resp = {0};
+	int rc = SLURM_SUCCESS;
 
 	if (DATA_PARSE(ctxt->parser, OPENAPI_NODES_QUERY, query, ctxt->query,
 		       ctxt->parent_path)) {
@@ -91,8 +121,18 @@ static void _dump_nodes(ctxt_t *ctxt, char *name)
 	if (!query.show_flags)
 		query.show_flags = SHOW_ALL | SHOW_DETAIL | SHOW_MIXED;
 
+	if (!name && !query.update_time && ctxt->if_none_match &&
+	    (_load_if_changed(ctxt, query.show_flags, &node_info_ptr,
+			      &part_info_ptr) == SLURM_NO_CHANGE_IN_DATA)) {
+		/* respond with 304 Not Modified */
+		ctxt->last_update = ctxt->if_none_match;
+		rc = SLURM_NO_CHANGE_IN_DATA;
+		goto done;
+	}
+
 	if (!name) {
-		if ((slurm_load_node(query.update_time, &node_info_ptr,
+		if (!node_info_ptr &&
+		    (slurm_load_node(query.update_time, &node_info_ptr,
 				     query.show_flags))) {
 			resp_error(ctxt, errno, __func__,
 				   "Failure to query nodes");
@@ -109,10 +149,8 @@ static void _dump_nodes(ctxt_t *ctxt, char *name)
 	}
 
 	if (node_info_ptr && node_info_ptr->record_count) {
-		int rc;
-		partition_info_msg_t *part_info_ptr = NULL;
-
-		if ((rc = slurm_load_partitions(query.update_time,
+		if (!part_info_ptr &&
+		    (rc = slurm_load_partitions(query.update_time,
 						&part_info_ptr,
 						query.show_flags))) {
 			resp_error(ctxt, rc, __func__,
@@ -121,16 +159,21 @@ static void _dump_nodes(ctxt_t *ctxt, char *name)
 		}
 
 		slurm_populate_node_partitions(node_info_ptr, part_info_ptr);
-		slurm_free_partition_info_msg(part_info_ptr);
 
 		resp.last_update = node_info_ptr->last_update;
 		resp.nodes = node_info_ptr;
+
+		if (!name)
+			ctxt->last_update = MAX(node_info_ptr->last_update,
+						part_info_ptr->last_update);
 	}
 
 	DATA_DUMP(ctxt->parser, OPENAPI_NODES_RESP, resp, ctxt->resp);
 
 done:
+	slurm_free_partition_info_msg(part_info_ptr);
 	slurm_free_node_info_msg(node_info_ptr);
+	return rc;
 }
 
 extern int op_handler_nodes(openapi_ctxt_t *ctxt)
@@ -138,7 +181,7 @@ extern int op_handler_nodes(openapi_ctxt_t *ctxt)
 	int rc = SLURM_SUCCESS;
 
 	if (ctxt->method == HTTP_REQUEST_GET) {
-		_dump_nodes(ctxt, NULL);
+		rc = _dump_nodes(ctxt, NULL);
 	} else {
 		rc = resp_error(ctxt, ESLURM_REST_INVALID_QUERY, __func__,
 				"Unsupported HTTP method requested: %s",
@@ -160,7 +203,7 @@ extern int op_handler_node(openapi_ctxt_t *ctxt)
 	}
 
 	if (ctxt->method == HTTP_REQUEST_GET) {
-		_dump_nodes(ctxt, params.node_name);
+		(void) _dump_nodes(ctxt, params.node_name);
 	} else if (ctxt->method == HTTP_REQUEST_DELETE) {
 		update_node_msg_t *node_msg = xmalloc(sizeof(*node_msg));
 		slurm_init_update_node_msg(node_msg);
@@ -47,6 +47,7 @@ extern int op_handler_partitions(openapi_ctxt_t *ctxt)
 	partition_info_msg_t *part_info_ptr = NULL;
 	openapi_partitions_query_t query = {0};
 	openapi_resp_partitions_info_msg_t resp = {0};
+	bool etag_check = false;
 
 	if (ctxt->method != HTTP_REQUEST_GET) {
 		resp_error(ctxt, ESLURM_REST_INVALID_QUERY, __func__,
@@ -62,18 +63,29 @@ extern int op_handler_partitions(openapi_ctxt_t *ctxt)
 		goto done;
 	}
 
+	if (!query.update_time && ctxt->if_none_match) {
+		/* let slurmctld tell us if client's copy is still current */
+		query.update_time = ctxt->if_none_match;
+		etag_check = true;
+	}
+
 	errno = 0;
 	if ((rc = slurm_load_partitions(query.update_time, &part_info_ptr,
 					query.show_flags))) {
 		if ((rc == SLURM_ERROR) && errno)
 			rc = errno;
 
+		/* respond with 304 Not Modified */
+		if ((rc == SLURM_NO_CHANGE_IN_DATA) && etag_check)
+			ctxt->last_update = query.update_time;
+
 		goto done;
 	}
 
 	if (part_info_ptr) {
 		resp.last_update = part_info_ptr->last_update;
 		resp.partitions = part_info_ptr;
+		ctxt->last_update = part_info_ptr->last_update;
 	}
 
 	DATA_DUMP(ctxt->parser, OPENAPI_PARTITION_RESP, resp, ctxt->resp);
@@ -48,6 +48,7 @@
 #include <termios.h>
 
 #include "src/common/read_config.h"
+#include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_time.h"
 #include "src/common/xstring.h"
 
@@ -97,6 +98,10 @@ main (int argc, char **argv)
 	if (params.clusters)
 		working_cluster_rec = list_peek(params.clusters);
 
+	/* Avoid a new connection to slurmctld on every iteration */
+	if (params.iterate)
+		slurm_persist_controller_conn_init();
+
 	while (1) {
 		if ((!params.no_header) &&
 		    (params.iterate || params.verbose || params.long_list))
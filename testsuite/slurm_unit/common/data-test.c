@@ -39,6 +39,7 @@
 #include "slurm/slurm_errno.h"
 #include "src/common/data.h"
 #include "src/common/log.h"
+#include "src/common/timers.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -131,6 +132,18 @@ data_for_each_cmd_t _check_list_order(const data_t *data, void *arg)
 }
 
 
+static data_for_each_cmd_t
+	_check_dict_order(const char *key, const data_t *data, void *arg)
+{
+	int *last = arg;
+	int64_t value = data_get_int(data);
+
+	ck_assert_msg(value >= *last, "dict order %s", key);
+	*last = value;
+
+	return DATA_FOR_EACH_CONT;
+}
+
 START_TEST(test_list_iteration)
 {
 	int max;
@@ -345,6 +358,54 @@ START_TEST(test_detection)
 }
 END_TEST
 
+START_TEST(test_dict_index)
+{
+	DEF_TIMERS;
+	const int count = 50000;
+	int found = 0;
+	data_t *d = data_set_dict(data_new());
+
+	START_TIMER;
+	for (int i = 0; i < count; i++)
+		data_set_int(data_key_set_int(d, i), i);
+	END_TIMER3(__func__, INFINITE);
+	printf("%s: inserted %d keys in %s\n", __func__, count, TIME_STR);
+
+	ck_assert_msg(data_get_dict_length(d) == count, "dict cardinality");
+
+	/* existing keys must not be duplicated */
+	for (int i = 0; i < count; i += 1000)
+		data_key_set_int(d, i);
+	ck_assert_msg(data_get_dict_length(d) == count, "dict cardinality");
+
+	START_TIMER;
+	for (int i = count - 1; i >= 0; i--) {
+		data_t *e = data_key_get_int(d, i);
+
+		ck_assert_msg(e && (data_get_int(e) == i), "lookup key %d", i);
+	}
+	END_TIMER3(__func__, INFINITE);
+	printf("%s: looked up %d keys in %s\n", __func__, count, TIME_STR);
+
+	ck_assert(!data_key_get(d, "missing"));
+
+	for (int i = 0; i < 100; i += 2) {
+		char key[16];
+
+		snprintf(key, sizeof(key), "%d", i);
+		ck_assert_msg(data_key_unset(d, key), "unset %s", key);
+		ck_assert_msg(!data_key_get(d, key), "removed %s", key);
+	}
+	ck_assert_msg(data_get_dict_length(d) == (count - 50), "cardinality");
+
+	/* insertion order must be preserved */
+	ck_assert_msg(data_dict_for_each_const(d, _check_dict_order, &found) ==
+		      (count - 50), "dict order");
+
+	FREE_NULL_DATA(d);
+}
+END_TEST
+
 Suite *suite_data(void)
 {
 	Suite *s = suite_create("Data");
@@ -354,6 +415,7 @@ Suite *suite_data(void)
 	tcase_add_test(tc_core, test_dict_typeset);
 	tcase_add_test(tc_core, test_dict_iteration);
 	tcase_add_test(tc_core, test_list_iteration);
+	tcase_add_test(tc_core, test_dict_index);
 
 	suite_add_tcase(s, tc_core);
 	return s;
@@ -280,6 +280,7 @@ START_TEST(test_parse)
 		"[{\"test\":\"test\"}]", //json-c fails: "[{test:test,,,,,,,,,,,,,,,,,,,,,,,,,,,}]",
 		"{\"test\":[]}", //json-c fails: "{test:[]}",
 		"{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":{\"test\":\"test\"}}}}}}}}}}}}}}}}}}}}}}}}}}",
+		"[ \"\\ud83c\\udf2e\", \"\\udf2e\" ]",
 	};
 	data_t *c[] = {
 		data_set_string(data_new(), "taco"),
@@ -305,6 +306,7 @@ START_TEST(test_parse)
 		data_set_list(data_new()),
 		data_set_dict(data_new()),
 		data_set_dict(data_new()),
+		data_set_list(data_new()),
 	};
 
 	data_set_int(data_list_append(c[2]), 100),
@@ -413,6 +415,10 @@ START_TEST(test_parse)
 		data_set_string(t, "test");
 	}
 
+	/* surrogate pair and unpaired low surrogate */
+	data_set_string(data_list_append(c[23]), "\U0001f32e");
+	data_set_string(data_list_append(c[23]), "\U0000fffd");
+
 	for (int i = 0; i < ARRAY_SIZE(sf); i++) {
 		int rc;
 		data_t *d = NULL;
@@ -694,6 +700,48 @@ START_TEST(test_compliance)
 }
 END_TEST
 
+static void _test_empty_str(const data_t *src, const serializer_flags_t flags,
+			    const char *expected)
+{
+	char *output = NULL;
+	int rc;
+
+	rc = serialize_g_data_to_string(&output, NULL, src, MIME_TYPE_JSON,
+					flags);
+	assert_int_eq(rc, 0);
+
+	debug("dumped empty containers:\n%s", output);
+
+	ck_assert_str_eq(output, expected);
+
+	xfree(output);
+}
+
+START_TEST(test_empty)
+{
+	data_t *dict = data_set_dict(data_new());
+	data_t *list = data_set_list(data_new());
+	data_t *nested = data_set_dict(data_new());
+
+	data_set_dict(data_key_set(nested, "dict"));
+	data_set_list(data_key_set(nested, "list"));
+
+	/* Empty containers must not gain a newline when pretty printed */
+	_test_empty_str(dict, SER_FLAGS_NONE, "{}");
+	_test_empty_str(dict, SER_FLAGS_PRETTY, "{}");
+	_test_empty_str(list, SER_FLAGS_NONE, "[]");
+	_test_empty_str(list, SER_FLAGS_PRETTY, "[]");
+	_test_empty_str(nested, SER_FLAGS_COMPACT,
+			"{\"dict\":{},\"list\":[]}");
+	_test_empty_str(nested, SER_FLAGS_PRETTY,
+			"{\n  \"dict\": {},\n  \"list\": []\n}");
+
+	FREE_NULL_DATA(dict);
+	FREE_NULL_DATA(list);
+	FREE_NULL_DATA(nested);
+}
+END_TEST
+
 extern Suite *suite_data(void)
 {
 	Suite *s = suite_create("Serializer");
@@ -705,6 +753,7 @@ extern Suite *suite_data(void)
 	tcase_add_test(tc_core, test_mimetype);
 	tcase_add_test(tc_core, test_parse);
 	tcase_add_test(tc_core, test_compliance);
+	tcase_add_test(tc_core, test_empty);
 	tcase_add_test(tc_core, test_bandwidth);
 
 	suite_add_tcase(s, tc_core);
@@ -0,0 +1,234 @@
+/*****************************************************************************\
+ *  workq-test.c - test work queue manager
+ *****************************************************************************
+ *  Copyright (C) SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <check.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/timers.h"
+#include "src/common/workq.h"
+#include "src/common/xmalloc.h"
+
+#define THREADS 8
+
+typedef struct {
+	workq_t *workq;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int count;
+	int spawn; /* number of work each work adds */
+} test_args_t;
+
+static void _count(void *arg)
+{
+	test_args_t *args = arg;
+
+	slurm_mutex_lock(&args->mutex);
+	args->count++;
+	slurm_cond_broadcast(&args->cond);
+	slurm_mutex_unlock(&args->mutex);
+}
+
+static void _wait_count(test_args_t *args, int count)
+{
+	slurm_mutex_lock(&args->mutex);
+	while (args->count < count)
+		slurm_cond_wait(&args->cond, &args->mutex);
+	slurm_mutex_unlock(&args->mutex);
+}
+
+static void _spawn(void *arg)
+{
+	test_args_t *args = arg;
+
+	for (int i = 0; i < args->spawn; i++)
+		if (workq_add_work(args->workq, _count, args, "_count"))
+			fatal("%s: workq_add_work() failed", __func__);
+
+	_count(arg);
+}
+
+START_TEST(test_run_all)
+{
+	const int count = 10000;
+	test_args_t args = {
+		.mutex = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+
+	args.workq = new_workq(THREADS);
+	ck_assert_int_eq(get_workq_thread_count(args.workq), THREADS);
+
+	for (int i = 0; i < count; i++)
+		ck_assert(!workq_add_work(args.workq, _count, &args, "_count"));
+
+	/* all queued work must run before workers exit */
+	quiesce_workq(args.workq);
+	ck_assert_int_eq(args.count, count);
+
+	/* new work is rejected after quiesce */
+	ck_assert_int_eq(workq_add_work(args.workq, _count, &args, "_count"),
+			 ESLURM_DISABLED);
+	ck_assert_int_eq(workq_get_active(args.workq), 0);
+
+	free_workq(args.workq);
+}
+END_TEST
+
+START_TEST(test_nested_work)
+{
+	const int count = 1000;
+	test_args_t args = {
+		.mutex = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+		.spawn = 10,
+	};
+
+	args.workq = new_workq(THREADS);
+
+	/* work added by work must also run on the other workers */
+	for (int i = 0; i < count; i++)
+		ck_assert(!workq_add_work(args.workq, _spawn, &args, "_spawn"));
+
+	_wait_count(&args, (count * (args.spawn + 1)));
+	free_workq(args.workq);
+	ck_assert_int_eq(args.count, (count * (args.spawn + 1)));
+}
+END_TEST
+
+static void _block(void *arg)
+{
+	test_args_t *args = arg;
+
+	/* queued to this worker which only returns once the work ran */
+	for (int i = 0; i < args->spawn; i++)
+		if (workq_add_work(args->workq, _count, args, "_count"))
+			fatal("%s: workq_add_work() failed", __func__);
+
+	_wait_count(args, args->spawn);
+}
+
+START_TEST(test_steal)
+{
+	/* the idle worker must steal 1, 2 and 3 queued work */
+	for (int i = 1; i <= 3; i++) {
+		test_args_t args = {
+			.mutex = PTHREAD_MUTEX_INITIALIZER,
+			.cond = PTHREAD_COND_INITIALIZER,
+			.spawn = i,
+		};
+
+		args.workq = new_workq(2);
+		ck_assert(!workq_add_work(args.workq, _block, &args, "_block"));
+		_wait_count(&args, i);
+		free_workq(args.workq);
+		ck_assert_int_eq(args.count, i);
+	}
+}
+END_TEST
+
+static void *_producer(void *arg)
+{
+	test_args_t *args = arg;
+
+	for (int i = 0; i < 100000; i++)
+		workq_add_work(args->workq, _count, args, "_count");
+
+	return NULL;
+}
+
+/* Microbenchmark of many producers adding tiny work */
+START_TEST(test_contention)
+{
+	DEF_TIMERS;
+	pthread_t tids[THREADS];
+	test_args_t args = {
+		.mutex = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+
+	args.workq = new_workq(THREADS);
+
+	START_TIMER;
+	for (int i = 0; i < THREADS; i++)
+		slurm_thread_create(&tids[i], _producer, &args);
+	for (int i = 0; i < THREADS; i++)
+		slurm_thread_join(tids[i]);
+	quiesce_workq(args.workq);
+	END_TIMER3(__func__, INFINITE);
+
+	printf("%s: %d producers ran %d work on %d workers in %s\n",
+	       __func__, THREADS, args.count, THREADS, TIME_STR);
+	ck_assert_int_eq(args.count, (THREADS * 100000));
+
+	free_workq(args.workq);
+}
+END_TEST
+
+Suite *suite_workq(void)
+{
+	Suite *s = suite_create("workq");
+	TCase *tc_core = tcase_create("workq");
+
+	tcase_set_timeout(tc_core, 120);
+	tcase_add_test(tc_core, test_run_all);
+	tcase_add_test(tc_core, test_nested_work);
+	tcase_add_test(tc_core, test_steal);
+	tcase_add_test(tc_core, test_contention);
+
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int main(void)
+{
+	int number_failed;
+
+	log_options_t log_opts = LOG_OPTS_INITIALIZER;
+	log_opts.stderr_level = LOG_LEVEL_DEBUG5;
+	log_init("workq-test", log_opts, 0, NULL);
+
+	SRunner *sr = srunner_create(suite_workq());
+
+	srunner_run_all(sr, CK_ENV);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}